@@ -0,0 +1,104 @@
+// Archive (varints, raw floats) against the text operator<< / operator>> path of File, both into a File_memory.
+// Usage: bench_archive [entities] [rounds]
+
+#include "archive.h"
+#include "file.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+using namespace AllegroCPP;
+
+struct entity {
+	uint32_t id = 0;
+	float x = 0, y = 0, z = 0;
+	int32_t health = 0;
+	uint8_t team = 0;
+	std::string name;
+
+	void serialize(Archive& ar) { ar(id, x, y, z, health, team, name); }
+};
+
+static double now_us()
+{
+	return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Best of rounds, in microseconds.
+template<typename Fn>
+static double best_of(const int rounds, Fn&& fn)
+{
+	double best = 1e300;
+	for (int r = 0; r < rounds; ++r) {
+		const double t = now_us();
+		fn();
+		best = (std::min)(best, now_us() - t);
+	}
+	return best;
+}
+
+int main(int argc, char** argv)
+{
+	const size_t count = argc > 1 ? static_cast<size_t>(atoll(argv[1])) : 10000;
+	const int rounds = argc > 2 ? atoi(argv[2]) : 20;
+
+	std::vector<entity> ents(count);
+	for (size_t i = 0; i < count; ++i) {
+		auto& e = ents[i];
+		e.id = static_cast<uint32_t>(i);
+		e.x = static_cast<float>(i % 1000) * 1.25f;
+		e.y = static_cast<float>(i % 300) * -0.5f;
+		e.z = 64.0f;
+		e.health = static_cast<int32_t>(i % 101);
+		e.team = static_cast<uint8_t>(i % 4);
+		e.name = "unit_" + std::to_string(i);
+	}
+
+	File_memory mem(count * 96 + 4096);
+	std::vector<entity> back;
+
+	const double bin_save = best_of(rounds, [&] {
+		mem.seek(0, ALLEGRO_SEEK_SET);
+		Archive ar(mem, Archive::Mode::SAVE);
+		ar(ents);
+	});
+	const int64_t bin_bytes = mem.tell();
+	const double bin_load = best_of(rounds, [&] {
+		mem.seek(0, ALLEGRO_SEEK_SET);
+		Archive ar(mem, Archive::Mode::LOAD);
+		ar(back);
+	});
+	const bool bin_ok = back.size() == ents.size() && back.back().name == ents.back().name && back.back().x == ents.back().x;
+
+	const double txt_save = best_of(rounds, [&] {
+		mem.seek(0, ALLEGRO_SEEK_SET);
+		mem << static_cast<unsigned long long>(ents.size()) << " ";
+		for (const auto& e : ents) mem << e.id << " " << e.x << " " << e.y << " " << e.z << " " << e.health << " " << static_cast<unsigned>(e.team) << " " << e.name << "\n";
+	});
+	const int64_t txt_bytes = mem.tell();
+	const double txt_load = best_of(rounds, [&] {
+		mem.seek(0, ALLEGRO_SEEK_SET);
+		unsigned long long n = 0;
+		mem >> n;
+		back.assign(static_cast<size_t>(n), {});
+		for (auto& e : back) {
+			unsigned team = 0;
+			mem >> e.id >> e.x >> e.y >> e.z >> e.health >> team >> e.name;
+			e.team = static_cast<uint8_t>(team);
+			if (!e.name.empty() && e.name.back() == '\n') e.name.pop_back();
+		}
+	});
+	const bool txt_ok = back.size() == ents.size() && back.back().name == ents.back().name;
+
+	printf("%zu entities, best of %d\n", count, rounds);
+	printf("%-8s %10s %12s %12s %10s\n", "path", "bytes", "save us", "load us", "roundtrip");
+	printf("%-8s %10lld %12.1f %12.1f %10s\n", "archive", static_cast<long long>(bin_bytes), bin_save, bin_load, bin_ok ? "ok" : "FAILED");
+	printf("%-8s %10lld %12.1f %12.1f %10s\n", "text", static_cast<long long>(txt_bytes), txt_save, txt_load, txt_ok ? "ok" : "FAILED");
+	printf("archive is %.1fx faster to save, %.1fx faster to load, %.2fx the size\n", txt_save / bin_save, txt_load / bin_load, static_cast<double>(bin_bytes) / static_cast<double>(txt_bytes));
+	return bin_ok && txt_ok ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,106 @@
+// Snapshot deltas of a game state where a share of the entities move each tick, against the last acked snapshot, into a File_memory.
+// Usage: bench_snapshot_delta [entities] [ticks] [ack latency in ticks]
+
+#include "snapshot_delta.h"
+#include "file.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <random>
+#include <vector>
+
+using namespace AllegroCPP;
+
+struct entity {
+	uint32_t id;
+	float x, y, z;
+	float vx, vy;
+	int32_t health;
+	uint32_t flags;
+};
+
+static double now_us()
+{
+	return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static std::vector<uint8_t> snapshot_of(const std::vector<entity>& ents)
+{
+	std::vector<uint8_t> s(ents.size() * sizeof(entity));
+	if (!s.empty()) memcpy(s.data(), ents.data(), s.size());
+	return s;
+}
+
+int main(int argc, char** argv)
+{
+	const size_t count = argc > 1 ? static_cast<size_t>(atoll(argv[1])) : 2000;
+	const int ticks = argc > 2 ? atoi(argv[2]) : 600;
+	const size_t latency = argc > 3 ? static_cast<size_t>(atoll(argv[3])) : 3;
+	const double moving_shares[] = { 0.01, 0.1, 0.5, 1.0 };
+
+	const size_t full = count * sizeof(entity);
+	File_memory mem(full * 2 + 4096);
+	bool ok = true;
+
+	printf("%zu entities (%zu bytes a snapshot), %d ticks, baseline %zu ticks old\n", count, full, ticks, latency);
+	printf("%-8s %14s %10s %12s %12s\n", "moving", "bytes/tick", "of full", "encode us", "decode us");
+
+	for (const double share : moving_shares) {
+		std::mt19937 rng(1234);
+		std::uniform_real_distribution<float> step(-1.0f, 1.0f);
+		std::vector<entity> ents(count);
+		for (size_t i = 0; i < count; ++i) ents[i] = { static_cast<uint32_t>(i), static_cast<float>(i % 100), static_cast<float>(i / 100), 0.0f, 0.0f, 0.0f, 100, 0 };
+
+		std::deque<std::vector<uint8_t>> sent; // not acked yet, oldest first
+		std::vector<uint8_t> baseline; // last acked, empty at first
+		std::vector<uint8_t> back;
+		const size_t movers = static_cast<size_t>(static_cast<double>(count) * share);
+		size_t total_bytes = 0;
+		double encode_us = 0.0, decode_us = 0.0;
+
+		for (int t = 0; t < ticks; ++t) {
+			for (size_t k = 0; k < movers; ++k) {
+				auto& e = ents[(static_cast<size_t>(t) * 7919 + k) % count];
+				e.vx = step(rng);
+				e.vy = step(rng);
+				e.x += e.vx;
+				e.y += e.vy;
+				if ((k & 31) == 0) --e.health;
+			}
+			auto current = snapshot_of(ents);
+
+			mem.seek(0, ALLEGRO_SEEK_SET);
+			const double t0 = now_us();
+			snapshot_delta_stats st;
+			ok &= snapshot_delta_encode(mem, baseline, current, &st);
+			const double t1 = now_us();
+			mem.seek(0, ALLEGRO_SEEK_SET);
+			ok &= snapshot_delta_decode(mem, baseline, back);
+			const double t2 = now_us();
+			ok &= back == current;
+
+			if (t > 0) { // the first tick sends everything, leave it out of the steady state
+				total_bytes += st.bytes;
+				encode_us += t1 - t0;
+				decode_us += t2 - t1;
+			}
+			sent.push_back(std::move(current));
+			if (sent.size() > latency) {
+				baseline = std::move(sent.front());
+				sent.pop_front();
+			}
+		}
+
+		const double n = static_cast<double>((std::max)(ticks - 1, 1));
+		const double per_tick = static_cast<double>(total_bytes) / n;
+		printf("%6.0f %% %14.1f %9.1f%% %12.2f %12.2f\n", share * 100.0, per_tick, full ? per_tick * 100.0 / static_cast<double>(full) : 0.0, encode_us / n, decode_us / n);
+	}
+
+	if (!ok) printf("roundtrip FAILED\n");
+	return ok ? 0 : 1;
+}
\ No newline at end of file
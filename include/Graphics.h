@@ -20,4 +20,14 @@
 #include "vertex.h"
 #include "video.h"
 #include "config.h"
-#include "gif.h"
\ No newline at end of file
+#include "gif.h"
+#include "sprite_batch.h"
+#include "texture_atlas.h"
+#include "bitmap_cache.h"
+#include "bitmap_loader.h"
+#include "pixel_view.h"
+#include "pixel_convert.h"
+#include "compositor.h"
+#include "damage_tracker.h"
+#include "draw_command_buffer.h"
+#include "bitmap_pyramid.h"
\ No newline at end of file
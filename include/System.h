@@ -10,5 +10,14 @@
 #include "state.h"
 #include "thread.h"
 #include "utfstring.h"
+#include "virtual_fs.h"
+#include "binary_stream.h"
+#include "archive.h"
+#include "hash.h"
+#include "file_compressed.h"
+#include "network_simulator.h"
+#include "udp_channel.h"
+#include "snapshot_delta.h"
+#include "rpc.h"
 #include "mouse.h"
 #include "keyboard.h"
\ No newline at end of file
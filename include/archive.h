@@ -0,0 +1,230 @@
+#pragma once
+
+#include "file.h"
+#include "binary_stream.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace AllegroCPP {
+
+	class Archive;
+
+	// Specialize to bump the schema of a type. The version is stored before each object and readable through Archive::version().
+	template<typename T>
+	struct archive_version {
+		static constexpr uint32_t value = 0;
+	};
+
+	namespace _archive {
+
+		inline uint64_t zigzag(const int64_t v) { return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63); }
+		inline int64_t unzigzag(const uint64_t v) { return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1); }
+
+		template<typename T> concept member_serialize = requires(T& t, Archive& a) { t.serialize(a); };
+		template<typename T> concept free_serialize = requires(T& t, Archive& a) { serialize(a, t); };
+
+		template<typename T> struct is_vector : std::false_type {};
+		template<typename T, typename A> struct is_vector<std::vector<T, A>> : std::true_type {};
+		template<typename T> struct is_array : std::false_type {};
+		template<typename T, size_t N> struct is_array<std::array<T, N>> : std::true_type {};
+
+		template<typename> inline constexpr bool always_false = false;
+	}
+
+	// Compact binary save/load over a File (File_memory for snapshots).
+	// The same serialize(Archive&) handles both directions:
+	//   struct entity { uint32_t id; float x, y; std::string name; void serialize(Archive& ar) { ar(id, x, y, name); } };
+	// or a free serialize(Archive&, T&) found by ADL.
+	// Unsigned integers are varints, signed are zig-zag varints, floats are raw little endian, strings and vectors are length prefixed.
+	// When loading, the File is read ahead in blocks, so its position after the Archive is not right after the data.
+	class Archive {
+	public:
+		enum class Mode { SAVE, LOAD };
+	private:
+		Mode m_mode;
+		std::optional<Binary_file_writer> m_w;
+		std::optional<Binary_file_reader> m_r;
+		uint32_t m_version = 0;
+		uint64_t m_max_length = static_cast<uint64_t>(1) << 28;
+		bool m_good = true;
+
+		static constexpr size_t load_step = static_cast<size_t>(1) << 16; // bytes allocated ahead of what was actually read
+
+		uint64_t length(const size_t len)
+		{
+			uint64_t n = len;
+			io_varint(n);
+			if (n > m_max_length) {
+				m_good = false;
+				return 0;
+			}
+			return n;
+		}
+
+		// Grows c as the data comes in, a bad length ends with the input instead of allocating it up front.
+		template<typename C>
+		bool load_bytes(C& c, const uint64_t n)
+		{
+			c.clear();
+			while (c.size() < n) {
+				const size_t at = c.size();
+				const size_t now = static_cast<size_t>((std::min)(n - at, static_cast<uint64_t>(load_step)));
+				c.resize(at + now);
+				if (!m_r->bytes(c.data() + at, now)) return false;
+			}
+			return true;
+		}
+
+		void io_varint(uint64_t& v)
+		{
+			if (m_w) m_w->varint(v);
+			else v = m_r->varint();
+		}
+
+		template<typename T>
+		void io(T& v)
+		{
+			if constexpr (std::is_same_v<T, bool>) {
+				if (m_w) m_w->u8(v ? 1 : 0);
+				else v = m_r->u8() != 0;
+			}
+			else if constexpr (std::is_enum_v<T>) {
+				auto u = static_cast<std::underlying_type_t<T>>(v);
+				io(u);
+				if (m_r) v = static_cast<T>(u);
+			}
+			else if constexpr (std::is_integral_v<T> && sizeof(T) == 1) {
+				if (m_w) m_w->u8(static_cast<uint8_t>(v));
+				else v = static_cast<T>(m_r->u8());
+			}
+			else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+				uint64_t u = _archive::zigzag(static_cast<int64_t>(v));
+				io_varint(u);
+				if (m_r) {
+					const int64_t s = _archive::unzigzag(u);
+					if (s < static_cast<int64_t>((std::numeric_limits<T>::min)()) || s > static_cast<int64_t>((std::numeric_limits<T>::max)())) m_good = false;
+					v = static_cast<T>(s);
+				}
+			}
+			else if constexpr (std::is_integral_v<T>) {
+				uint64_t u = static_cast<uint64_t>(v);
+				io_varint(u);
+				if (m_r) {
+					if (u > static_cast<uint64_t>((std::numeric_limits<T>::max)())) m_good = false;
+					v = static_cast<T>(u);
+				}
+			}
+			else if constexpr (std::is_same_v<T, float>) {
+				if (m_w) m_w->f32le(v);
+				else v = m_r->f32le();
+			}
+			else if constexpr (std::is_same_v<T, double>) {
+				if (m_w) m_w->f64le(v);
+				else v = m_r->f64le();
+			}
+			else if constexpr (std::is_same_v<T, std::string>) {
+				const uint64_t n = length(v.size());
+				if (m_w) m_w->bytes(v.data(), v.size());
+				else if (!load_bytes(v, n)) v.clear();
+			}
+			else if constexpr (_archive::is_vector<T>::value) {
+				using E = typename T::value_type;
+				const uint64_t n = length(v.size());
+				if constexpr (std::is_arithmetic_v<E> && sizeof(E) == 1 && !std::is_same_v<E, bool>) {
+					if (m_w) m_w->bytes(v.data(), v.size());
+					else if (!load_bytes(v, n)) v.clear();
+				}
+				else if (m_w) {
+					for (auto& i : v) io(i);
+				}
+				else {
+					v.clear();
+					v.reserve(static_cast<size_t>((std::min)(n, static_cast<uint64_t>(load_step / sizeof(E) + 1))));
+					while (v.size() < n && good()) {
+						E e{};
+						io(e);
+						v.push_back(std::move(e));
+					}
+				}
+			}
+			else if constexpr (_archive::is_array<T>::value) {
+				for (auto& i : v) io(i);
+			}
+			else if constexpr (_archive::member_serialize<T> || _archive::free_serialize<T>) {
+				const uint32_t prev = m_version;
+				uint64_t ver = archive_version<T>::value;
+				io_varint(ver);
+				m_version = static_cast<uint32_t>(ver);
+				if constexpr (_archive::member_serialize<T>) v.serialize(*this);
+				else serialize(*this, v);
+				m_version = prev;
+			}
+			else static_assert(_archive::always_false<T>, "Archive: type has no serialize(Archive&)");
+		}
+	public:
+		Archive(File& file, const Mode mode)
+			: m_mode(mode)
+		{
+			if (mode == Mode::SAVE) m_w.emplace(file);
+			else m_r.emplace(file);
+		}
+
+		Archive(const Archive&) = delete;
+		Archive(Archive&&) = delete;
+		void operator=(const Archive&) = delete;
+		void operator=(Archive&&) = delete;
+
+		bool saving() const { return m_mode == Mode::SAVE; }
+		bool loading() const { return m_mode == Mode::LOAD; }
+		bool good() const { return m_good && (m_w ? m_w->good() : m_r->good()); }
+		operator bool() const { return good(); }
+
+		// Version stored for the object currently in serialize(). When saving this is archive_version<T>::value.
+		uint32_t version() const { return m_version; }
+
+		// Longest string/vector accepted when loading. Default 256 Mi elements.
+		// Containers grow with the data actually read, so a bad length fails at the end of the input instead of allocating up front.
+		void set_max_length(const uint64_t len) { m_max_length = len; }
+
+		// Push buffered data to the File. Also done on destruction.
+		bool flush() { return m_w ? m_w->flush() : true; }
+
+		template<typename... Ts>
+		Archive& operator()(Ts&... vals)
+		{
+			(io(vals), ...);
+			return *this;
+		}
+
+		template<typename T>
+		Archive& operator&(T& val)
+		{
+			io(val);
+			return *this;
+		}
+
+		// Length prefixed raw bytes.
+		Archive& blob(std::vector<uint8_t>& data)
+		{
+			io(data);
+			return *this;
+		}
+
+		// Fixed size raw bytes, no prefix.
+		Archive& blob(void* data, const size_t len)
+		{
+			if (m_w) m_w->bytes(data, len);
+			else m_r->bytes(data, len);
+			return *this;
+		}
+	};
+
+}
\ No newline at end of file
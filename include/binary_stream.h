@@ -0,0 +1,354 @@
+#pragma once
+
+#include "file.h"
+
+#include <stdint.h>
+#include <string.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace AllegroCPP {
+
+	namespace _binary_stream {
+
+		inline uint16_t bswap(const uint16_t v) { return static_cast<uint16_t>((v >> 8) | (v << 8)); }
+		inline uint32_t bswap(const uint32_t v) { return (v >> 24) | ((v >> 8) & 0xFF00u) | ((v << 8) & 0xFF0000u) | (v << 24); }
+		inline uint64_t bswap(const uint64_t v) { return (static_cast<uint64_t>(bswap(static_cast<uint32_t>(v))) << 32) | bswap(static_cast<uint32_t>(v >> 32)); }
+
+		template<typename U>
+		inline U order(const U v, const std::endian e) { return e == std::endian::native ? v : bswap(v); }
+
+	}
+
+	// Sources. A source has size_t read(void*, size_t) returning 0 at the end. Contiguous ones expose the whole data instead.
+
+	// Whole data already in memory, nothing is copied.
+	struct binary_source_memory {
+		static constexpr bool contiguous = true;
+		std::span<const uint8_t> data;
+
+		binary_source_memory(const void* ptr, const size_t len) : data(static_cast<const uint8_t*>(ptr), len) {}
+		binary_source_memory(std::span<const uint8_t> d) : data(d) {}
+	};
+
+	// Raw descriptor (file, pipe...). Not owned.
+	struct binary_source_fd {
+		static constexpr bool contiguous = false;
+		int fd = -1;
+
+		binary_source_fd(const int f) : fd(f) {}
+		size_t read(void* buf, const size_t len) {
+#ifdef _WIN32
+			const int got = ::_read(fd, buf, static_cast<unsigned>(len));
+#else
+			const auto got = ::read(fd, buf, len);
+#endif
+			return got > 0 ? static_cast<size_t>(got) : 0;
+		}
+	};
+
+	// Any File (sockets, memory files...). One virtual call per buffer refill instead of per field.
+	struct binary_source_file {
+		static constexpr bool contiguous = false;
+		File* file = nullptr;
+
+		binary_source_file(File& f) : file(&f) {}
+		size_t read(void* buf, const size_t len) { const size_t got = file->read(buf, len); return got == static_cast<size_t>(-1) ? 0 : got; }
+	};
+
+	// Sinks. A sink has size_t write(const void*, size_t).
+
+	// Appends to a vector, not owned.
+	struct binary_sink_memory {
+		std::vector<uint8_t>* out = nullptr;
+
+		binary_sink_memory(std::vector<uint8_t>& o) : out(&o) {}
+		size_t write(const void* buf, const size_t len) { const uint8_t* p = static_cast<const uint8_t*>(buf); out->insert(out->end(), p, p + len); return len; }
+	};
+
+	struct binary_sink_fd {
+		int fd = -1;
+
+		binary_sink_fd(const int f) : fd(f) {}
+		size_t write(const void* buf, const size_t len) {
+			size_t done = 0;
+			while (done < len) {
+#ifdef _WIN32
+				const int got = ::_write(fd, static_cast<const char*>(buf) + done, static_cast<unsigned>(len - done));
+#else
+				const auto got = ::write(fd, static_cast<const char*>(buf) + done, len - done);
+#endif
+				if (got <= 0) break;
+				done += static_cast<size_t>(got);
+			}
+			return done;
+		}
+	};
+
+	struct binary_sink_file {
+		File* file = nullptr;
+
+		binary_sink_file(File& f) : file(&f) {}
+		size_t write(const void* buf, const size_t len) { const size_t got = file->write(buf, len); return got == static_cast<size_t>(-1) ? 0 : got; }
+	};
+
+	// Little/big endian field reader with an inline buffer. Source is known at compile time, so field reads are plain loads.
+	// Reading past the end returns 0 and makes good() false for good.
+	template<typename Source, size_t Buffer = 4096>
+	class Binary_reader {
+		static_assert(Buffer >= 16, "Buffer must fit any field");
+
+		Source m_src;
+		std::array<uint8_t, Source::contiguous ? 1 : Buffer> m_buf{};
+		const uint8_t* m_cur = nullptr;
+		const uint8_t* m_end = nullptr;
+		bool m_good = true;
+
+		bool refill(const size_t need)
+		{
+			if constexpr (Source::contiguous) {
+				m_good = false;
+				return false;
+			}
+			else {
+				size_t have = static_cast<size_t>(m_end - m_cur);
+				if (have > 0 && m_cur != m_buf.data()) memmove(m_buf.data(), m_cur, have);
+				while (have < need) {
+					const size_t got = m_src.read(m_buf.data() + have, Buffer - have);
+					if (got == 0) break;
+					have += got;
+				}
+				m_cur = m_buf.data();
+				m_end = m_buf.data() + have;
+				if (have < need) m_good = false;
+				return have >= need;
+			}
+		}
+
+		bool ensure(const size_t need)
+		{
+			return (static_cast<size_t>(m_end - m_cur) >= need) || refill(need);
+		}
+
+		template<typename U>
+		U load(const std::endian e)
+		{
+			if (!ensure(sizeof(U))) return 0;
+			U v;
+			memcpy(&v, m_cur, sizeof(U));
+			m_cur += sizeof(U);
+			if constexpr (sizeof(U) == 1) return v;
+			else return _binary_stream::order(v, e);
+		}
+	public:
+		template<typename... Args>
+		Binary_reader(Args&&... args)
+			: m_src(std::forward<Args>(args)...)
+		{
+			if constexpr (Source::contiguous) {
+				m_cur = m_src.data.data();
+				m_end = m_cur + m_src.data.size();
+			}
+			else m_cur = m_end = m_buf.data();
+		}
+
+		Binary_reader(const Binary_reader&) = delete;
+		void operator=(const Binary_reader&) = delete;
+
+		bool good() const { return m_good; }
+		operator bool() const { return m_good; }
+
+		// Bytes taken from the source and not consumed yet. Seek the source back by this to hand it over to someone else.
+		size_t buffered() const { return static_cast<size_t>(m_end - m_cur); }
+
+		uint8_t u8() { return load<uint8_t>(std::endian::native); }
+		uint16_t u16le() { return load<uint16_t>(std::endian::little); }
+		uint16_t u16be() { return load<uint16_t>(std::endian::big); }
+		uint32_t u32le() { return load<uint32_t>(std::endian::little); }
+		uint32_t u32be() { return load<uint32_t>(std::endian::big); }
+		uint64_t u64le() { return load<uint64_t>(std::endian::little); }
+		uint64_t u64be() { return load<uint64_t>(std::endian::big); }
+
+		int8_t i8() { return static_cast<int8_t>(u8()); }
+		int16_t i16le() { return static_cast<int16_t>(u16le()); }
+		int16_t i16be() { return static_cast<int16_t>(u16be()); }
+		int32_t i32le() { return static_cast<int32_t>(u32le()); }
+		int32_t i32be() { return static_cast<int32_t>(u32be()); }
+		int64_t i64le() { return static_cast<int64_t>(u64le()); }
+		int64_t i64be() { return static_cast<int64_t>(u64be()); }
+
+		float f32le() { return std::bit_cast<float>(u32le()); }
+		float f32be() { return std::bit_cast<float>(u32be()); }
+		double f64le() { return std::bit_cast<double>(u64le()); }
+		double f64be() { return std::bit_cast<double>(u64be()); }
+
+		// LEB128, up to 10 bytes.
+		uint64_t varint()
+		{
+			uint64_t v = 0;
+			for (int shift = 0; shift < 64; shift += 7) {
+				if (!ensure(1)) return 0;
+				const uint8_t b = *m_cur++;
+				v |= static_cast<uint64_t>(b & 0x7F) << shift;
+				if ((b & 0x80) == 0) return v;
+			}
+			m_good = false; // too long
+			return 0;
+		}
+
+		// Copy len bytes. Returns false (and good() false) if there was not enough.
+		bool bytes(void* dst, size_t len)
+		{
+			uint8_t* out = static_cast<uint8_t*>(dst);
+			while (len > 0) {
+				if (m_cur == m_end && !refill(1)) return false;
+				const size_t now = (std::min)(len, static_cast<size_t>(m_end - m_cur));
+				memcpy(out, m_cur, now);
+				m_cur += now;
+				out += now;
+				len -= now;
+			}
+			return true;
+		}
+
+		std::string string(const size_t len)
+		{
+			std::string str(len, '\0');
+			if (!bytes(str.data(), len)) str.clear();
+			return str;
+		}
+
+		bool skip(size_t len)
+		{
+			while (len > 0) {
+				if (m_cur == m_end && !refill(1)) return false;
+				const size_t now = (std::min)(len, static_cast<size_t>(m_end - m_cur));
+				m_cur += now;
+				len -= now;
+			}
+			return true;
+		}
+
+		// Contiguous sources only: view of the next len bytes without copying.
+		std::span<const uint8_t> view(const size_t len) requires Source::contiguous
+		{
+			if (!ensure(len)) return {};
+			std::span<const uint8_t> s(m_cur, len);
+			m_cur += len;
+			return s;
+		}
+	};
+
+	// Field writer with an inline buffer, flushed when full, on flush() and on destruction.
+	template<typename Sink, size_t Buffer = 4096>
+	class Binary_writer {
+		static_assert(Buffer >= 16, "Buffer must fit any field");
+
+		Sink m_sink;
+		uint8_t m_buf[Buffer];
+		size_t m_len = 0;
+		bool m_good = true;
+
+		template<typename U>
+		void store(U v, const std::endian e)
+		{
+			if constexpr (sizeof(U) > 1) v = _binary_stream::order(v, e);
+			if (m_len + sizeof(U) > Buffer) flush();
+			memcpy(m_buf + m_len, &v, sizeof(U));
+			m_len += sizeof(U);
+		}
+	public:
+		template<typename... Args>
+		Binary_writer(Args&&... args)
+			: m_sink(std::forward<Args>(args)...)
+		{
+		}
+		~Binary_writer()
+		{
+			flush();
+		}
+
+		Binary_writer(const Binary_writer&) = delete;
+		void operator=(const Binary_writer&) = delete;
+
+		bool good() const { return m_good; }
+		operator bool() const { return m_good; }
+
+		bool flush()
+		{
+			if (m_len > 0) {
+				if (m_sink.write(m_buf, m_len) != m_len) m_good = false;
+				m_len = 0;
+			}
+			return m_good;
+		}
+
+		void u8(const uint8_t v) { store(v, std::endian::native); }
+		void u16le(const uint16_t v) { store(v, std::endian::little); }
+		void u16be(const uint16_t v) { store(v, std::endian::big); }
+		void u32le(const uint32_t v) { store(v, std::endian::little); }
+		void u32be(const uint32_t v) { store(v, std::endian::big); }
+		void u64le(const uint64_t v) { store(v, std::endian::little); }
+		void u64be(const uint64_t v) { store(v, std::endian::big); }
+
+		void i8(const int8_t v) { u8(static_cast<uint8_t>(v)); }
+		void i16le(const int16_t v) { u16le(static_cast<uint16_t>(v)); }
+		void i16be(const int16_t v) { u16be(static_cast<uint16_t>(v)); }
+		void i32le(const int32_t v) { u32le(static_cast<uint32_t>(v)); }
+		void i32be(const int32_t v) { u32be(static_cast<uint32_t>(v)); }
+		void i64le(const int64_t v) { u64le(static_cast<uint64_t>(v)); }
+		void i64be(const int64_t v) { u64be(static_cast<uint64_t>(v)); }
+
+		void f32le(const float v) { u32le(std::bit_cast<uint32_t>(v)); }
+		void f32be(const float v) { u32be(std::bit_cast<uint32_t>(v)); }
+		void f64le(const double v) { u64le(std::bit_cast<uint64_t>(v)); }
+		void f64be(const double v) { u64be(std::bit_cast<uint64_t>(v)); }
+
+		// LEB128, up to 10 bytes.
+		void varint(uint64_t v)
+		{
+			if (m_len + 10 > Buffer) flush();
+			while (v >= 0x80) {
+				m_buf[m_len++] = static_cast<uint8_t>(v | 0x80);
+				v >>= 7;
+			}
+			m_buf[m_len++] = static_cast<uint8_t>(v);
+		}
+
+		// Big blocks skip the buffer.
+		void bytes(const void* src, const size_t len)
+		{
+			if (m_len + len <= Buffer) {
+				memcpy(m_buf + m_len, src, len);
+				m_len += len;
+				return;
+			}
+			flush();
+			if (m_sink.write(src, len) != len) m_good = false;
+		}
+
+		void string(const std::string& str)
+		{
+			bytes(str.data(), str.size());
+		}
+	};
+
+	using Binary_memory_reader = Binary_reader<binary_source_memory>;
+	using Binary_fd_reader = Binary_reader<binary_source_fd>;
+	using Binary_file_reader = Binary_reader<binary_source_file>;
+	using Binary_memory_writer = Binary_writer<binary_sink_memory>;
+	using Binary_fd_writer = Binary_writer<binary_sink_fd>;
+	using Binary_file_writer = Binary_writer<binary_sink_file>;
+
+}
\ No newline at end of file
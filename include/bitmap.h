@@ -46,6 +46,10 @@ namespace AllegroCPP {
 		Bitmap(ALLEGRO_BITMAP*, const bool treat_as_const);
 
 		friend Bitmap make_const_bitmap_of(ALLEGRO_BITMAP*);
+		friend class Sprite_batch;
+		friend class Texture_atlas;
+		friend class Bitmap_cache;
+		friend class Draw_command_buffer;
 
 		struct draw_props {
 			mutable bitmap_cut _cut = bitmap_cut{ 0, 0, 0, 0 };
@@ -60,6 +64,8 @@ namespace AllegroCPP {
 		draw_props m_stored_draw_props;
 
 		virtual ALLEGRO_BITMAP* get_for_draw() const;
+		bool draw_composited() const;
+		void report_damage() const;
 	public:
 		Bitmap() = default;
 		Bitmap(const int size_x, const int size_y, const int flags = ALLEGRO_VIDEO_BITMAP, const int format = 0);
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "bitmap.h"
+
+#include <allegro5/allegro.h>
+
+#include <stdint.h>
+
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace AllegroCPP {
+
+	struct bitmap_cache_stats {
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint64_t evictions = 0;
+		size_t entries = 0;
+		size_t bytes = 0; // estimated pixel memory of everything cached
+		size_t budget = 0;
+		std::map<int, size_t> bytes_per_format; // ALLEGRO_PIXEL_FORMAT -> bytes
+	};
+
+	// Loads each (path, flags, format) once and hands out Bitmap::make_ref() of it.
+	// Entries nobody references anymore (no ref or sub bitmap alive) are dropped least recently used first while over the budget. Referenced ones are never dropped, so the budget can be passed.
+	class Bitmap_cache {
+		struct _key {
+			std::string path;
+			int flags, format;
+			bool operator==(const _key&) const = default;
+		};
+		struct _key_hash {
+			size_t operator()(const _key& k) const;
+		};
+		struct _entry {
+			Bitmap bmp;
+			size_t bytes;
+			int format; // real one, after loading
+			std::list<_key>::iterator lru;
+		};
+
+		std::unordered_map<_key, _entry, _key_hash> m_entries;
+		std::list<_key> m_lru; // front is the most recent
+		bitmap_cache_stats m_stats;
+		mutable std::mutex m_mtx;
+
+		void evict(); // locked
+		void drop(std::unordered_map<_key, _entry, _key_hash>::iterator); // locked
+	public:
+		// 0 budget: keep everything until clear_unused().
+		Bitmap_cache(const size_t budget_bytes = static_cast<size_t>(256) << 20);
+
+		Bitmap_cache(const Bitmap_cache&) = delete;
+		Bitmap_cache(Bitmap_cache&&) = delete;
+		void operator=(const Bitmap_cache&) = delete;
+		void operator=(Bitmap_cache&&) = delete;
+
+		// Reference to the cached one, loading it on a miss. Throws like Bitmap(path) if loading fails.
+		Bitmap get(const std::string& path, const int flags = ALLEGRO_VIDEO_BITMAP, const int format = 0);
+		bool contains(const std::string& path, const int flags = ALLEGRO_VIDEO_BITMAP, const int format = 0) const;
+
+		// Forget an entry. Refs already handed out keep working.
+		bool remove(const std::string& path, const int flags = ALLEGRO_VIDEO_BITMAP, const int format = 0);
+
+		void set_budget(const size_t budget_bytes);
+		size_t get_budget() const;
+
+		// Drop every entry that is not referenced, budget or not. Returns how many.
+		size_t clear_unused();
+
+		bitmap_cache_stats get_stats() const;
+		void reset_counters();
+
+		// Estimated pixel memory of a bitmap (compressed formats by block).
+		static size_t bytes_of(const int width, const int height, const int format);
+	};
+
+}
\ No newline at end of file
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "bitmap.h"
+#include "events.h"
+#include "thread.h"
+
+#include <allegro5/allegro.h>
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace AllegroCPP {
+
+	struct bitmap_load_event {
+		uint64_t id = 0;
+		std::string path;
+		bool ok = false; // false: could not load, take() will say so
+	};
+
+	// Decodes images into memory bitmaps on a Thread_pool, so the render thread never waits on disk or decoding.
+	// Every finished decode emits an event of type event_id (data1 is a std::any* holding a bitmap_load_event). The owner calls finish() once a frame,
+	// which turns decoded ones into video bitmaps (needs the display's thread) within a time budget, then take() hands them over.
+	class Bitmap_loader {
+	public:
+		enum class State { UNKNOWN, PENDING, DECODING, DECODED, READY, FAILED };
+	private:
+		struct _request {
+			std::string path;
+			int priority;
+			int flags, format;
+		};
+		struct _decoded {
+			uint64_t id;
+			int flags, format;
+			Bitmap bmp;
+		};
+
+		Thread_pool* const m_pool;
+		Event_custom m_event;
+		const int m_event_id;
+
+		std::map<uint64_t, _request> m_pending;
+		std::unordered_set<uint64_t> m_decoding;
+		std::unordered_set<uint64_t> m_cancelled; // still decoding, drop the result
+		std::deque<_decoded> m_decoded;
+		std::unordered_map<uint64_t, Bitmap> m_ready;
+		std::unordered_set<uint64_t> m_failed;
+		uint64_t m_next_id = 1;
+		size_t m_running = 0; // tasks queued on the pool
+		bool m_closing = false;
+		mutable std::mutex m_mtx;
+		std::condition_variable m_idle;
+
+		void run_one();
+	public:
+		// Null pool uses Thread_pool::global(). event_id must be a user event type (ALLEGRO_EVENT_TYPE_IS_USER), else this throws.
+		Bitmap_loader(Thread_pool* pool = nullptr, const int event_id = 1024);
+		~Bitmap_loader();
+
+		Bitmap_loader(const Bitmap_loader&) = delete;
+		Bitmap_loader(Bitmap_loader&&) = delete;
+		void operator=(const Bitmap_loader&) = delete;
+		void operator=(Bitmap_loader&&) = delete;
+
+		// Queue a load. Higher priority is decoded first, same priority in order. flags and format are what finish() converts to.
+		uint64_t load(const std::string& path, const int priority = 0, const int flags = ALLEGRO_VIDEO_BITMAP, const int format = 0);
+		// Only while still pending.
+		bool set_priority(const uint64_t id, const int priority);
+		// Forget a load at any stage. False if the id is unknown or already taken.
+		bool cancel(const uint64_t id);
+		void cancel_all();
+
+		// Convert decoded bitmaps (oldest first, at least one) until budget_seconds have passed. Call from the thread that owns the display. Returns how many.
+		size_t finish(const double budget_seconds = 0.002);
+		// Move a READY bitmap out. A FAILED id returns false and is forgotten.
+		bool take(const uint64_t id, Bitmap& out);
+
+		State state(const uint64_t id) const;
+		size_t pending() const;
+
+		operator ALLEGRO_EVENT_SOURCE* () const;
+	};
+
+}
\ No newline at end of file
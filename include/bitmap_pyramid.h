@@ -0,0 +1,69 @@
+#pragma once
+
+#include "bitmap.h"
+
+#include <allegro5/allegro.h>
+
+#include <stddef.h>
+
+#include <vector>
+
+namespace AllegroCPP {
+
+	enum class pyramid_filter {
+		BOX,		// average of the covered area, exact 2x2 for even sizes
+		LANCZOS3	// sharper, slower
+	};
+
+	enum class pyramid_layout {
+		SEPARATE,	// one Bitmap per level, level 0 is a ref of the source
+		SHEET		// all levels in one Bitmap (level 0 left, the rest stacked on its right), levels are sub bitmaps of it
+	};
+
+	struct pyramid_options {
+		pyramid_filter filter = pyramid_filter::BOX;
+		pyramid_layout layout = pyramid_layout::SEPARATE;
+		bool gamma_correct = false;	// filter sRGB colors in linear light (alpha stays linear)
+		size_t max_levels = 0;		// level 0 included, 0 is down to 1x1
+		int padding = 1;			// SHEET: empty pixels between levels so linear filtering doesn't bleed
+		int flags = ALLEGRO_MEMORY_BITMAP; // of the new bitmaps
+		int format = 0;				// of the new bitmaps, 0 is the source format
+	};
+
+	// Halved levels of a Bitmap built on the CPU (SSE over float RGBA, premultiplied as Allegro keeps it), each level from the one above.
+	// Draw with the level closest to the scale you need instead of minifying the full size every time.
+	class Bitmap_pyramid {
+		std::vector<Bitmap> m_levels;
+		Bitmap m_sheet;
+	public:
+		Bitmap_pyramid() = default;
+		Bitmap_pyramid(const Bitmap& src, const pyramid_options& opts = {});
+
+		Bitmap_pyramid(const Bitmap_pyramid&) = delete;
+		Bitmap_pyramid(Bitmap_pyramid&&) noexcept;
+		void operator=(const Bitmap_pyramid&) = delete;
+		void operator=(Bitmap_pyramid&&) noexcept;
+
+		bool build(const Bitmap& src, const pyramid_options& opts = {});
+		void destroy();
+
+		bool empty() const;
+		size_t size() const;
+		Bitmap& level(const size_t);
+		const Bitmap& level(const size_t) const;
+		// Only with pyramid_layout::SHEET, else empty.
+		const Bitmap& sheet() const;
+
+		// Smallest level still at least as big as the source drawn at scale. remaining_scale is what to draw that level with.
+		size_t level_for_scale(const float scale) const;
+		Bitmap& for_scale(const float scale, float* remaining_scale = nullptr);
+
+		// Draw at target as the source scaled by scale, using for_scale(). Other draw properties of the level are kept.
+		bool draw(const float target_x, const float target_y, const float scale, const int flags = 0);
+	};
+
+	// One resample of src to width x height (thumbnails), through the same filters. Throws on invalid sizes or a failed create.
+	Bitmap downscale_bitmap(const Bitmap& src, const int width, const int height, const pyramid_filter filter = pyramid_filter::LANCZOS3, const bool gamma_correct = true,
+		const int flags = ALLEGRO_MEMORY_BITMAP, const int format = 0);
+
+}
\ No newline at end of file
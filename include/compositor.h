@@ -0,0 +1,44 @@
+#pragma once
+
+#include "pixel_view.h"
+
+#include <allegro5/allegro.h>
+
+namespace AllegroCPP {
+
+	// How source pixels land on the target (s source, d target, a source alpha after tint, all channels alike):
+	// COPY: s. ALPHA: s * a + d * (1 - a) (ALPHA, INVERSE_ALPHA). PREMULTIPLIED: s + d * (1 - a) (ONE, INVERSE_ALPHA, Allegro's default).
+	enum class composite_blend { COPY, ALPHA, PREMULTIPLIED };
+	enum class composite_filter { NEAREST, LINEAR };
+
+	// Pixels in memory, in any format pixel_convert_supported() takes. data is the first row, pitch may be negative.
+	struct composite_surface {
+		void* data = nullptr;
+		int pitch = 0;
+		int format = 0;
+		int width = 0, height = 0;
+	};
+
+	struct composite_options {
+		composite_blend blend = composite_blend::PREMULTIPLIED;
+		composite_filter filter = composite_filter::NEAREST;
+		pixel_rgba8 tint = { 255, 255, 255, 255 }; // multiplies the source before blending
+		int flags = 0; // ALLEGRO_FLIP_HORIZONTAL, ALLEGRO_FLIP_VERTICAL
+		int clip_x = 0, clip_y = 0, clip_width = -1, clip_height = -1; // target pixels that may change, negative size is the whole target
+	};
+
+	// Software blitter working on rgba8 rows with SSE2 (scaling, tint, blend) and pixel_convert for the formats.
+	// Source rect (sx, sy, sw, sh) is stretched over target rect (dx, dy, dw, dh), pixels whose center is inside are written.
+	// False if a format isn't supported or the rects are invalid. Nothing visible is fine (true).
+	bool composite(const composite_surface& src, const float sx, const float sy, const float sw, const float sh,
+		const composite_surface& dst, const float dx, const float dy, const float dw, const float dh, const composite_options& opts = {});
+
+	// Same on two memory bitmaps (or sub bitmaps of them), locking only the regions involved.
+	// They must not share a parent, it doesn't handle overlap.
+	bool composite(ALLEGRO_BITMAP* src, const float sx, const float sy, const float sw, const float sh,
+		ALLEGRO_BITMAP* dst, const float dx, const float dy, const float dw, const float dh, const composite_options& opts = {});
+
+	// True if drawing src onto dst can be done by composite(): both memory bitmaps, different roots, formats supported, none locked.
+	bool composite_supported(ALLEGRO_BITMAP* src, ALLEGRO_BITMAP* dst);
+
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+#pragma once
+
+// SIMD paths are compiled per function with ALLEGROCPP_TARGET and picked at runtime through _cpu_features::get(),
+// so they run without -m flags on the whole build.
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define ALLEGROCPP_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(ALLEGROCPP_X86) && (defined(__GNUC__) || defined(__clang__))
+#define ALLEGROCPP_TARGET(x) __attribute__((target(x)))
+#else
+#define ALLEGROCPP_TARGET(x) // MSVC allows any intrinsic in any function
+#endif
+
+namespace AllegroCPP {
+
+	// Shared by the SIMD paths of File, hashing and pixel conversion.
+	namespace _cpu_features {
+
+		struct flags {
+			bool ssse3 = false;
+			bool sse42 = false;
+			bool avx2 = false;
+		};
+
+		inline flags detect()
+		{
+			flags f;
+#if defined(ALLEGROCPP_X86) && defined(_MSC_VER) && !defined(__clang__)
+			int r[4];
+			__cpuid(r, 0);
+			const int max_leaf = r[0];
+			__cpuid(r, 1);
+			f.ssse3 = (r[2] & (1 << 9)) != 0;
+			f.sse42 = (r[2] & (1 << 20)) != 0;
+			const bool os_avx = (r[2] & (1 << 27)) != 0 && (r[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6; // OSXSAVE, AVX, ymm state enabled
+			if (os_avx && max_leaf >= 7) {
+				__cpuidex(r, 7, 0);
+				f.avx2 = (r[1] & (1 << 5)) != 0;
+			}
+#elif defined(ALLEGROCPP_X86)
+			__builtin_cpu_init();
+			f.ssse3 = __builtin_cpu_supports("ssse3");
+			f.sse42 = __builtin_cpu_supports("sse4.2");
+			f.avx2 = __builtin_cpu_supports("avx2");
+#endif
+			return f;
+		}
+
+		inline const flags& get()
+		{
+			static const flags f = detect();
+			return f;
+		}
+
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "display.h"
+
+#include <allegro5/allegro.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace AllegroCPP {
+
+	struct damage_rect {
+		int x, y, width, height;
+	};
+
+	struct damage_stats {
+		size_t presents = 0;
+		size_t full_flips = 0;
+		size_t region_updates = 0; // update_region calls, one per rect
+		uint64_t pixels_presented = 0;
+	};
+
+	// Collects what was drawn on a Display's backbuffer since the last present, so present() can update only those regions.
+	// Bitmap::draw, Font::draw and Vertexes::draw report into it while the backbuffer is the target (see damage_report).
+	// Regions are only used if the display supports ALLEGRO_UPDATE_DISPLAY_REGION, else present() is a plain flip.
+	class Damage_tracker {
+		std::weak_ptr<ALLEGRO_DISPLAY> m_disp;
+		ALLEGRO_BITMAP* m_backbuffer = nullptr;
+		mutable std::mutex m_mtx;
+		std::vector<damage_rect> m_rects; // merged as they come, never overlapping
+		size_t m_max_rects;
+		float m_full_ratio;
+		bool m_full = true; // first frame has to go whole
+		damage_stats m_stats;
+
+		void merge_in(damage_rect);
+	public:
+		// Above max_rects the closest rects are joined. If the damaged area is over full_flip_ratio of the display, present() flips.
+		Damage_tracker(Display& disp, const size_t max_rects = 16, const float full_flip_ratio = 0.5f);
+		~Damage_tracker();
+
+		Damage_tracker(const Damage_tracker&) = delete;
+		Damage_tracker(Damage_tracker&&) = delete;
+		void operator=(const Damage_tracker&) = delete;
+		void operator=(Damage_tracker&&) = delete;
+
+		// Backbuffer pixels, no transform applied. Clipped to the display.
+		void add(const int pos_x, const int pos_y, const int width, const int height);
+		void add(const damage_rect&);
+		// Next present() is a full flip (resize, expose, clear_to_color...).
+		void invalidate();
+
+		std::vector<damage_rect> get_pending() const;
+		bool is_full() const;
+
+		// update_region() for each rect, or flip() when that's cheaper. Nothing damaged means nothing is sent. Pending damage is cleared.
+		bool present();
+
+		void set_max_rects(const size_t);
+		void set_full_flip_ratio(const float);
+		damage_stats get_stats() const;
+	};
+
+	// True while any Damage_tracker exists. Check it before working out bounds to report, the common case is no tracker at all.
+	bool damage_tracking_active();
+	// Report a rect drawn with the current transform on the current target. Goes to the tracker watching the target (sub bitmaps of the backbuffer too), if any.
+	// Cheap when no tracker exists.
+	void damage_report(const float pos_x, const float pos_y, const float width, const float height);
+	// Whole current target changed.
+	void damage_report_all();
+
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "bitmap.h"
+#include "font.h"
+#include "vertex.h"
+
+#include <allegro5/allegro.h>
+
+#include <stdint.h>
+
+#include <unordered_map>
+#include <vector>
+
+namespace AllegroCPP {
+
+	// Draw calls recorded into a byte stream of plain structs, replayed on the current target as many times as needed.
+	// Bitmaps (and textures) are kept by reference, fonts and text by a snapshot, vertexes are copied into the stream.
+	// Recording makes no Allegro calls, so it can happen on any thread (one thread per buffer). Replay where you draw.
+	class Draw_command_buffer {
+	public:
+		enum class command : uint8_t { BITMAP, TEXT, GLYPH, VERTEXES, CLEAR, BLENDER, BLEND_COLOR };
+	private:
+		std::vector<uint8_t> m_stream;
+		std::vector<Bitmap> m_bitmaps; // refs, draw properties are set from the stream on replay
+		std::unordered_map<ALLEGRO_BITMAP*, uint32_t> m_bitmap_index;
+		std::vector<Font> m_fonts; // one snapshot per text command
+		size_t m_commands = 0;
+
+		uint32_t bitmap_slot(const Bitmap&);
+		template<typename T> void push(const command, const T&, const void* extra = nullptr, const size_t extra_len = 0);
+	public:
+		Draw_command_buffer() = default;
+
+		Draw_command_buffer(const Draw_command_buffer&) = delete;
+		Draw_command_buffer(Draw_command_buffer&&) noexcept;
+		void operator=(const Draw_command_buffer&) = delete;
+		void operator=(Draw_command_buffer&&) noexcept;
+
+		// Bitmap::draw() with the stored draw properties as they are now (position and flags replaced in the second one).
+		bool record(const Bitmap&);
+		bool record(const Bitmap&, const float target_x, const float target_y, const int flags = 0);
+		// Font::draw() with its draw properties now (position and text replaced in the second one).
+		bool record(const Font&);
+		bool record(const Font&, const float target_x, const float target_y, const UTFstring&);
+		bool record_glyph(const Font&, const float target_x, const float target_y, const int codepoint, const ALLEGRO_COLOR color = al_map_rgb(255, 255, 255));
+		// Vertexes::draw() with a copy of the points now.
+		bool record(const Vertexes&);
+		void record_clear(const ALLEGRO_COLOR color = al_map_rgb(0, 0, 0));
+		void record_blender(const int op, const int src, const int dst);
+		void record_blender(const int op, const int src, const int dst, const int alpha_op, const int alpha_src, const int alpha_dst);
+		void record_blend_color(const ALLEGRO_COLOR);
+
+		// Commands of another buffer after these (workers record parts of a scene, the render thread joins them in order).
+		void append(const Draw_command_buffer&);
+
+		// Run everything on the current target. Bitmap and text runs are held (al_hold_bitmap_drawing).
+		// Blender and blend color are put back as they were after it. Not to be called while recording into the same buffer.
+		bool replay();
+
+		void clear();
+		bool empty() const;
+		size_t size() const; // commands
+		size_t stream_bytes() const;
+	};
+
+}
\ No newline at end of file
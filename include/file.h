@@ -73,6 +73,15 @@ constexpr int SocketTimeout = 0;
 #include <iostream>
 #include <sstream>
 #include <functional>
+#include <atomic>
+#include <mutex>
+#include <deque>
+#include <span>
+#include <bit>
+#include <type_traits>
+#include <string_view>
+#include <iterator>
+#include <ranges>
 
 namespace AllegroCPP {
 
@@ -81,14 +90,51 @@ namespace AllegroCPP {
 		int err;
 	};
 
+	struct socket_rate_stats {
+		uint64_t bytes_sent = 0;
+		uint64_t bytes_deferred = 0; // not allowed right away: waited for or queued by write(), or left unsent by write_some()
+		uint64_t throttled_writes = 0;
+		double rate = 0.0; // bytes per second, 0 is unlimited
+		double available = 0.0; // tokens right now
+	};
+
 	using File_shareable_ptr = std::shared_ptr<std::unique_ptr<ALLEGRO_FILE,std::function<void(ALLEGRO_FILE*)>>>;
 
+	File_shareable_ptr make_shareable_file(ALLEGRO_FILE* fp, std::function<void(ALLEGRO_FILE*)> destr);
+
+	// Shared between a File and its cursors. Holds the ALLEGRO_FILE alive so a borrowed descriptor stays open.
+	struct file_positional_source {
+		File_shareable_ptr keep;
+		int fd = -1; // pread on this if set, else seek + read on keep under mtx
+		bool owns_fd = false;
+		std::mutex mtx;
+
+		file_positional_source(File_shareable_ptr, const int fd, const bool owns_fd);
+		~file_positional_source();
+
+		size_t read_at(const int64_t offset, void* buf, const size_t len);
+		int64_t size();
+	};
+
+	// Reverse the bytes of each element (width 2, 4 or 8) with SSSE3/AVX2/NEON when available. dst may be src.
+	void byteswap_array(void* dst, const void* src, const size_t count, const size_t width);
+
+	class File_cursor;
+	class File_lines;
+
 	class File {
 	protected:
 		//ALLEGRO_FILE* m_fp = nullptr;
 		File_shareable_ptr m_fp;
 		std::string m_curr_path;
+		int m_fd = -1; // known OS descriptor (owned by m_fp), if any
+		bool m_native_path = false; // m_curr_path can be opened by the OS directly (stdio interface)
+		bool m_split_value = false; // read_array/write_array stopped inside a value, an error until the next seek
+		std::shared_ptr<file_positional_source> m_positional;
+		std::mutex m_positional_mtx;
 		File() = default;
+
+		std::shared_ptr<file_positional_source> get_positional();
 	public:
 		File(const std::string& path, const std::string& mode = "wb+");
 		File(const std::string& path, const ALLEGRO_FILE_INTERFACE* interfac, const std::string& mode = "wb+");
@@ -131,6 +177,55 @@ namespace AllegroCPP {
 		virtual size_t write32le(int32_t);
 		virtual size_t write32be(int32_t);
 
+		// Bulk read of 8/16/32/64 bit integers or floats stored with that byte order. Returns elements read.
+		// A value cut short (the stream ended in the middle of one) is lost and sets has_error() until the next seek.
+		template<typename T, size_t E>
+		size_t read_array(std::span<T, E> arr, const std::endian order = std::endian::little)
+		{
+			static_assert(!std::is_const_v<T>, "read_array needs a writable span");
+			static_assert(std::is_arithmetic_v<T> && (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8), "read_array works on 8/16/32/64 bit integers and floats");
+			const size_t bytes = read(arr.data(), arr.size_bytes());
+			const size_t got = bytes / sizeof(T);
+			if (bytes % sizeof(T) != 0) m_split_value = true;
+			if (sizeof(T) > 1 && order != std::endian::native) byteswap_array(arr.data(), arr.data(), got, sizeof(T));
+			return got;
+		}
+
+		// Bulk write of 8/16/32/64 bit integers or floats with that byte order. Returns elements written. Part of a value written sets has_error() like read_array.
+		template<typename T, size_t E>
+		size_t write_array(std::span<T, E> arr, const std::endian order = std::endian::little)
+		{
+			static_assert(std::is_arithmetic_v<T> && (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8), "write_array works on 8/16/32/64 bit integers and floats");
+			if (sizeof(T) == 1 || order == std::endian::native) {
+				const size_t bytes = write(arr.data(), arr.size_bytes());
+				if (bytes % sizeof(T) != 0) m_split_value = true;
+				return bytes / sizeof(T);
+			}
+
+			alignas(32) unsigned char buf[1 << 12];
+			constexpr size_t per_block = sizeof(buf) / sizeof(T);
+			size_t done = 0;
+			while (done < arr.size()) {
+				const size_t now = (arr.size() - done) < per_block ? (arr.size() - done) : per_block;
+				byteswap_array(buf, arr.data() + done, now, sizeof(T));
+				const size_t wrote = write(buf, now * sizeof(T));
+				done += wrote / sizeof(T);
+				if (wrote % sizeof(T) != 0) m_split_value = true;
+				if (wrote != now * sizeof(T)) break;
+			}
+			return done;
+		}
+
+		template<typename T>
+		size_t read_array(T* ptr, const size_t count, const std::endian order = std::endian::little) { return read_array(std::span<T>(ptr, count), order); }
+		template<typename T>
+		size_t write_array(const T* ptr, const size_t count, const std::endian order = std::endian::little) { return write_array(std::span<const T>(ptr, count), order); }
+		// Any contiguous range of them: std::vector, std::array, C arrays...
+		template<std::ranges::contiguous_range R> requires std::ranges::sized_range<R>
+		size_t read_array(R&& range, const std::endian order = std::endian::little) { return read_array(std::span(std::ranges::data(range), std::ranges::size(range)), order); }
+		template<std::ranges::contiguous_range R> requires std::ranges::sized_range<R>
+		size_t write_array(R&& range, const std::endian order = std::endian::little) { return write_array(std::span(std::ranges::data(range), std::ranges::size(range)), order); }
+
 		virtual File& operator<<(const char* val);
 		virtual File& operator<<(const std::string& val);
 		virtual File& operator<<(const std::vector<char>& val);
@@ -180,9 +275,85 @@ namespace AllegroCPP {
 
 		File clone_for_read() const;
 
+		// Read at offset without touching the file position. Uses pread when there is a descriptor, so it is safe from many threads.
+		// Buffered writes are not visible until flush().
+		virtual size_t read_at(const int64_t offset, void* buf, const size_t len);
+		// Independent read position over [begin, begin + length) sharing this file descriptor. length < 0 means until the end.
+		File_cursor make_cursor(const int64_t begin = 0, const int64_t length = -1);
+		// Range of lines read in big chunks from the current position. See File_lines.
+		File_lines lines(const size_t chunk = 1 << 16);
+
 		void close();
 	};
 
+	// Cheap to copy. Each copy has its own position, all of them share the same descriptor.
+	class File_cursor {
+		std::shared_ptr<file_positional_source> m_src;
+		int64_t m_begin = 0;
+		int64_t m_length = 0;
+		int64_t m_pos = 0;
+	public:
+		File_cursor() = default;
+		File_cursor(std::shared_ptr<file_positional_source> src, const int64_t begin, const int64_t length);
+
+		bool empty() const;
+		bool valid() const;
+		operator bool() const;
+
+		size_t read(void*, const size_t);
+		size_t read_at(const int64_t offset, void* buf, const size_t len); // relative to begin
+		bool seek(const int64_t offset, const int whence);
+		int64_t tell() const;
+		int64_t size() const;
+		bool eof() const;
+
+		// Cursor over a sub range of this one, relative to begin.
+		File_cursor slice(const int64_t begin, const int64_t length = -1) const;
+	};
+
+	// Line by line reading without per line allocation. Lines are string_views into an internal buffer (no '\n', trailing '\r' removed),
+	// valid until the next line is taken. Lines longer than the chunk grow the buffer. The File must outlive this.
+	class File_lines {
+		File* m_file = nullptr;
+		std::vector<char> m_buf;
+		size_t m_beg = 0, m_end = 0;
+		bool m_eof = false;
+	public:
+		class iterator {
+			File_lines* m_src = nullptr; // null is end
+			std::string_view m_line;
+		public:
+			using iterator_category = std::input_iterator_tag;
+			using value_type = std::string_view;
+			using difference_type = std::ptrdiff_t;
+			using pointer = const std::string_view*;
+			using reference = const std::string_view&;
+
+			iterator() = default;
+			iterator(File_lines*);
+
+			reference operator*() const;
+			pointer operator->() const;
+			iterator& operator++();
+			void operator++(int);
+			bool operator==(const iterator&) const;
+		};
+
+		File_lines(File&, const size_t chunk = 1 << 16);
+
+		File_lines(const File_lines&) = delete;
+		File_lines(File_lines&&) noexcept = default;
+		void operator=(const File_lines&) = delete;
+		File_lines& operator=(File_lines&&) noexcept = default;
+
+		// False when there is nothing left.
+		bool next(std::string_view& line);
+
+		iterator begin();
+		iterator end();
+	};
+
+	// On Linux this is an anonymous file (O_TMPFILE, or memfd as fallback): no directory entry, path is /proc/self/fd/N.
 	class File_tmp : public File {
 		//using File::drop; // remove access
 	public:
@@ -240,6 +411,29 @@ namespace AllegroCPP {
 			UDP_CLIENT
 		};
 
+		// Bytes per second shaping. rate 0 is unlimited. Tokens can go a little negative when shared by many sockets, it evens out.
+		// Sockets keep the same buckets for life and only reconfigure them, so writers never race on the pointers.
+		struct token_bucket {
+			std::mutex mtx;
+			std::atomic<bool> limited = false; // checked without the lock, unlimited buckets are skipped
+			double rate = 0.0;
+			double burst = 0.0;
+			double tokens = 0.0;
+			double last = 0.0;
+			uint64_t bytes_sent = 0;
+			uint64_t bytes_deferred = 0;
+			uint64_t throttled_writes = 0;
+
+			void configure(const double rate, const double burst);
+			size_t allowance(const size_t want, const bool whole = false); // refills, how much could go now. whole: want or 0, want above burst needs a full bucket
+			double wait_for(const size_t need); // refills, seconds until need tokens (at most burst) are there
+			void consume(const size_t sent);
+			void deferred(const size_t held);
+			socket_rate_stats stats();
+		private:
+			void refill();
+		};
+
 		struct socket_user_data {
 			struct _eachsock {
 				SocketType sock = SocketInvalid;
@@ -252,6 +446,13 @@ namespace AllegroCPP {
 			int32_t badflag = 0;
 			std::string original_addr;
 			uint16_t original_port;
+			const std::shared_ptr<token_bucket> m_bucket = std::make_shared<token_bucket>(); // this socket alone
+			std::shared_ptr<token_bucket> m_host_bucket; // host: total of accepted clients. Clients: the host's one. Set before the socket is in use
+			std::atomic<double> m_client_rate = 0.0, m_client_burst = 0.0; // host: applied to accepted clients
+			std::mutex m_out_mtx; // m_out, and the order of what goes out while it is in use
+			std::deque<std::vector<uint8_t>> m_out; // accepted clients: what the limits held back, sent before anything new. One datagram per entry on UDP
+			size_t m_out_sent = 0; // of m_out.front()
+			std::atomic<size_t> m_out_bytes = 0;
 			bool has_host() const;
 			void close_auto();
 		};
@@ -277,6 +478,13 @@ namespace AllegroCPP {
 		// tcp client and udp client return like recv. host expects void* to be socket_user_data and size == sizeof that (gets final value there)
 		size_t sock_read(ALLEGRO_FILE* fp, void* ptr, size_t size);
 		size_t sock_write(ALLEGRO_FILE* fp, const void* ptr, size_t size);
+		// sock_write with wait: TCP sends everything, waiting for tokens as needed. Without, only what the limits allow now. UDP: the whole datagram or nothing.
+		size_t sock_send(socket_user_data* sud, const void* ptr, const size_t size, const bool wait, const bool count_held = true);
+		constexpr size_t max_out_queue = static_cast<size_t>(1) << 22; // bytes queued per accepted client, writes past it come back short
+		// m_out_mtx held: send what is queued, in order, as far as the limits allow now. True once the queue is empty.
+		bool sock_drain(socket_user_data* sud);
+		// sock_write of accepted clients: never waits, what the limits hold back is queued and goes out first later. Returns bytes sent or queued.
+		size_t sock_write_queued(socket_user_data* sud, const void* ptr, const size_t size);
 		bool sock_flush(ALLEGRO_FILE* fp);
 		int64_t sock_tell(ALLEGRO_FILE* fp);
 		bool sock_seek(ALLEGRO_FILE* fp, int64_t offset, int whence);
@@ -289,7 +497,7 @@ namespace AllegroCPP {
 
 		std::vector<socket_user_data::_eachsock>::const_iterator sock_listen(const std::vector<socket_user_data::_eachsock>& servers, const long timeout);
 		SocketType sock_listen(const std::vector<SocketType>& servers, const long timeout);
-		void setsocktimeout_auto(SocketType, unsigned long ms);
+		void setsocktimeout_auto(SocketType, unsigned long ms, const int option = SO_RCVTIMEO);
 		
 		static ALLEGRO_FILE_INTERFACE socket_interface =
 		{
@@ -387,6 +595,24 @@ namespace AllegroCPP {
 		void operator=(File_client&&) noexcept;
 
 		bool set_timeout_read(const unsigned long ms);
+		// A send that can't go out within ms (peer not reading) fails, leaving the client invalid. 0 waits forever.
+		bool set_timeout_write(const unsigned long ms);
+		// True when read() would not block (data, disconnect or error) within timeout_ms. Negative waits forever.
+		bool wait_for_data(const long timeout_ms);
+
+		// Shape what this client sends. Counters move only while limited. burst 0 is rate / 10 (at least one 1500 byte packet). rate 0 removes the limit.
+		// Over the limit, write() on a client of its own waits for tokens and sends everything. On a client accepted by a File_host it never waits (one slow client
+		// must not stall the host loop): what is held back is queued, up to _socketmap::max_out_queue, and goes out first on later writes or send_queued().
+		// write_some() never waits nor queues.
+		bool set_rate_limit(const double bytes_per_second, const double burst_bytes = 0.0);
+		// write() that never waits for the limit: sends what it allows now (TCP) or the whole datagram or nothing (UDP). Returns the bytes sent, 0 while bytes are queued.
+		size_t write_some(const void* ptr, const size_t size);
+		// Accepted clients: bytes write() has queued. send_queued() sends them as far as the limits allow now, call it from the host loop for clients not written to.
+		size_t queued() const;
+		size_t send_queued();
+		socket_rate_stats get_rate_stats() const;
+		// Shared limit from the host that accepted this client, if any.
+		socket_rate_stats get_host_rate_stats() const;
 	};
 
 	class File_host : public _socketmap::_FileSocket {
@@ -404,6 +630,12 @@ namespace AllegroCPP {
 		bool combine(File_host&&);
 
 		File_client listen(const long timeout = 500);
+
+		// Total outbound rate of every client accepted by this host (uplink cap).
+		bool set_rate_limit(const double bytes_per_second, const double burst_bytes = 0.0);
+		// Limit given to each client accepted from now on.
+		bool set_client_rate_limit(const double bytes_per_second, const double burst_bytes = 0.0);
+		socket_rate_stats get_rate_stats() const;
 	};
 
 #endif // ALLEGROCPP_DISABLE_FILESOCKET
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "file.h"
+#include "thread.h"
+
+#include <allegro5/allegro.h>
+
+#include <stdint.h>
+
+#include <deque>
+#include <future>
+#include <string>
+#include <vector>
+
+namespace AllegroCPP {
+
+	namespace _compressmap {
+
+		// Fast LZ77 block codec (LZ4 style sequences, 64 KiB window).
+		size_t lz_bound(const size_t len);
+		// Returns compressed size, 0 if it does not fit in dst_cap.
+		size_t lz_compress(const void* src, const size_t len, void* dst, const size_t dst_cap);
+		// True only if src decodes to exactly raw_len bytes. Safe on corrupt input.
+		bool lz_decompress(const void* src, const size_t len, void* dst, const size_t raw_len);
+
+		struct compressed_config {
+			File_shareable_ptr base;
+			bool write = false;
+			size_t block_size = 0;
+			size_t read_ahead = 0;
+			Thread_pool* pool = nullptr;
+		};
+
+		struct compressed_user_data {
+			File_shareable_ptr base;
+			bool write = false;
+			size_t block_size = 0;
+			size_t read_ahead = 0;
+			Thread_pool* pool = nullptr;
+			int64_t position = 0; // uncompressed
+			int error = 0;
+			std::string errmsg;
+
+			// write
+			std::vector<uint8_t> pending;
+			std::vector<uint8_t> packed;
+			bool header_done = false;
+
+			// read
+			std::deque<std::future<std::vector<uint8_t>>> decoding; // in stream order
+			std::vector<uint8_t> current;
+			size_t current_pos = 0;
+			bool base_done = false;
+			int ungot = -1;
+		};
+
+		// compressed_config* and &(sizeof(compressed_config)) (as uint64_t)
+		void* comp_open(const char* conf, const char* intptr);
+		bool comp_close(ALLEGRO_FILE* fp);
+		size_t comp_read(ALLEGRO_FILE* fp, void* ptr, size_t size);
+		size_t comp_write(ALLEGRO_FILE* fp, const void* ptr, size_t size);
+		bool comp_flush(ALLEGRO_FILE* fp); // ends the current block early
+		int64_t comp_tell(ALLEGRO_FILE* fp);
+		bool comp_seek(ALLEGRO_FILE* fp, int64_t offset, int whence); // forward ALLEGRO_SEEK_CUR on read only
+		bool comp_eof(ALLEGRO_FILE* fp);
+		int comp_error(ALLEGRO_FILE* fp);
+		const char* comp_errmsg(ALLEGRO_FILE* fp);
+		void comp_clearerr(ALLEGRO_FILE* fp);
+		int comp_ungetc(ALLEGRO_FILE* fp, int c);
+		off_t comp_size(ALLEGRO_FILE* fp); // unknown, -1
+	}
+
+	// Compresses what is written to it into another File, or decompresses what is read from it.
+	// Stream: "ACZ1", then blocks of [raw size u32le][packed size u32le, top bit = stored][crc32c of raw u32le][data], ends with an all zero block header.
+	// Each block decodes on its own, so reading decodes up to read_ahead blocks at once on the pool. Read from a task of that same pool, blocks decode inline.
+	// Use read_ahead = 1 on sockets: it never waits for a block that is not needed yet.
+	class File_compressed : public File {
+	public:
+		enum class Mode { COMPRESS, DECOMPRESS };
+
+		File_compressed(File& base, const Mode mode, const size_t block_size = 1 << 16, const size_t read_ahead = 0, Thread_pool* pool = nullptr);
+
+		File_compressed(const File_compressed&) = delete;
+		File_compressed(File_compressed&&) noexcept;
+		void operator=(const File_compressed&) = delete;
+		void operator=(File_compressed&&) noexcept;
+	};
+
+}
\ No newline at end of file
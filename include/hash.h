@@ -0,0 +1,31 @@
+#pragma once
+
+#include "file.h"
+#include "thread.h"
+
+#include <stdint.h>
+
+namespace AllegroCPP {
+
+	// CRC32C (Castagnoli). Pass the previous result as crc to continue over more data. Uses SSE4.2 / ARMv8 CRC instructions when built for them.
+	uint32_t crc32c(const void* data, const size_t len, const uint32_t crc = 0);
+	// crc32c of A followed by B, from crc32c(A), crc32c(B) and the length of B.
+	uint32_t crc32c_combine(const uint32_t crc_a, const uint32_t crc_b, const uint64_t len_b);
+
+	uint64_t xxhash64(const void* data, const size_t len, const uint64_t seed = 0);
+
+	struct file_hash_options {
+		size_t chunk = static_cast<size_t>(1) << 22; // bytes per task
+		Thread_pool* pool = nullptr; // null uses Thread_pool::global(). Called from a task of this pool, hashing runs inline on that thread.
+	};
+
+	// Whole content through positional reads, chunks spread over the pool. Same value as hashing it in one go. Throws if a read fails.
+	uint32_t crc32c(File_cursor, const file_hash_options& = {});
+	uint32_t crc32c(File&, const file_hash_options& = {});
+
+	// Tree hash: xxhash64 of each chunk, then xxhash64 (same seed) of those little endian digests.
+	// Up to one chunk this equals xxhash64 of the content. Bigger files depend on the chunk size, keep it fixed when comparing.
+	uint64_t xxhash64_tree(File_cursor, const uint64_t seed = 0, const file_hash_options& = {});
+	uint64_t xxhash64_tree(File&, const uint64_t seed = 0, const file_hash_options& = {});
+
+}
\ No newline at end of file
@@ -11,6 +11,7 @@ namespace AllegroCPP {
 		ALLEGRO_BITMAP* m_locked = nullptr;
 		ALLEGRO_LOCKED_REGION* m_ptr = nullptr;
 		int m_format, m_flags;
+		int m_width = 0, m_height = 0;
 	public:
 		Locked_region(ALLEGRO_BITMAP* bmp, const int format = ALLEGRO_LOCK_READWRITE, const int flags = ALLEGRO_PIXEL_FORMAT_ANY);
 		Locked_region(ALLEGRO_BITMAP* bmp, const int pos_x, const int pos_y, const int width, const int height, const int format = ALLEGRO_LOCK_READWRITE, const int flags = ALLEGRO_PIXEL_FORMAT_ANY);
@@ -32,6 +33,8 @@ namespace AllegroCPP {
 		int get_format() const;
 		int get_pitch() const;
 		int get_pixel_size() const;
+		int get_width() const;
+		int get_height() const;
 
 		bool put_pixel(const int pos_x, const int pos_y, const ALLEGRO_COLOR color);
 		bool put_blended_pixel(const int pos_x, const int pos_y, const ALLEGRO_COLOR color);
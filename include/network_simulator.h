@@ -0,0 +1,122 @@
+#pragma once
+
+#include "file.h"
+#include "thread.h"
+
+#ifndef ALLEGROCPP_DISABLE_FILESOCKET
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace AllegroCPP {
+
+	enum class delay_distribution { CONSTANT, UNIFORM, NORMAL, EXPONENTIAL };
+
+	struct network_conditions {
+		double delay = 0.0; // seconds, one way
+		double jitter = 0.0; // seconds. UNIFORM: +-jitter, NORMAL: standard deviation, EXPONENTIAL: mean of the extra delay
+		delay_distribution distribution = delay_distribution::UNIFORM;
+		double drop = 0.0; // 0..1, UDP only (TCP can't lose bytes)
+		double bandwidth = 0.0; // bytes per second per direction, 0 is unlimited
+		uint32_t seed = 5489; // each direction of each connection has its own generator from it, so a run repeats packet for packet
+	};
+
+	struct network_simulator_stats {
+		uint64_t packets = 0;
+		uint64_t bytes = 0;
+		uint64_t dropped = 0;
+		uint64_t connections = 0;
+		double average_delay = 0.0; // seconds, including bandwidth queueing
+	};
+
+	// In process proxy for testing netcode: clients connect to listen_port, traffic is forwarded to target with the configured delay, jitter, loss and bandwidth.
+	// UDP serves one client: the first datagram sets up the path to target, later peers share it and replies go to whoever sent last.
+	// Jitter on UDP reorders packets, TCP keeps order.
+	class Network_simulator {
+		struct _endpoint {
+			File_client sock;
+			std::mutex mtx;
+			bool open = true;
+			_endpoint(File_client&&);
+		};
+		struct _direction { // one reader thread each, no lock
+			double next_free = 0.0;
+			double last_due = 0.0;
+			std::mt19937 rng;
+			uint32_t stream = 0; // seeds rng along with the conditions seed
+			uint64_t generation = 0; // of the conditions rng was seeded for
+		};
+		struct _connection {
+			std::shared_ptr<_endpoint> down, up; // accepted client, connection to target
+			_direction to_up, to_down;
+			Thread reader_up, reader_down;
+			std::atomic<int> readers_done = 0; // both: finished, pruned by the accepter
+		};
+		struct _packet {
+			double due;
+			uint64_t order;
+			double delay;
+			std::shared_ptr<_endpoint> dst;
+			std::vector<char> data; // empty: close dst
+			bool operator>(const _packet& o) const { return due != o.due ? due > o.due : order > o.order; }
+		};
+
+		const std::string m_target_addr;
+		const uint16_t m_target_port;
+		const file_protocol m_protocol;
+
+		network_conditions m_cond;
+		uint64_t m_cond_generation = 1;
+		std::mutex m_cond_mtx;
+
+		std::priority_queue<_packet, std::vector<_packet>, std::greater<_packet>> m_queue;
+		uint64_t m_order = 0;
+		std::mutex m_queue_mtx;
+		std::condition_variable m_queue_cv;
+
+		network_simulator_stats m_stats;
+		double m_delay_sum = 0.0;
+		mutable std::mutex m_stats_mtx;
+
+		std::unique_ptr<File_host> m_host;
+		std::vector<std::unique_ptr<_connection>> m_connections;
+		std::mutex m_conn_mtx;
+		std::atomic<bool> m_running = true;
+		Thread m_accepter;
+		Thread m_scheduler;
+
+		bool accept_once();
+		void prune_finished();
+		bool schedule_once();
+		bool pump(const std::shared_ptr<_endpoint>& src, const std::shared_ptr<_endpoint>& dst, _direction& dir);
+		void enqueue(const std::shared_ptr<_endpoint>& dst, _direction& dir, std::vector<char>&& data);
+	public:
+		Network_simulator(const uint16_t listen_port, const std::string& target_addr, const uint16_t target_port, const file_protocol protocol = file_protocol::TCP, const network_conditions& = {});
+		~Network_simulator();
+
+		Network_simulator(const Network_simulator&) = delete;
+		Network_simulator(Network_simulator&&) = delete;
+		void operator=(const Network_simulator&) = delete;
+		void operator=(Network_simulator&&) = delete;
+
+		// Applies to packets read from now on.
+		void set_conditions(const network_conditions&);
+		network_conditions get_conditions();
+
+		network_simulator_stats get_stats() const;
+
+		// Stop forwarding and close everything. Also done on destruction.
+		void stop();
+	};
+
+}
+
+#endif // ALLEGROCPP_DISABLE_FILESOCKET
\ No newline at end of file
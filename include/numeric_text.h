@@ -0,0 +1,60 @@
+#pragma once
+
+#include <charconv>
+#include <string>
+#include <type_traits>
+
+namespace AllegroCPP {
+
+	// Shared by File and Text_log stream operators. Formats on the stack, no locale, no allocation.
+	namespace _numeric_text {
+
+		constexpr size_t buffer_size = 128;
+
+		// Calls fn(const char*, size_t) with the text of val. Integers as decimal, floating point like std::to_string (fixed, 6 digits).
+		template<typename T, typename Fn>
+		void format(const T val, Fn&& fn)
+		{
+			char buf[buffer_size];
+			std::to_chars_result res;
+			if constexpr (std::is_floating_point_v<T>) res = std::to_chars(buf, buf + buffer_size, val, std::chars_format::fixed, 6);
+			else res = std::to_chars(buf, buf + buffer_size, val);
+
+			if (res.ec == std::errc{}) fn(static_cast<const char*>(buf), static_cast<size_t>(res.ptr - buf));
+			else { // huge floating point value, rare
+				const auto str = std::to_string(val);
+				fn(str.data(), str.size());
+			}
+		}
+
+		// Characters that can be part of a number of type T.
+		template<typename T>
+		bool accepts(const char c)
+		{
+			if (c >= '0' && c <= '9') return true;
+			if constexpr (std::is_floating_point_v<T>) return c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+			else if constexpr (std::is_signed_v<T>) return c == '-' || c == '+';
+			else return c == '+';
+		}
+
+		// Parse [buf, buf + len) into val. Leading '+' is allowed. On failure val = 0 and false.
+		template<typename T>
+		bool parse(const char* buf, const size_t len, T& val)
+		{
+			const char* beg = buf;
+			const char* end = buf + len;
+			if (beg != end && *beg == '+') ++beg;
+
+			std::from_chars_result res;
+			if constexpr (std::is_floating_point_v<T>) res = std::from_chars(beg, end, val, std::chars_format::general);
+			else res = std::from_chars(beg, end, val);
+
+			if (res.ec != std::errc{} || beg == end) {
+				val = 0;
+				return false;
+			}
+			return true;
+		}
+
+	}
+}
\ No newline at end of file
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "locked_region.h"
+
+#include <allegro5/allegro.h>
+
+#include <stddef.h>
+
+namespace AllegroCPP {
+
+	// Formats handled here: ARGB/RGBA/ABGR/XRGB/XBGR 8888, ABGR 8888 LE, RGB 565, RGBA/ARGB 4444, RGBA 5551, single channel 8 and ABGR F32 (same as pixel_traits).
+	// 32 bit swizzles use SSSE3/AVX2 and 565, float and premultiply use SSE2 when built for them, anything else goes through rgba8 in cache sized chunks.
+	bool pixel_convert_supported(const int src_format, const int dst_format);
+
+	// count pixels, buffers must not overlap unless the formats are the same. False if a format isn't supported.
+	bool convert_pixels(const void* src, const int src_format, void* dst, const int dst_format, const size_t count);
+	// Rect of width x height with a pitch (bytes, may be negative) on each side.
+	bool convert_pixels(const void* src, const int src_pitch, const int src_format, void* dst, const int dst_pitch, const int dst_format, const int width, const int height);
+	// Whole src region into dst, clipped to the smaller of both.
+	bool convert_pixels(const Locked_region& src, Locked_region& dst);
+
+	// Color channels times alpha, and back (alpha 0 gives 0). Formats without alpha are left alone.
+	bool premultiply_alpha(void* data, const int format, const size_t count);
+	bool premultiply_alpha(Locked_region&);
+	bool unpremultiply_alpha(void* data, const int format, const size_t count);
+	bool unpremultiply_alpha(Locked_region&);
+
+}
\ No newline at end of file
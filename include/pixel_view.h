@@ -0,0 +1,211 @@
+#pragma once
+
+#include "locked_region.h"
+
+#include <allegro5/allegro.h>
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <type_traits>
+
+namespace AllegroCPP {
+
+	struct pixel_rgba8 {
+		uint8_t r, g, b, a;
+	};
+
+	namespace _pixel_view {
+
+		// n bit channel to 8 bits and back, rounded like Allegro's tables
+		template<int Bits>
+		inline uint8_t widen(const uint32_t v)
+		{
+			if constexpr (Bits == 8) return static_cast<uint8_t>(v);
+			else return static_cast<uint8_t>((v * 255 + ((1u << Bits) - 1) / 2) / ((1u << Bits) - 1));
+		}
+		template<int Bits>
+		inline uint32_t narrow(const uint8_t v)
+		{
+			if constexpr (Bits == 8) return v;
+			else return (static_cast<uint32_t>(v) * ((1u << Bits) - 1) + 127) / 255;
+		}
+
+		// One word per pixel, channel positions as in the ALLEGRO_PIXEL_FORMAT name (most significant first). Bits 0 means no such channel (alpha reads 255).
+		template<typename Word, int Rs, int Rb, int Gs, int Gb, int Bs, int Bb, int As, int Ab>
+		struct packed {
+			using type = Word;
+			static constexpr int bytes = sizeof(Word);
+
+			static pixel_rgba8 unpack(const Word p)
+			{
+				const uint32_t v = p;
+				return {
+					widen<Rb>((v >> Rs) & ((1u << Rb) - 1)),
+					widen<Gb>((v >> Gs) & ((1u << Gb) - 1)),
+					widen<Bb>((v >> Bs) & ((1u << Bb) - 1)),
+					Ab ? widen<(Ab ? Ab : 8)>((v >> As) & ((1u << Ab) - 1)) : static_cast<uint8_t>(255)
+				};
+			}
+			static Word pack(const pixel_rgba8 c)
+			{
+				uint32_t v = (narrow<Rb>(c.r) << Rs) | (narrow<Gb>(c.g) << Gs) | (narrow<Bb>(c.b) << Bs);
+				if constexpr (Ab > 0) v |= narrow<Ab>(c.a) << As;
+				return static_cast<Word>(v);
+			}
+		};
+
+	}
+
+	// Pixel type and rgba8 conversion of an ALLEGRO_PIXEL_FORMAT. Only the formats below, others don't compile.
+	template<int Format>
+	struct pixel_traits;
+
+	template<> struct pixel_traits<ALLEGRO_PIXEL_FORMAT_ARGB_8888> : _pixel_view::packed<uint32_t, 16, 8, 8, 8, 0, 8, 24, 8> {};
+	template<> struct pixel_traits<ALLEGRO_PIXEL_FORMAT_RGBA_8888> : _pixel_view::packed<uint32_t, 24, 8, 16, 8, 8, 8, 0, 8> {};
+	template<> struct pixel_traits<ALLEGRO_PIXEL_FORMAT_ABGR_8888> : _pixel_view::packed<uint32_t, 0, 8, 8, 8, 16, 8, 24, 8> {};
+	template<> struct pixel_traits<ALLEGRO_PIXEL_FORMAT_XRGB_8888> : _pixel_view::packed<uint32_t, 16, 8, 8, 8, 0, 8, 0, 0> {};
+	template<> struct pixel_traits<ALLEGRO_PIXEL_FORMAT_XBGR_8888> : _pixel_view::packed<uint32_t, 0, 8, 8, 8, 16, 8, 0, 0> {};
+	template<> struct pixel_traits<ALLEGRO_PIXEL_FORMAT_RGB_565> : _pixel_view::packed<uint16_t, 11, 5, 5, 6, 0, 5, 0, 0> {};
+	template<> struct pixel_traits<ALLEGRO_PIXEL_FORMAT_RGBA_4444> : _pixel_view::packed<uint16_t, 12, 4, 8, 4, 4, 4, 0, 4> {};
+	template<> struct pixel_traits<ALLEGRO_PIXEL_FORMAT_ARGB_4444> : _pixel_view::packed<uint16_t, 8, 4, 4, 4, 0, 4, 12, 4> {};
+	template<> struct pixel_traits<ALLEGRO_PIXEL_FORMAT_RGBA_5551> : _pixel_view::packed<uint16_t, 11, 5, 6, 5, 1, 5, 0, 1> {};
+
+	// Bytes R, G, B, A in memory on any endianness.
+	template<> struct pixel_traits<ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE> {
+		struct type { uint8_t r, g, b, a; };
+		static constexpr int bytes = 4;
+		static pixel_rgba8 unpack(const type p) { return { p.r, p.g, p.b, p.a }; }
+		static type pack(const pixel_rgba8 c) { return { c.r, c.g, c.b, c.a }; }
+	};
+
+	// Red only, reads as (r, 0, 0, 255) like Allegro does.
+	template<> struct pixel_traits<ALLEGRO_PIXEL_FORMAT_SINGLE_CHANNEL_8> {
+		using type = uint8_t;
+		static constexpr int bytes = 1;
+		static pixel_rgba8 unpack(const type p) { return { p, 0, 0, 255 }; }
+		static type pack(const pixel_rgba8 c) { return c.r; }
+	};
+
+	template<> struct pixel_traits<ALLEGRO_PIXEL_FORMAT_ABGR_F32> {
+		struct type { float r, g, b, a; };
+		static constexpr int bytes = 16;
+		static uint8_t to8(const float f) { return static_cast<uint8_t>(std::lround((std::clamp)(f, 0.0f, 1.0f) * 255.0f)); }
+		static pixel_rgba8 unpack(const type p) { return { to8(p.r), to8(p.g), to8(p.b), to8(p.a) }; }
+		static type pack(const pixel_rgba8 c) { return { c.r / 255.0f, c.g / 255.0f, c.b / 255.0f, c.a / 255.0f }; }
+	};
+
+	// Typed access to locked pixels (or any buffer with a pitch), no Allegro call per pixel.
+	// The pitch may be negative (bottom-up locks), data is always the first row. The view doesn't own anything, keep the lock alive.
+	template<int Format>
+	class pixel_view {
+	public:
+		using traits = pixel_traits<Format>;
+		using pixel = typename traits::type;
+		static constexpr int format = Format;
+	private:
+		uint8_t* m_data = nullptr;
+		ptrdiff_t m_pitch = 0;
+		int m_width = 0, m_height = 0;
+
+		// clip a w x h rect at x, y to the view. False if nothing is left.
+		bool clip(int& x, int& y, int& w, int& h) const
+		{
+			if (x < 0) { w += x; x = 0; }
+			if (y < 0) { h += y; y = 0; }
+			w = (std::min)(w, m_width - x);
+			h = (std::min)(h, m_height - y);
+			return w > 0 && h > 0;
+		}
+	public:
+		pixel_view() = default;
+		pixel_view(void* data, const int pitch, const int width, const int height)
+			: m_data(static_cast<uint8_t*>(data)), m_pitch(pitch), m_width(width), m_height(height)
+		{
+			if (!data || width < 0 || height < 0) throw std::invalid_argument("Invalid pixel buffer!");
+		}
+		pixel_view(Locked_region& lr)
+			: pixel_view(lr.get_data(), lr.get_pitch(), lr.get_width(), lr.get_height())
+		{
+			if (lr.get_format() != Format) throw std::invalid_argument("Locked region format doesn't match the view!");
+		}
+
+		int width() const { return m_width; }
+		int height() const { return m_height; }
+		int pitch() const { return static_cast<int>(m_pitch); }
+		bool empty() const { return m_width == 0 || m_height == 0; }
+
+		pixel* row(const int y) const { return reinterpret_cast<pixel*>(m_data + y * m_pitch); }
+		pixel& operator()(const int x, const int y) const { return row(y)[x]; }
+
+		pixel_rgba8 get_rgba(const int x, const int y) const { return traits::unpack(row(y)[x]); }
+		void set_rgba(const int x, const int y, const pixel_rgba8 c) const { row(y)[x] = traits::pack(c); }
+
+		ALLEGRO_COLOR get_color(const int x, const int y) const { const pixel_rgba8 c = get_rgba(x, y); return al_map_rgba(c.r, c.g, c.b, c.a); }
+		void set_color(const int x, const int y, const ALLEGRO_COLOR col) const { unsigned char r, g, b, a; al_unmap_rgba(col, &r, &g, &b, &a); set_rgba(x, y, { r, g, b, a }); }
+
+		void fill(const pixel v) const { fill(0, 0, m_width, m_height, v); }
+		void fill(int x, int y, int w, int h, const pixel v) const
+		{
+			if (!clip(x, y, w, h)) return;
+			for (int j = y; j < y + h; ++j) std::fill_n(row(j) + x, w, v);
+		}
+
+		// Same format rows are moved as bytes (overlap is fine), others are converted through rgba8. Clipped to both views.
+		template<int Src_format>
+		void copy_rect(const pixel_view<Src_format>& src, int src_x, int src_y, int w, int h, int dst_x, int dst_y) const
+		{
+			if (src_x < 0) { w += src_x; dst_x -= src_x; src_x = 0; }
+			if (src_y < 0) { h += src_y; dst_y -= src_y; src_y = 0; }
+			if (dst_x < 0) { w += dst_x; src_x -= dst_x; dst_x = 0; }
+			if (dst_y < 0) { h += dst_y; src_y -= dst_y; dst_y = 0; }
+			w = (std::min)({ w, src.width() - src_x, m_width - dst_x });
+			h = (std::min)({ h, src.height() - src_y, m_height - dst_y });
+			if (w <= 0 || h <= 0) return;
+
+			// same buffer going down: copy bottom-up so rows aren't overwritten before they are read
+			const bool backwards = static_cast<const void*>(src.row(0)) == static_cast<const void*>(row(0)) && dst_y > src_y;
+			for (int k = 0; k < h; ++k) {
+				const int j = backwards ? h - 1 - k : k;
+				if constexpr (Src_format == Format) {
+					memmove(row(dst_y + j) + dst_x, src.row(src_y + j) + src_x, static_cast<size_t>(w) * sizeof(pixel));
+				}
+				else {
+					const auto* s = src.row(src_y + j) + src_x;
+					pixel* d = row(dst_y + j) + dst_x;
+					for (int i = 0; i < w; ++i) d[i] = traits::pack(pixel_traits<Src_format>::unpack(s[i]));
+				}
+			}
+		}
+
+		// fn(pixel&) or fn(pixel&, x, y), row by row.
+		template<typename Fn>
+		void for_each_pixel(Fn&& fn) const
+		{
+			for (int y = 0; y < m_height; ++y) {
+				pixel* r = row(y);
+				for (int x = 0; x < m_width; ++x) {
+					if constexpr (std::is_invocable_v<Fn&, pixel&, int, int>) fn(r[x], x, y);
+					else fn(r[x]);
+				}
+			}
+		}
+
+		// this(x, y) = fn(src(x, y)) over the size both have. fn takes the source pixel and returns this format's pixel.
+		template<int Src_format, typename Fn>
+		void transform(const pixel_view<Src_format>& src, Fn&& fn) const
+		{
+			const int w = (std::min)(m_width, src.width());
+			const int h = (std::min)(m_height, src.height());
+			for (int y = 0; y < h; ++y) {
+				const auto* s = src.row(y);
+				pixel* d = row(y);
+				for (int x = 0; x < w; ++x) d[x] = fn(s[x]);
+			}
+		}
+	};
+
+}
\ No newline at end of file
@@ -0,0 +1,142 @@
+#pragma once
+
+#include "file.h"
+#include "events.h"
+#include "thread.h"
+
+#ifndef ALLEGROCPP_DISABLE_FILESOCKET
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace AllegroCPP {
+
+	enum class rpc_status : uint32_t { OK, FAILED, NO_METHOD, DISCONNECTED };
+
+	struct rpc_response {
+		uint32_t id = 0;
+		rpc_status status = rpc_status::DISCONNECTED;
+		std::vector<uint8_t> data;
+	};
+
+	namespace _rpc {
+
+		constexpr size_t header_size = 12; // [payload size u32][id u32][method or status u32], little endian
+		constexpr size_t max_payload = static_cast<size_t>(1) << 26;
+		constexpr double send_timeout = 5.0; // seconds a frame may take to go out before the peer is dropped (it stopped reading)
+
+		struct connection {
+			File_client sock;
+			std::mutex mtx; // read and write on sock
+			std::vector<uint8_t> in; // bytes read, not a whole frame yet
+			std::atomic<bool> open = true;
+
+			connection(File_client&&);
+			// Whole frame or nothing. Gives up after send_timeout (twice that at worst, a blocked write may wait it out), a frame cut short closes the connection.
+			bool send(const uint32_t id, const uint32_t code, const void* data, const size_t len);
+			// Wait a little for data and call fn(id, code, payload) for each whole frame. False once disconnected.
+			bool pump(const std::function<void(uint32_t, uint32_t, std::vector<uint8_t>&&)>& fn);
+		};
+
+	}
+
+	// Client side of a TCP connection to a Rpc_server. Requests are pipelined: call() doesn't wait, any number can be in flight and replies may come in any order.
+	// Replies come as futures or as events of type event_id on this event source (data1 is a std::any* holding the rpc_response, like Event_custom::emit).
+	// event_id must be a user event type (ALLEGRO_EVENT_TYPE_IS_USER), else the constructor throws.
+	class Rpc_client {
+		struct _waiter {
+			std::optional<std::promise<rpc_response>> promise; // empty: answer as event
+		};
+
+		std::shared_ptr<_rpc::connection> m_conn;
+		std::unordered_map<uint32_t, _waiter> m_waiting;
+		std::mutex m_wait_mtx;
+		uint32_t m_next_id = 1;
+		Event_custom m_event;
+		const int m_event_id;
+		Thread m_reader;
+
+		uint32_t start(const uint32_t method, const void* data, const size_t len, _waiter&& w);
+		void finish(rpc_response&& res);
+		void fail_all();
+	public:
+		Rpc_client(File_client&& connected, const int event_id = 1024);
+		Rpc_client(const std::string& addr, const uint16_t port, const int event_id = 1024);
+		~Rpc_client();
+
+		Rpc_client(const Rpc_client&) = delete;
+		Rpc_client(Rpc_client&&) = delete;
+		void operator=(const Rpc_client&) = delete;
+		void operator=(Rpc_client&&) = delete;
+
+		// Send a request. If the connection drops the future gets rpc_status::DISCONNECTED.
+		std::future<rpc_response> call(const uint32_t method, const void* data, const size_t len);
+		std::future<rpc_response> call(const uint32_t method, const std::vector<uint8_t>& data);
+
+		// Send a request, the reply goes to the event source. Returns the request id (the one in rpc_response), 0 if sending failed.
+		uint32_t call_event(const uint32_t method, const void* data, const size_t len);
+		uint32_t call_event(const uint32_t method, const std::vector<uint8_t>& data);
+
+		size_t in_flight();
+		bool connected() const;
+
+		// Disconnect now, everything in flight fails. Also done on destruction.
+		void close();
+
+		operator ALLEGRO_EVENT_SOURCE* () const;
+	};
+
+	// Serves requests from any number of Rpc_client. Each request runs on the pool as soon as it arrives, so slow ones don't hold the others back.
+	// The handler returns the status and fills reply. If it throws, the client gets rpc_status::FAILED.
+	class Rpc_server {
+	public:
+		using handler = std::function<rpc_status(const uint32_t method, const std::vector<uint8_t>& request, std::vector<uint8_t>& reply)>;
+	private:
+		struct _client {
+			std::shared_ptr<_rpc::connection> conn;
+			Thread reader;
+		};
+
+		const handler m_handler;
+		Thread_pool* const m_pool;
+		std::unique_ptr<File_host> m_host;
+		std::vector<std::unique_ptr<_client>> m_clients;
+		std::mutex m_clients_mtx;
+		std::atomic<bool> m_running = true;
+		Thread m_accepter;
+
+		size_t m_running_tasks = 0;
+		std::mutex m_tasks_mtx;
+		std::condition_variable m_tasks_cv;
+
+		bool accept_once();
+		void dispatch(const std::shared_ptr<_rpc::connection>& conn, const uint32_t id, const uint32_t method, std::vector<uint8_t>&& request);
+	public:
+		// Null pool uses Thread_pool::global().
+		Rpc_server(const uint16_t port, handler fn, Thread_pool* pool = nullptr);
+		~Rpc_server();
+
+		Rpc_server(const Rpc_server&) = delete;
+		Rpc_server(Rpc_server&&) = delete;
+		void operator=(const Rpc_server&) = delete;
+		void operator=(Rpc_server&&) = delete;
+
+		size_t client_count();
+
+		// Stop accepting, wait for running handlers and close every connection. Also done on destruction.
+		// Replies to a client that stopped reading are given up after _rpc::send_timeout, so this can't hang on one.
+		void stop();
+	};
+
+}
+
+#endif // ALLEGROCPP_DISABLE_FILESOCKET
\ No newline at end of file
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "file.h"
+
+#include <stdint.h>
+
+#include <vector>
+
+namespace AllegroCPP {
+
+	struct snapshot_delta_stats {
+		size_t bytes = 0; // written to the File
+		size_t changed = 0; // bytes that differ from the baseline
+		size_t runs = 0; // literal runs
+	};
+
+	// Delta of a binary snapshot against a baseline the other side already has (the last one it acked), for a File_memory or any File.
+	// Both are XORed, equal stretches become a skip count and differing ones a literal of XOR bytes: [len][baseline len] then [skip][literal size][bytes]... (LEB128 counts).
+	// Bytes past the end of the baseline compare against zero, so an empty baseline sends the whole snapshot. Returns false if writing failed.
+	bool snapshot_delta_encode(File& out, const void* baseline, const size_t baseline_len, const void* current, const size_t current_len, snapshot_delta_stats* stats = nullptr);
+	bool snapshot_delta_encode(File& out, const std::vector<uint8_t>& baseline, const std::vector<uint8_t>& current, snapshot_delta_stats* stats = nullptr);
+
+	// Rebuild the snapshot from the same baseline and a delta read from in.
+	// The File is read ahead, then seeked back to right after the delta. Files that can't seek (sockets) lose what was read past it, so send one delta per read there.
+	// False if the stream is broken, was made from a baseline of another size, or would be longer than max_len (few bytes of bad input can claim any size).
+	bool snapshot_delta_decode(File& in, const void* baseline, const size_t baseline_len, std::vector<uint8_t>& current, const size_t max_len = static_cast<size_t>(1) << 26);
+	bool snapshot_delta_decode(File& in, const std::vector<uint8_t>& baseline, std::vector<uint8_t>& current, const size_t max_len = static_cast<size_t>(1) << 26);
+
+}
\ No newline at end of file
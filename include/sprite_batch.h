@@ -0,0 +1,69 @@
+#pragma once
+
+#include "bitmap.h"
+
+#include <allegro5/allegro.h>
+
+#include <stdint.h>
+
+#include <vector>
+
+namespace AllegroCPP {
+
+	struct sprite_blend_state {
+		int op, src, dst, alpha_op, alpha_src, alpha_dst;
+		bool operator==(const sprite_blend_state&) const = default;
+	};
+
+	// Collects Bitmap draws and flushes them grouped by texture (the root parent of sub bitmaps) and blender, each group inside al_hold_bitmap_drawing.
+	// The blender is taken when a sprite is added, the target and transform when flushing. Bitmaps must live until flush().
+	class Sprite_batch {
+	public:
+		enum class Mode {
+			DEFERRED,	// keep submission order, consecutive sprites on the same texture share a group. Safe for overlapping sprites.
+			SORTED		// stable sort by blender then texture: fewest groups, overlap order between different textures is lost
+		};
+	private:
+		struct _sprite {
+			ALLEGRO_BITMAP* bmp;
+			ALLEGRO_BITMAP* texture;
+			uint32_t blend;
+			float sx, sy, sw, sh;
+			ALLEGRO_COLOR tint;
+			float cx, cy, dx, dy, xscale, yscale, angle;
+			int flags;
+		};
+
+		std::vector<_sprite> m_sprites;
+		std::vector<uint32_t> m_order;
+		std::vector<sprite_blend_state> m_blends;
+		Mode m_mode;
+		size_t m_last_groups = 0;
+
+		uint32_t current_blend();
+	public:
+		Sprite_batch(const Mode mode = Mode::SORTED, const size_t reserve = 1024);
+
+		Sprite_batch(const Sprite_batch&) = delete;
+		Sprite_batch(Sprite_batch&&) noexcept;
+		void operator=(const Sprite_batch&) = delete;
+		void operator=(Sprite_batch&&) noexcept;
+
+		// Same as Bitmap::draw(), with its stored draw properties (position and flags replaced in the second one, the Bitmap is not changed).
+		bool add(const Bitmap&);
+		bool add(const Bitmap&, const float target_x, const float target_y, const int flags = 0);
+		bool add(ALLEGRO_BITMAP*, const bitmap_cut&, const ALLEGRO_COLOR tint, const bitmap_rotate_transform&, const bitmap_scale&, const bitmap_position_and_flags&);
+
+		// Draw everything on the current target and clear. Returns how many groups (texture or blender switches) it took.
+		size_t flush();
+		void clear();
+
+		void set_mode(const Mode);
+		Mode get_mode() const;
+
+		size_t size() const;
+		bool empty() const;
+		size_t last_group_count() const;
+	};
+
+}
\ No newline at end of file
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "bitmap.h"
+#include "config.h"
+
+#include <allegro5/allegro.h>
+
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace AllegroCPP {
+
+	struct atlas_options {
+		int page_width = 2048;
+		int page_height = 2048;
+		int padding = 2; // empty pixels between slots
+		int extrude = 1; // edge pixels repeated around each image, so filtering never reads a neighbour
+		int flags = ALLEGRO_VIDEO_BITMAP;
+		int format = 0;
+	};
+
+	struct atlas_entry {
+		std::string name;
+		int page = 0;
+		int posx = 0, posy = 0, width = 0, height = 0; // the image itself, extrusion is around it
+	};
+
+	// Packs many small images into few big pages (MaxRects, best short side fit) and hands out sub bitmaps of them, so a Sprite_batch can draw them in one group.
+	// Insert any time; a new page is added when nothing fits. Sub bitmaps share the page, they stay valid after the atlas is gone.
+	// save() writes the pages as images and the layout as a Config, the layout constructor loads it back and can keep inserting.
+	class Texture_atlas {
+		struct _rect {
+			int x, y, w, h;
+		};
+		struct _page {
+			Bitmap bmp;
+			std::vector<_rect> free;
+			long long used = 0;
+		};
+
+		atlas_options m_opt;
+		std::vector<_page> m_pages;
+		std::vector<atlas_entry> m_entries;
+		std::unordered_map<std::string, size_t> m_names;
+
+		_page& new_page();
+		bool find_slot(const _page&, const int w, const int h, _rect& out) const;
+		void occupy(_page&, const _rect&);
+		void copy_in(_page&, ALLEGRO_BITMAP* src, const int x, const int y) const;
+	public:
+		Texture_atlas(const atlas_options& = {});
+		// From a layout written by save(). Page images are loaded with opt flags and format, page size, padding and extrusion come from the layout.
+		Texture_atlas(const std::string& layout_path, const atlas_options& opt = {});
+
+		Texture_atlas(const Texture_atlas&) = delete;
+		Texture_atlas(Texture_atlas&&) noexcept;
+		void operator=(const Texture_atlas&) = delete;
+		void operator=(Texture_atlas&&) noexcept;
+
+		// Copy the image in and get a sub bitmap of it. Throws if the name is taken or the image can't fit an empty page.
+		Bitmap insert(const std::string& name, const Bitmap& image);
+		// Loads path and uses it as the name.
+		Bitmap insert(const std::string& path);
+		// Biggest first, packs tighter than one by one. Same order as given.
+		std::vector<Bitmap> insert(const std::vector<std::pair<std::string, const Bitmap*>>& images);
+
+		bool contains(const std::string& name) const;
+		// New sub bitmap of an entry. Throws if there is no such name.
+		Bitmap get(const std::string& name) const;
+		const atlas_entry* find(const std::string& name) const;
+		const std::vector<atlas_entry>& entries() const;
+
+		size_t page_count() const;
+		const Bitmap& page(const size_t index) const;
+		// Used area over total area of the pages, 0..1.
+		double occupancy() const;
+
+		// Pages go to page_prefix + index + ".png", layout to layout_path.
+		bool save(const std::string& layout_path, const std::string& page_prefix) const;
+	};
+
+}
\ No newline at end of file
@@ -4,6 +4,13 @@
 
 #include <stdexcept>
 #include <functional>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <memory>
+#include <type_traits>
 
 namespace AllegroCPP {
 
@@ -90,6 +97,52 @@ namespace AllegroCPP {
 		void create(const std::function<bool(void)>, const Mode);
 	};
 
+	// Fixed set of Threads running queued tasks. Pending tasks still run on destruction.
+	class Thread_pool {
+		std::vector<Thread> m_workers;
+		std::deque<std::function<void(void)>> m_tasks;
+		std::mutex m_mtx;
+		std::condition_variable m_cond;
+		std::condition_variable m_idle;
+		size_t m_busy = 0;
+		bool m_stop = false;
+
+		bool worker();
+	public:
+		Thread_pool(const Thread_pool&) = delete;
+		Thread_pool(Thread_pool&&) = delete;
+		void operator=(const Thread_pool&) = delete;
+		void operator=(Thread_pool&&) = delete;
+
+		Thread_pool(const size_t threads = 0); // 0 is one per CPU core
+		~Thread_pool();
+
+		// Fire and forget. Exceptions thrown by the task are dropped.
+		void push(std::function<void(void)>);
+
+		// Queue and get a future for the result (or exception).
+		template<typename F>
+		auto submit(F&& f) -> std::future<std::invoke_result_t<std::decay_t<F>>>
+		{
+			using R = std::invoke_result_t<std::decay_t<F>>;
+			auto task = std::make_shared<std::packaged_task<R(void)>>(std::forward<F>(f));
+			auto fut = task->get_future();
+			push([task] { (*task)(); });
+			return fut;
+		}
+
+		// Block until the queue is empty and no task is running.
+		void wait_idle();
+
+		size_t size() const;
+		size_t pending();
+		// True when called from one of this pool's workers (a task). Blocking there on futures of this pool can deadlock, run the work inline instead.
+		bool is_worker_thread() const;
+
+		// Shared pool, one thread per core, created on first use.
+		static Thread_pool& global();
+	};
+
 	namespace Time {
 		double get_time();
 		void rest(const double);
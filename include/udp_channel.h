@@ -0,0 +1,100 @@
+#pragma once
+
+#include "file.h"
+
+#ifndef ALLEGROCPP_DISABLE_FILESOCKET
+
+#include <stdint.h>
+
+#include <deque>
+#include <map>
+#include <vector>
+
+namespace AllegroCPP {
+
+	enum class channel_mode { UNRELIABLE, RELIABLE_UNORDERED, RELIABLE_ORDERED };
+
+	struct udp_channel_stats {
+		double rtt = 0.0; // smoothed, seconds
+		double rtt_var = 0.0;
+		uint64_t packets_sent = 0;
+		uint64_t packets_received = 0;
+		uint64_t packets_lost = 0; // not acked within a second
+		uint64_t messages_resent = 0;
+		uint64_t send_failures = 0; // packets the socket did not take, their reliable messages go again on the next update()
+		size_t messages_in_flight = 0; // reliable, not acked yet
+	};
+
+	// Message channels over one UDP File_client (a client, or what File_host::listen gave for a peer). Single threaded: call update() every frame.
+	// Packet: [seq u16][flags u8][ack u16][ack bits u32] then messages [channel u8][id u16][size u16][data], as many as fit in the MTU.
+	// flags bit 0: ack fields are valid (something was received already).
+	// Packets with messages are acked through the next 32 packets' headers; reliable messages in unacked packets are sent again after the RTO.
+	// Packets with only acks are not acked back.
+	// No fragmentation: a message must fit in one packet (max_message_size()).
+	class Udp_channel {
+		struct _pending {
+			std::vector<uint8_t> data;
+			double last_sent = -1.0;
+		};
+		struct _channel {
+			channel_mode mode;
+			uint16_t next_send_id = 0;
+			std::map<uint16_t, _pending> in_flight;
+			std::deque<std::vector<uint8_t>> unreliable;
+			uint16_t next_recv_id = 0;
+			std::map<uint16_t, std::vector<uint8_t>> ahead; // received after a gap. Unordered keeps only the id
+		};
+		struct _sent_packet {
+			uint16_t seq = 0;
+			double time = 0.0;
+			bool open = false; // waiting for ack
+			std::vector<std::pair<uint8_t, uint16_t>> messages; // reliable ones carried
+		};
+
+		File_client& m_sock;
+		const size_t m_mtu;
+		std::vector<_channel> m_channels;
+		std::vector<_sent_packet> m_sent; // ring by seq
+		std::deque<std::pair<uint8_t, std::vector<uint8_t>>> m_inbox;
+
+		uint16_t m_seq = 0;
+		uint16_t m_remote_seq = 0;
+		uint32_t m_remote_bits = 0;
+		bool m_got_any = false;
+		bool m_ack_due = false;
+
+		double m_srtt = 0.1;
+		double m_rttvar = 0.05;
+		bool m_rtt_sampled = false;
+		udp_channel_stats m_stats;
+
+		void receive_packet(const uint8_t* data, const size_t len);
+		void receive_message(const uint8_t channel, const uint16_t id, std::vector<uint8_t>&& data);
+		void acked(const uint16_t seq, const double now);
+		void send_packets(const double now);
+	public:
+		Udp_channel(File_client& udp_socket, const std::vector<channel_mode>& channels, const size_t mtu = 1200);
+
+		Udp_channel(const Udp_channel&) = delete;
+		Udp_channel(Udp_channel&&) = delete;
+		void operator=(const Udp_channel&) = delete;
+		void operator=(Udp_channel&&) = delete;
+
+		size_t max_message_size() const;
+		size_t channel_count() const;
+
+		// Queue a message, sent on the next update(). False if channel is invalid or message too big.
+		bool send(const uint8_t channel, const void* data, const size_t len);
+
+		// Read what arrived (waiting up to wait_ms for the first datagram), handle acks, resend and send what is queued.
+		void update(const long wait_ms = 0);
+
+		// Next delivered message. Ordered channels come in order, others as they arrive.
+		bool receive(uint8_t& channel, std::vector<uint8_t>& data);
+
+		udp_channel_stats get_stats() const;
+	};
+
+}
+
+#endif // ALLEGROCPP_DISABLE_FILESOCKET
\ No newline at end of file
@@ -70,6 +70,8 @@ namespace AllegroCPP {
 		types type = types::TRIANGLE_LIST;
 		mutable std::shared_mutex safe_mtx;
 		Transform latest_transform;
+
+		friend class Draw_command_buffer;
 	public:
 		Vertexes();
 
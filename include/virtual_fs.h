@@ -0,0 +1,77 @@
+#pragma once
+
+#include "file.h"
+
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_physfs.h>
+#include <physfs.h>
+
+#include <string>
+#include <stdexcept>
+#include <vector>
+#include <unordered_map>
+#include <shared_mutex>
+#include <atomic>
+
+namespace AllegroCPP {
+
+	struct virtual_fs_stats {
+		size_t hits = 0;
+		size_t misses = 0;
+		size_t entries = 0;
+	};
+
+	// PhysFS is global: every Virtual_fs shares the same search path, but each one only unmounts what it mounted.
+	class Virtual_fs {
+		struct _mount {
+			std::string path;
+			std::string mount_point;
+			int priority;
+		};
+		struct _lookup {
+			bool exists = false;
+			bool is_directory = false;
+			int64_t size = -1;
+		};
+
+		std::vector<_mount> m_mounts; // highest priority first, same order as PhysFS search path
+		mutable std::unordered_map<std::string, _lookup> m_cache;
+		mutable std::unordered_map<std::string, std::vector<std::string>> m_list_cache;
+		mutable std::shared_mutex m_cache_mtx;
+		mutable std::atomic<size_t> m_hits = 0, m_misses = 0;
+
+		_lookup lookup(const std::string&) const;
+	public:
+		Virtual_fs(const char* argv0 = nullptr);
+		~Virtual_fs();
+
+		Virtual_fs(const Virtual_fs&) = delete;
+		Virtual_fs(Virtual_fs&&) = delete;
+		void operator=(const Virtual_fs&) = delete;
+		void operator=(Virtual_fs&&) = delete;
+
+		// Mount a directory or archive (zip, 7z...). Higher priority wins when two mounts provide the same file.
+		bool mount(const std::string& path, const std::string& mount_point = "/", const int priority = 0);
+		bool unmount(const std::string& path);
+		void unmount_all();
+
+		bool set_write_dir(const std::string& path);
+
+		// Make al_fopen / al_load_* on THIS thread resolve through PhysFS.
+		void set_as_thread_interface() const;
+		// Back to the standard stdio file interface on this thread.
+		static void reset_thread_interface();
+
+		bool exists(const std::string& path) const;
+		bool is_directory(const std::string& path) const;
+		int64_t size(const std::string& path) const;
+		std::vector<std::string> list(const std::string& dir) const;
+
+		// Open a file through the mounted tree, regardless of the thread's current interface.
+		File open(const std::string& path, const std::string& mode = "rb");
+
+		void clear_cache();
+		virtual_fs_stats get_cache_stats() const;
+	};
+
+}
\ No newline at end of file
@@ -1,4 +1,9 @@
 #include "bitmap.h"
+#include "compositor.h"
+#include "damage_tracker.h"
+
+#include <algorithm>
+#include <cmath>
 
 namespace AllegroCPP {
 
@@ -108,7 +113,7 @@ namespace AllegroCPP {
 		al_set_new_bitmap_flags(flags);
 		al_set_new_bitmap_format(format);
 
-		ALLEGRO_BITMAP* nbmp = al_clone_bitmap(get_for_draw());
+		ALLEGRO_BITMAP* nbmp = al_clone_bitmap(oth.get_for_draw());
 		if (!nbmp) throw std::runtime_error("Cannot clone bitmap!");
 
 		m_bmp = std::shared_ptr<ALLEGRO_BITMAP>(nbmp, [](ALLEGRO_BITMAP* b) { al_destroy_bitmap(b); });
@@ -135,7 +140,7 @@ namespace AllegroCPP {
 		al_set_new_bitmap_flags(flags);
 		al_set_new_bitmap_format(format);
 
-		ALLEGRO_BITMAP* nbmp = al_clone_bitmap(get_for_draw());
+		ALLEGRO_BITMAP* nbmp = al_clone_bitmap(oth.get_for_draw());
 		if (!nbmp) throw std::runtime_error("Cannot clone bitmap!");
 
 		m_bmp = std::shared_ptr<ALLEGRO_BITMAP>(nbmp, [](ALLEGRO_BITMAP* b) { al_destroy_bitmap(b); });
@@ -272,7 +277,7 @@ namespace AllegroCPP {
 
 	bool Bitmap::clear_to_color(const ALLEGRO_COLOR color)
 	{
-		if (!get_for_draw() || !m_parent || m_treat_ref_const) return false;
+		if (!get_for_draw() || m_treat_ref_const) return false;
 		ALLEGRO_BITMAP* oldtarg = al_get_target_bitmap();
 		al_set_target_bitmap(get_for_draw());
 		al_clear_to_color(color);
@@ -305,6 +310,9 @@ namespace AllegroCPP {
 		if (!to_draw) return false;
 
 		m_stored_draw_props.check(to_draw);
+		report_damage();
+
+		if (draw_composited()) return true;
 
 		al_draw_tinted_scaled_rotated_bitmap_region(to_draw,
 			m_stored_draw_props._cut.posx, m_stored_draw_props._cut.posy, m_stored_draw_props._cut.width, m_stored_draw_props._cut.height,
@@ -319,6 +327,60 @@ namespace AllegroCPP {
 		return true;
 	}
 	
+	void Bitmap::report_damage() const
+	{
+		if (!damage_tracking_active()) return;
+		// bounds of the scaled and rotated cut around its center
+		const auto& p = m_stored_draw_props;
+		const float l = -p._transf.centerx * p._scale.scalex, t = -p._transf.centery * p._scale.scaley;
+		const float r = (p._cut.width - p._transf.centerx) * p._scale.scalex, b = (p._cut.height - p._transf.centery) * p._scale.scaley;
+		const float c = std::cos(p._transf.rotationrad), s = std::sin(p._transf.rotationrad);
+		const float xs[4] = { l * c - t * s, r * c - t * s, l * c - b * s, r * c - b * s };
+		const float ys[4] = { l * s + t * c, r * s + t * c, l * s + b * c, r * s + b * c };
+		const auto [x0, x1] = std::minmax_element(xs, xs + 4);
+		const auto [y0, y1] = std::minmax_element(ys, ys + 4);
+		damage_report(p._pos_and_flag.target_x + *x0, p._pos_and_flag.target_y + *y0, *x1 - *x0, *y1 - *y0);
+	}
+
+	bool Bitmap::draw_composited() const
+	{
+		// memory onto memory without rotation: the software compositor beats Allegro's per pixel path
+		ALLEGRO_BITMAP* to_draw = get_for_draw();
+		ALLEGRO_BITMAP* target = al_get_target_bitmap();
+		const auto& p = m_stored_draw_props;
+		if (!target || p._transf.rotationrad != 0.0f || !(p._scale.scalex > 0.0f) || !(p._scale.scaley > 0.0f) || !composite_supported(to_draw, target)) return false;
+
+		composite_options opts;
+		int op, src, dst, aop, asrc, adst;
+		al_get_separate_blender(&op, &src, &dst, &aop, &asrc, &adst);
+		if (op != ALLEGRO_ADD || aop != ALLEGRO_ADD || src != asrc || dst != adst) return false;
+		if (src == ALLEGRO_ONE && dst == ALLEGRO_INVERSE_ALPHA) opts.blend = composite_blend::PREMULTIPLIED;
+		else if (src == ALLEGRO_ALPHA && dst == ALLEGRO_INVERSE_ALPHA) opts.blend = composite_blend::ALPHA;
+		else if (src == ALLEGRO_ONE && dst == ALLEGRO_ZERO) opts.blend = composite_blend::COPY;
+		else return false;
+
+		// translate and scale only
+		const ALLEGRO_TRANSFORM* t = al_get_current_transform();
+		if (t && (t->m[1][0] != 0.0f || t->m[0][1] != 0.0f || !(t->m[0][0] > 0.0f) || !(t->m[1][1] > 0.0f) || t->m[0][3] != 0.0f || t->m[1][3] != 0.0f || t->m[3][3] != 1.0f)) return false;
+		const float tsx = t ? t->m[0][0] : 1.0f, tsy = t ? t->m[1][1] : 1.0f;
+		const float tdx = t ? t->m[3][0] : 0.0f, tdy = t ? t->m[3][1] : 0.0f;
+
+		const float w = p._cut.width * p._scale.scalex * tsx;
+		const float h = p._cut.height * p._scale.scaley * tsy;
+		const float x = (p._pos_and_flag.target_x - p._transf.centerx * p._scale.scalex) * tsx + tdx;
+		const float y = (p._pos_and_flag.target_y - p._transf.centery * p._scale.scaley) * tsy + tdy;
+
+		const int bmp_flags = al_get_bitmap_flags(to_draw);
+		const bool magnified = w > p._cut.width || h > p._cut.height;
+		if (bmp_flags & (magnified ? ALLEGRO_MAG_LINEAR : ALLEGRO_MIN_LINEAR)) opts.filter = composite_filter::LINEAR;
+
+		al_unmap_rgba(p._color, &opts.tint.r, &opts.tint.g, &opts.tint.b, &opts.tint.a);
+		opts.flags = p._pos_and_flag.flags & (ALLEGRO_FLIP_HORIZONTAL | ALLEGRO_FLIP_VERTICAL);
+		al_get_clipping_rectangle(&opts.clip_x, &opts.clip_y, &opts.clip_width, &opts.clip_height);
+
+		return composite(to_draw, static_cast<float>(p._cut.posx), static_cast<float>(p._cut.posy), static_cast<float>(p._cut.width), static_cast<float>(p._cut.height), target, x, y, w, h, opts);
+	}
+	
 	bool Bitmap::draw(const float target_x, const float target_y, const int flags)
 	{
 		m_stored_draw_props._pos_and_flag.target_x = target_x;
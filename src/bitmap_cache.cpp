@@ -0,0 +1,145 @@
+#include "bitmap_cache.h"
+
+#include <functional>
+
+namespace AllegroCPP {
+
+	size_t Bitmap_cache::_key_hash::operator()(const _key& k) const
+	{
+		size_t h = std::hash<std::string>()(k.path);
+		h ^= std::hash<int>()(k.flags) + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+		h ^= std::hash<int>()(k.format) + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+		return h;
+	}
+
+	Bitmap_cache::Bitmap_cache(const size_t budget_bytes)
+	{
+		m_stats.budget = budget_bytes;
+	}
+
+	size_t Bitmap_cache::bytes_of(const int width, const int height, const int format)
+	{
+		if (width <= 0 || height <= 0) return 0;
+		const int bw = al_get_pixel_block_width(format);
+		const int bh = al_get_pixel_block_height(format);
+		const int bs = al_get_pixel_block_size(format);
+		if (bw <= 0 || bh <= 0 || bs <= 0) return static_cast<size_t>(width) * height * 4; // unknown, assume 32 bit
+		return static_cast<size_t>((width + bw - 1) / bw) * static_cast<size_t>((height + bh - 1) / bh) * static_cast<size_t>(bs);
+	}
+
+	void Bitmap_cache::drop(std::unordered_map<_key, _entry, _key_hash>::iterator it)
+	{
+		m_stats.bytes -= it->second.bytes;
+		auto f = m_stats.bytes_per_format.find(it->second.format);
+		if (f != m_stats.bytes_per_format.end()) {
+			f->second -= it->second.bytes;
+			if (f->second == 0) m_stats.bytes_per_format.erase(f);
+		}
+		m_lru.erase(it->second.lru);
+		m_entries.erase(it);
+	}
+
+	void Bitmap_cache::evict()
+	{
+		if (m_stats.budget == 0) return;
+		for (auto k = m_lru.end(); k != m_lru.begin() && m_stats.bytes > m_stats.budget;) {
+			--k;
+			auto it = m_entries.find(*k);
+			if (it->second.bmp.m_bmp.use_count() > 1) continue; // someone still draws it
+			k = std::next(k);
+			drop(it);
+			++m_stats.evictions;
+		}
+	}
+
+	Bitmap Bitmap_cache::get(const std::string& path, const int flags, const int format)
+	{
+		if (path.empty()) throw std::invalid_argument("Path was empty!");
+
+		std::lock_guard<std::mutex> l(m_mtx);
+		_key key{ path, flags, format };
+
+		auto it = m_entries.find(key);
+		if (it != m_entries.end()) {
+			++m_stats.hits;
+			m_lru.splice(m_lru.begin(), m_lru, it->second.lru);
+			return it->second.bmp.make_ref();
+		}
+
+		++m_stats.misses;
+		Bitmap bmp(path, flags, format);
+		const int real_format = bmp.get_format();
+		const size_t bytes = bytes_of(bmp.get_width(), bmp.get_height(), real_format);
+
+		m_lru.push_front(key);
+		it = m_entries.emplace(std::move(key), _entry{ std::move(bmp), bytes, real_format, m_lru.begin() }).first;
+		m_stats.bytes += bytes;
+		m_stats.bytes_per_format[real_format] += bytes;
+
+		Bitmap ref = it->second.bmp.make_ref(); // referenced now, eviction won't take it
+		evict();
+		return ref;
+	}
+
+	bool Bitmap_cache::contains(const std::string& path, const int flags, const int format) const
+	{
+		std::lock_guard<std::mutex> l(m_mtx);
+		return m_entries.count(_key{ path, flags, format }) != 0;
+	}
+
+	bool Bitmap_cache::remove(const std::string& path, const int flags, const int format)
+	{
+		std::lock_guard<std::mutex> l(m_mtx);
+		auto it = m_entries.find(_key{ path, flags, format });
+		if (it == m_entries.end()) return false;
+		drop(it);
+		return true;
+	}
+
+	void Bitmap_cache::set_budget(const size_t budget_bytes)
+	{
+		std::lock_guard<std::mutex> l(m_mtx);
+		m_stats.budget = budget_bytes;
+		evict();
+	}
+
+	size_t Bitmap_cache::get_budget() const
+	{
+		std::lock_guard<std::mutex> l(m_mtx);
+		return m_stats.budget;
+	}
+
+	size_t Bitmap_cache::clear_unused()
+	{
+		std::lock_guard<std::mutex> l(m_mtx);
+		size_t count = 0;
+		for (auto it = m_entries.begin(); it != m_entries.end();) {
+			if (it->second.bmp.m_bmp.use_count() > 1) {
+				++it;
+				continue;
+			}
+			auto rem = it++;
+			drop(rem);
+			++count;
+		}
+		m_stats.evictions += count;
+		return count;
+	}
+
+	bitmap_cache_stats Bitmap_cache::get_stats() const
+	{
+		std::lock_guard<std::mutex> l(m_mtx);
+		bitmap_cache_stats st = m_stats;
+		st.entries = m_entries.size();
+		return st;
+	}
+
+	void Bitmap_cache::reset_counters()
+	{
+		std::lock_guard<std::mutex> l(m_mtx);
+		m_stats.hits = 0;
+		m_stats.misses = 0;
+		m_stats.evictions = 0;
+	}
+
+}
\ No newline at end of file
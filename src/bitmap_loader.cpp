@@ -0,0 +1,204 @@
+#include "bitmap_loader.h"
+#include "locked_region.h"
+#include "pixel_convert.h"
+
+#include <optional>
+#include <utility>
+
+namespace AllegroCPP {
+
+	// Loaders don't always give the format asked for. Fixed here on the worker with convert_pixels, the bitmap is new and nobody else holds its handle yet,
+	// so swapping it is safe (Bitmap::convert can't, al_convert_bitmap keeps the handle). finish() is then only the upload.
+	static void to_format(Bitmap& bmp, const int format)
+	{
+		ALLEGRO_BITMAP* src = bmp;
+		const int src_format = al_get_bitmap_format(src);
+		if (format == src_format || !pixel_convert_supported(src_format, format)) return;
+
+		Bitmap out(al_get_bitmap_width(src), al_get_bitmap_height(src), ALLEGRO_MEMORY_BITMAP, format);
+		bool good = false;
+		{
+			Locked_region from(src, ALLEGRO_PIXEL_FORMAT_ANY, ALLEGRO_LOCK_READONLY);
+			Locked_region to(out, ALLEGRO_PIXEL_FORMAT_ANY, ALLEGRO_LOCK_WRITEONLY);
+			good = convert_pixels(from, to);
+		}
+		if (good) bmp = std::move(out);
+	}
+
+	Bitmap_loader::Bitmap_loader(Thread_pool* pool, const int event_id)
+		: m_pool(pool ? pool : &Thread_pool::global()), m_event_id(event_id)
+	{
+		if (!ALLEGRO_EVENT_TYPE_IS_USER(event_id)) throw std::invalid_argument("ID must be a USER_TYPE type to work (must follow macro ALLEGRO_EVENT_TYPE_IS_USER(X))");
+		if (!al_is_system_installed()) al_init();
+		if (!al_is_image_addon_initialized()) al_init_image_addon(); // here, not racing on the workers
+	}
+
+	Bitmap_loader::~Bitmap_loader()
+	{
+		std::unique_lock<std::mutex> l(m_mtx);
+		m_closing = true;
+		m_pending.clear();
+		m_idle.wait(l, [this] { return m_running == 0; });
+	}
+
+	void Bitmap_loader::run_one()
+	{
+		struct _done { // whatever throws below, the destructor must not wait forever
+			Bitmap_loader* self;
+			~_done() {
+				std::lock_guard<std::mutex> l(self->m_mtx);
+				--self->m_running;
+				self->m_idle.notify_all();
+			}
+		} done{ this };
+
+		uint64_t id = 0;
+		_request req;
+		{
+			std::lock_guard<std::mutex> l(m_mtx);
+			if (!m_closing && !m_pending.empty()) {
+				auto best = m_pending.begin(); // ids grow, so the first of the highest priority is the oldest
+				for (auto it = std::next(best); it != m_pending.end(); ++it) {
+					if (it->second.priority > best->second.priority) best = it;
+				}
+				id = best->first;
+				req = std::move(best->second);
+				m_pending.erase(best);
+				m_decoding.insert(id);
+			}
+		}
+
+		if (id != 0) {
+			bitmap_load_event ev{ id, req.path, false };
+			std::optional<Bitmap> bmp;
+			try {
+				bmp.emplace(req.path, ALLEGRO_MEMORY_BITMAP, req.format);
+				to_format(*bmp, req.format);
+				ev.ok = true;
+			}
+			catch (...) {}
+
+			bool emit = false;
+			{
+				std::lock_guard<std::mutex> l(m_mtx);
+				m_decoding.erase(id);
+				if (m_cancelled.erase(id) == 0 && !m_closing) {
+					if (ev.ok) m_decoded.push_back(_decoded{ id, req.flags, req.format, std::move(*bmp) });
+					else m_failed.insert(id);
+					emit = true;
+				}
+			}
+			if (emit) m_event.emit(std::any(std::move(ev)), m_event_id);
+		}
+	}
+
+	uint64_t Bitmap_loader::load(const std::string& path, const int priority, const int flags, const int format)
+	{
+		if (path.empty()) throw std::invalid_argument("Path was empty!");
+
+		uint64_t id = 0;
+		{
+			std::lock_guard<std::mutex> l(m_mtx);
+			id = m_next_id++;
+			m_pending.emplace(id, _request{ path, priority, flags, format });
+			++m_running;
+		}
+		m_pool->push([this] { run_one(); }); // each task takes the best pending one, not necessarily this
+		return id;
+	}
+
+	bool Bitmap_loader::set_priority(const uint64_t id, const int priority)
+	{
+		std::lock_guard<std::mutex> l(m_mtx);
+		auto it = m_pending.find(id);
+		if (it == m_pending.end()) return false;
+		it->second.priority = priority;
+		return true;
+	}
+
+	bool Bitmap_loader::cancel(const uint64_t id)
+	{
+		std::lock_guard<std::mutex> l(m_mtx);
+		if (m_pending.erase(id)) return true;
+		if (m_decoding.count(id)) return m_cancelled.insert(id).second;
+		for (auto it = m_decoded.begin(); it != m_decoded.end(); ++it) {
+			if (it->id != id) continue;
+			m_decoded.erase(it);
+			return true;
+		}
+		return m_ready.erase(id) != 0 || m_failed.erase(id) != 0;
+	}
+
+	void Bitmap_loader::cancel_all()
+	{
+		std::lock_guard<std::mutex> l(m_mtx);
+		m_pending.clear();
+		for (const auto& i : m_decoding) m_cancelled.insert(i);
+		m_decoded.clear();
+		m_ready.clear();
+		m_failed.clear();
+	}
+
+	size_t Bitmap_loader::finish(const double budget_seconds)
+	{
+		const double start = al_get_time();
+		size_t done = 0;
+
+		do {
+			std::optional<_decoded> dec;
+			{
+				std::lock_guard<std::mutex> l(m_mtx);
+				if (m_decoded.empty()) break;
+				dec.emplace(std::move(m_decoded.front()));
+				m_decoded.pop_front();
+			}
+
+			const bool ok = dec->bmp.convert(dec->flags, dec->format);
+
+			std::lock_guard<std::mutex> l(m_mtx);
+			if (ok) m_ready.emplace(dec->id, std::move(dec->bmp));
+			else m_failed.insert(dec->id);
+			++done;
+		} while (al_get_time() - start < budget_seconds);
+
+		return done;
+	}
+
+	bool Bitmap_loader::take(const uint64_t id, Bitmap& out)
+	{
+		std::lock_guard<std::mutex> l(m_mtx);
+		auto it = m_ready.find(id);
+		if (it == m_ready.end()) {
+			m_failed.erase(id);
+			return false;
+		}
+		out = std::move(it->second);
+		m_ready.erase(it);
+		return true;
+	}
+
+	Bitmap_loader::State Bitmap_loader::state(const uint64_t id) const
+	{
+		std::lock_guard<std::mutex> l(m_mtx);
+		if (m_pending.count(id)) return State::PENDING;
+		if (m_decoding.count(id)) return m_cancelled.count(id) ? State::UNKNOWN : State::DECODING;
+		for (const auto& i : m_decoded) {
+			if (i.id == id) return State::DECODED;
+		}
+		if (m_ready.count(id)) return State::READY;
+		if (m_failed.count(id)) return State::FAILED;
+		return State::UNKNOWN;
+	}
+
+	size_t Bitmap_loader::pending() const
+	{
+		std::lock_guard<std::mutex> l(m_mtx);
+		return m_pending.size() + m_decoding.size() + m_decoded.size();
+	}
+
+	Bitmap_loader::operator ALLEGRO_EVENT_SOURCE* () const
+	{
+		return m_event;
+	}
+
+}
\ No newline at end of file
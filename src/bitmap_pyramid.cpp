@@ -0,0 +1,445 @@
+#include "bitmap_pyramid.h"
+#include "locked_region.h"
+#include "pixel_convert.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+#if defined(__SSE__) || defined(__SSE2__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define ALLEGROCPP_PYRAMID_SSE
+#endif
+
+namespace AllegroCPP {
+
+	namespace _bitmap_pyramid {
+
+		constexpr int rgba8 = ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE;
+		constexpr int linear_steps = 8192; // linear to sRGB table resolution
+
+		// one pixel of 4 floats (r, g, b, a)
+#ifdef ALLEGROCPP_PYRAMID_SSE
+		using f4 = __m128;
+		static inline f4 f4_zero() { return _mm_setzero_ps(); }
+		static inline f4 f4_load(const float* p) { return _mm_loadu_ps(p); }
+		static inline void f4_store(float* p, const f4 v) { _mm_storeu_ps(p, v); }
+		static inline f4 f4_madd(const f4 acc, const f4 v, const float w) { return _mm_add_ps(acc, _mm_mul_ps(v, _mm_set1_ps(w))); }
+#else
+		struct f4 { float v[4]; };
+		static inline f4 f4_zero() { return { 0.0f, 0.0f, 0.0f, 0.0f }; }
+		static inline f4 f4_load(const float* p) { return { p[0], p[1], p[2], p[3] }; }
+		static inline void f4_store(float* p, const f4 v) { memcpy(p, v.v, sizeof(v.v)); }
+		static inline f4 f4_madd(const f4 acc, const f4 v, const float w) { return { acc.v[0] + v.v[0] * w, acc.v[1] + v.v[1] * w, acc.v[2] + v.v[2] * w, acc.v[3] + v.v[3] * w }; }
+#endif
+
+		// premultiplied RGBA floats, in linear light if gamma correct
+		struct image {
+			int width = 0, height = 0;
+			std::vector<float> px;
+
+			float* row(const int y) { return px.data() + static_cast<size_t>(y) * width * 4; }
+			const float* row(const int y) const { return px.data() + static_cast<size_t>(y) * width * 4; }
+		};
+
+		static const float* srgb_to_linear()
+		{
+			static const auto table = [] {
+				std::vector<float> t(256);
+				for (int i = 0; i < 256; ++i) {
+					const double c = i / 255.0;
+					t[i] = static_cast<float>(c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4));
+				}
+				return t;
+			}();
+			return table.data();
+		}
+
+		static const uint8_t* linear_to_srgb()
+		{
+			static const auto table = [] {
+				std::vector<uint8_t> t(linear_steps + 1);
+				for (int i = 0; i <= linear_steps; ++i) {
+					const double c = static_cast<double>(i) / linear_steps;
+					const double s = c <= 0.0031308 ? c * 12.92 : 1.055 * std::pow(c, 1.0 / 2.4) - 0.055;
+					t[i] = static_cast<uint8_t>(std::lround((std::clamp)(s, 0.0, 1.0) * 255.0));
+				}
+				return t;
+			}();
+			return table.data();
+		}
+
+		static void decode_row(const uint8_t* in, float* out, const int width, const bool gamma)
+		{
+			const float* lin = srgb_to_linear();
+			for (int x = 0; x < width; ++x) {
+				const uint8_t* p = in + x * 4;
+				float* o = out + x * 4;
+				const float a = p[3] / 255.0f;
+				if (!gamma) {
+					for (int c = 0; c < 4; ++c) o[c] = p[c] / 255.0f;
+				}
+				else {
+					// straight sRGB to linear, premultiplied again
+					for (int c = 0; c < 3; ++c) {
+						const int straight = p[3] ? (std::min)(255, (p[c] * 255 + p[3] / 2) / p[3]) : 0;
+						o[c] = lin[straight] * a;
+					}
+					o[3] = a;
+				}
+			}
+		}
+
+		static void encode_row(const float* in, uint8_t* out, const int width, const bool gamma)
+		{
+			const uint8_t* srgb = linear_to_srgb();
+			for (int x = 0; x < width; ++x) {
+				const float* p = in + x * 4;
+				uint8_t* o = out + x * 4;
+				const float a = (std::clamp)(p[3], 0.0f, 1.0f);
+				for (int c = 0; c < 3; ++c) {
+					const float v = (std::clamp)(p[c], 0.0f, a); // premultiplied color can't pass alpha
+					if (!gamma) o[c] = static_cast<uint8_t>(v * 255.0f + 0.5f);
+					else o[c] = a > 0.0f ? static_cast<uint8_t>(srgb[static_cast<int>(v / a * linear_steps + 0.5f)] * a + 0.5f) : 0;
+				}
+				o[3] = static_cast<uint8_t>(a * 255.0f + 0.5f);
+			}
+		}
+
+		static float lanczos3(const float x)
+		{
+			if (x == 0.0f) return 1.0f;
+			if (x <= -3.0f || x >= 3.0f) return 0.0f;
+			const float px = std::numbers::pi_v<float> * x;
+			return 3.0f * std::sin(px) * std::sin(px / 3.0f) / (px * px);
+		}
+
+		// Taps of each destination pixel on one axis: source first..first+count-1 with weights from off. Edges are clamped.
+		struct taps {
+			std::vector<int> first, count;
+			std::vector<size_t> off;
+			std::vector<float> w;
+		};
+
+		static void make_taps(const int src_n, const int dst_n, const pyramid_filter filter, taps& t)
+		{
+			t.first.resize(dst_n);
+			t.count.resize(dst_n);
+			t.off.resize(dst_n);
+			t.w.clear();
+			const double scale = static_cast<double>(src_n) / dst_n;
+			const double fscale = (std::max)(scale, 1.0);
+
+			for (int i = 0; i < dst_n; ++i) {
+				int jmin, jmax;
+				if (filter == pyramid_filter::BOX) {
+					jmin = static_cast<int>(std::floor(i * scale));
+					jmax = static_cast<int>(std::ceil((i + 1) * scale)) - 1;
+				}
+				else {
+					const double center = (i + 0.5) * scale;
+					jmin = static_cast<int>(std::floor(center - 3.0 * fscale));
+					jmax = static_cast<int>(std::ceil(center + 3.0 * fscale));
+				}
+				const int lo = (std::clamp)(jmin, 0, src_n - 1), hi = (std::clamp)(jmax, 0, src_n - 1);
+				t.first[i] = lo;
+				t.count[i] = hi - lo + 1;
+				t.off[i] = t.w.size();
+				t.w.resize(t.w.size() + static_cast<size_t>(hi - lo + 1), 0.0f);
+				float* w = t.w.data() + t.off[i];
+
+				double sum = 0.0;
+				for (int j = jmin; j <= jmax; ++j) {
+					double v;
+					if (filter == pyramid_filter::BOX) v = (std::min)(j + 1.0, (i + 1) * scale) - (std::max)(static_cast<double>(j), i * scale); // area covered
+					else v = lanczos3(static_cast<float>((j + 0.5 - (i + 0.5) * scale) / fscale));
+					if (v == 0.0) continue;
+					w[(std::clamp)(j, 0, src_n - 1) - lo] += static_cast<float>(v);
+					sum += v;
+				}
+				if (sum != 0.0) for (int k = 0; k < t.count[i]; ++k) w[k] = static_cast<float>(w[k] / sum);
+			}
+		}
+
+		static void clamp_premultiplied(image& img)
+		{
+			for (size_t i = 0; i < img.px.size(); i += 4) {
+				float* p = img.px.data() + i;
+				p[3] = (std::clamp)(p[3], 0.0f, 1.0f);
+				for (int c = 0; c < 3; ++c) p[c] = (std::clamp)(p[c], 0.0f, p[3]);
+			}
+		}
+
+		// separable: rows into tmp, then columns
+		static void resample(const image& in, image& out, const int width, const int height, const pyramid_filter filter)
+		{
+			taps tx, ty;
+			make_taps(in.width, width, filter, tx);
+			make_taps(in.height, height, filter, ty);
+
+			image tmp;
+			tmp.width = width;
+			tmp.height = in.height;
+			tmp.px.resize(static_cast<size_t>(width) * in.height * 4);
+			for (int y = 0; y < in.height; ++y) {
+				const float* s = in.row(y);
+				float* d = tmp.row(y);
+				for (int x = 0; x < width; ++x) {
+					f4 acc = f4_zero();
+					const float* w = tx.w.data() + tx.off[x];
+					const float* p = s + static_cast<size_t>(tx.first[x]) * 4;
+					for (int k = 0; k < tx.count[x]; ++k) acc = f4_madd(acc, f4_load(p + k * 4), w[k]);
+					f4_store(d + x * 4, acc);
+				}
+			}
+
+			out.width = width;
+			out.height = height;
+			out.px.assign(static_cast<size_t>(width) * height * 4, 0.0f);
+			for (int y = 0; y < height; ++y) {
+				float* d = out.row(y);
+				const float* w = ty.w.data() + ty.off[y];
+				for (int k = 0; k < ty.count[y]; ++k) {
+					const float* s = tmp.row(ty.first[y] + k);
+					for (int x = 0; x < width; ++x) f4_store(d + x * 4, f4_madd(f4_load(d + x * 4), f4_load(s + x * 4), w[k]));
+				}
+			}
+
+			if (filter == pyramid_filter::LANCZOS3) clamp_premultiplied(out); // ringing
+		}
+
+		static void next_level(const image& in, image& out, const pyramid_filter filter)
+		{
+			const int width = (std::max)(1, in.width / 2), height = (std::max)(1, in.height / 2);
+			const bool even = (in.width % 2 == 0 || in.width == 1) && (in.height % 2 == 0 || in.height == 1);
+			if (filter != pyramid_filter::BOX || !even) {
+				resample(in, out, width, height, filter);
+				return;
+			}
+
+			// exact 2x2 (or 2x1) average
+			const int fx = in.width == 1 ? 1 : 2, fy = in.height == 1 ? 1 : 2;
+			const float w = 1.0f / static_cast<float>(fx * fy);
+			out.width = width;
+			out.height = height;
+			out.px.resize(static_cast<size_t>(width) * height * 4);
+			for (int y = 0; y < height; ++y) {
+				const float* r0 = in.row(y * fy);
+				const float* r1 = in.row(y * fy + fy - 1);
+				float* d = out.row(y);
+				for (int x = 0; x < width; ++x) {
+					const size_t a = static_cast<size_t>(x) * fx * 4, b = a + static_cast<size_t>(fx - 1) * 4;
+					f4 acc = f4_madd(f4_zero(), f4_load(r0 + a), w);
+					if (fx > 1) acc = f4_madd(acc, f4_load(r0 + b), w);
+					if (fy > 1) {
+						acc = f4_madd(acc, f4_load(r1 + a), w);
+						if (fx > 1) acc = f4_madd(acc, f4_load(r1 + b), w);
+					}
+					f4_store(d + x * 4, acc);
+				}
+			}
+		}
+
+		// lock format: the bitmap's own if pixel_convert knows it, else let Allegro convert to rgba8
+		static int lock_format_of(ALLEGRO_BITMAP* bmp)
+		{
+			return pixel_convert_supported(al_get_bitmap_format(bmp), rgba8) ? ALLEGRO_PIXEL_FORMAT_ANY : rgba8;
+		}
+
+		static bool read(ALLEGRO_BITMAP* bmp, const bool gamma, image& img)
+		{
+			if (!bmp) return false;
+			Locked_region lr(bmp, lock_format_of(bmp), ALLEGRO_LOCK_READONLY);
+			img.width = lr.get_width();
+			img.height = lr.get_height();
+			img.px.resize(static_cast<size_t>(img.width) * img.height * 4);
+
+			std::vector<uint8_t> line(static_cast<size_t>(img.width) * 4);
+			const uint8_t* data = static_cast<const uint8_t*>(lr.get_data());
+			for (int y = 0; y < img.height; ++y) {
+				if (!convert_pixels(data + static_cast<ptrdiff_t>(y) * lr.get_pitch(), lr.get_format(), line.data(), rgba8, static_cast<size_t>(img.width))) return false;
+				decode_row(line.data(), img.row(y), img.width, gamma);
+			}
+			return true;
+		}
+
+		// into a locked region at pos_x, pos_y
+		static bool write(const image& img, const bool gamma, Locked_region& lr, const int pos_x, const int pos_y)
+		{
+			const int pixel = al_get_pixel_size(lr.get_format());
+			uint8_t* data = static_cast<uint8_t*>(lr.get_data());
+			std::vector<uint8_t> line(static_cast<size_t>(img.width) * 4);
+			for (int y = 0; y < img.height; ++y) {
+				encode_row(img.row(y), line.data(), img.width, gamma);
+				uint8_t* d = data + static_cast<ptrdiff_t>(pos_y + y) * lr.get_pitch() + static_cast<ptrdiff_t>(pos_x) * pixel;
+				if (!convert_pixels(line.data(), rgba8, d, lr.get_format(), static_cast<size_t>(img.width))) return false;
+			}
+			return true;
+		}
+
+		static Bitmap make_level(const image& img, const bool gamma, const int flags, const int format)
+		{
+			Bitmap bmp(img.width, img.height, flags, format);
+			ALLEGRO_BITMAP* raw = bmp;
+			Locked_region lr(raw, lock_format_of(raw), ALLEGRO_LOCK_WRITEONLY);
+			if (!write(img, gamma, lr, 0, 0)) throw std::runtime_error("Cannot write pyramid level!");
+			return bmp;
+		}
+
+	}
+
+	Bitmap_pyramid::Bitmap_pyramid(const Bitmap& src, const pyramid_options& opts)
+	{
+		if (!build(src, opts)) throw std::runtime_error("Cannot build bitmap pyramid!");
+	}
+
+	Bitmap_pyramid::Bitmap_pyramid(Bitmap_pyramid&& oth) noexcept
+		: m_levels(std::move(oth.m_levels)), m_sheet(std::move(oth.m_sheet))
+	{
+	}
+
+	void Bitmap_pyramid::operator=(Bitmap_pyramid&& oth) noexcept
+	{
+		m_levels = std::move(oth.m_levels);
+		m_sheet = std::move(oth.m_sheet);
+	}
+
+	bool Bitmap_pyramid::build(const Bitmap& src, const pyramid_options& opts)
+	{
+		using namespace _bitmap_pyramid;
+
+		destroy();
+		if (src.empty()) return false;
+		if (!al_is_system_installed()) al_init();
+
+		Bitmap ref = src.make_ref();
+		image cur;
+		if (!read(ref, opts.gamma_correct, cur)) return false;
+		const int format = opts.format ? opts.format : src.get_format();
+
+		// sizes first, the sheet needs all of them
+		std::vector<std::pair<int, int>> sizes{ { cur.width, cur.height } };
+		while ((sizes.back().first > 1 || sizes.back().second > 1) && (opts.max_levels == 0 || sizes.size() < opts.max_levels)) {
+			sizes.push_back({ (std::max)(1, sizes.back().first / 2), (std::max)(1, sizes.back().second / 2) });
+		}
+
+		if (opts.layout == pyramid_layout::SEPARATE) {
+			m_levels.push_back(std::move(ref));
+			for (size_t i = 1; i < sizes.size(); ++i) {
+				image next;
+				next_level(cur, next, opts.filter);
+				m_levels.push_back(make_level(next, opts.gamma_correct, opts.flags, format));
+				cur = std::move(next);
+			}
+			return true;
+		}
+
+		// level 0 on the left, the others stacked on its right
+		const int pad = (std::max)(0, opts.padding);
+		std::vector<std::pair<int, int>> pos{ { 0, 0 } };
+		int sheet_w = sizes[0].first, sheet_h = sizes[0].second, y = 0;
+		for (size_t i = 1; i < sizes.size(); ++i) {
+			pos.push_back({ sizes[0].first + pad, y });
+			y += sizes[i].second + pad;
+			sheet_w = (std::max)(sheet_w, sizes[0].first + pad + sizes[i].first);
+			sheet_h = (std::max)(sheet_h, y - pad);
+		}
+
+		m_sheet = Bitmap(sheet_w, sheet_h, opts.flags, format);
+		m_sheet.clear_to_color(al_map_rgba(0, 0, 0, 0));
+		{
+			ALLEGRO_BITMAP* raw = m_sheet;
+			Locked_region lr(raw, lock_format_of(raw), ALLEGRO_LOCK_READWRITE);
+			for (size_t i = 0; i < sizes.size(); ++i) {
+				if (i > 0) {
+					image next;
+					next_level(cur, next, opts.filter);
+					cur = std::move(next);
+				}
+				if (!write(cur, opts.gamma_correct, lr, pos[i].first, pos[i].second)) {
+					destroy();
+					return false;
+				}
+			}
+		}
+		for (size_t i = 0; i < sizes.size(); ++i) m_levels.emplace_back(m_sheet, pos[i].first, pos[i].second, sizes[i].first, sizes[i].second, opts.flags, format);
+		return true;
+	}
+
+	void Bitmap_pyramid::destroy()
+	{
+		m_levels.clear();
+		m_sheet.destroy();
+	}
+
+	bool Bitmap_pyramid::empty() const
+	{
+		return m_levels.empty();
+	}
+
+	size_t Bitmap_pyramid::size() const
+	{
+		return m_levels.size();
+	}
+
+	Bitmap& Bitmap_pyramid::level(const size_t i)
+	{
+		if (i >= m_levels.size()) throw std::out_of_range("Pyramid level out of range!");
+		return m_levels[i];
+	}
+
+	const Bitmap& Bitmap_pyramid::level(const size_t i) const
+	{
+		if (i >= m_levels.size()) throw std::out_of_range("Pyramid level out of range!");
+		return m_levels[i];
+	}
+
+	const Bitmap& Bitmap_pyramid::sheet() const
+	{
+		return m_sheet;
+	}
+
+	size_t Bitmap_pyramid::level_for_scale(const float scale) const
+	{
+		if (m_levels.empty() || !(scale < 1.0f)) return 0;
+		const float need_w = m_levels[0].get_width() * scale, need_h = m_levels[0].get_height() * scale;
+		size_t i = 0;
+		while (i + 1 < m_levels.size() && m_levels[i + 1].get_width() >= need_w && m_levels[i + 1].get_height() >= need_h) ++i;
+		return i;
+	}
+
+	Bitmap& Bitmap_pyramid::for_scale(const float scale, float* remaining_scale)
+	{
+		Bitmap& lvl = level(level_for_scale(scale));
+		if (remaining_scale) *remaining_scale = scale * static_cast<float>(m_levels[0].get_width()) / static_cast<float>(lvl.get_width());
+		return lvl;
+	}
+
+	bool Bitmap_pyramid::draw(const float target_x, const float target_y, const float scale, const int flags)
+	{
+		if (m_levels.empty()) return false;
+		Bitmap& lvl = level(level_for_scale(scale));
+		lvl.set_draw_property(bitmap_scale{
+			scale * static_cast<float>(m_levels[0].get_width()) / static_cast<float>(lvl.get_width()),
+			scale * static_cast<float>(m_levels[0].get_height()) / static_cast<float>(lvl.get_height())
+		});
+		return lvl.draw(target_x, target_y, flags);
+	}
+
+	Bitmap downscale_bitmap(const Bitmap& src, const int width, const int height, const pyramid_filter filter, const bool gamma_correct, const int flags, const int format)
+	{
+		using namespace _bitmap_pyramid;
+
+		if (src.empty()) throw std::invalid_argument("Bitmap is empty!");
+		if (width <= 0 || height <= 0) throw std::invalid_argument("Invalid downscale size!");
+
+		Bitmap ref = src.make_ref();
+		image in, out;
+		if (!read(ref, gamma_correct, in)) throw std::runtime_error("Cannot read bitmap!");
+		resample(in, out, width, height, filter);
+		return make_level(out, gamma_correct, flags, format ? format : src.get_format());
+	}
+
+}
\ No newline at end of file
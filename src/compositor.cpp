@@ -0,0 +1,346 @@
+#include "compositor.h"
+#include "locked_region.h"
+#include "pixel_convert.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define ALLEGROCPP_COMPOSITE_SSE2
+#endif
+
+namespace AllegroCPP {
+
+	constexpr int composite_rgba8 = ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE; // working format, bytes r, g, b, a
+
+	static bool is_rgba8(const int format)
+	{
+		return format == composite_rgba8 || (std::endian::native == std::endian::little && format == ALLEGRO_PIXEL_FORMAT_ABGR_8888);
+	}
+
+	// exact round(a * b / 255) for a, b in 0..255
+	static inline uint8_t mul255(const unsigned a, const unsigned b)
+	{
+		const unsigned t = a * b + 128;
+		return static_cast<uint8_t>((t + (t >> 8)) >> 8);
+	}
+
+#ifdef ALLEGROCPP_COMPOSITE_SSE2
+	static inline __m128i mul255_epi16(const __m128i a, const __m128i b)
+	{
+		const __m128i t = _mm_add_epi16(_mm_mullo_epi16(a, b), _mm_set1_epi16(128));
+		return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+	}
+
+	// alpha of each of the two pixels in all of its 4 lanes
+	static inline __m128i alpha_epi16(const __m128i x)
+	{
+		return _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, 0xFF), 0xFF);
+	}
+#endif
+
+	static void tint_span(uint8_t* p, const size_t count, const pixel_rgba8 tint)
+	{
+		size_t i = 0;
+#ifdef ALLEGROCPP_COMPOSITE_SSE2
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i t = _mm_set_epi16(tint.a, tint.b, tint.g, tint.r, tint.a, tint.b, tint.g, tint.r);
+		for (; i + 4 <= count; i += 4) {
+			const __m128i v = _mm_loadu_si128((const __m128i*)(p + i * 4));
+			_mm_storeu_si128((__m128i*)(p + i * 4), _mm_packus_epi16(mul255_epi16(_mm_unpacklo_epi8(v, zero), t), mul255_epi16(_mm_unpackhi_epi8(v, zero), t)));
+		}
+#endif
+		for (; i < count; ++i) {
+			uint8_t* px = p + i * 4;
+			px[0] = mul255(px[0], tint.r);
+			px[1] = mul255(px[1], tint.g);
+			px[2] = mul255(px[2], tint.b);
+			px[3] = mul255(px[3], tint.a);
+		}
+	}
+
+	// d = s blended over d, both rgba8
+	static void blend_span(const uint8_t* s, uint8_t* d, const size_t count, const composite_blend mode)
+	{
+		size_t i = 0;
+#ifdef ALLEGROCPP_COMPOSITE_SSE2
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i full = _mm_set1_epi16(255);
+		const __m128i round = _mm_set1_epi16(128);
+		for (; i + 4 <= count; i += 4) {
+			const __m128i sv = _mm_loadu_si128((const __m128i*)(s + i * 4));
+			const __m128i dv = _mm_loadu_si128((const __m128i*)(d + i * 4));
+			__m128i res[2];
+			for (int h = 0; h < 2; ++h) {
+				const __m128i s16 = h ? _mm_unpackhi_epi8(sv, zero) : _mm_unpacklo_epi8(sv, zero);
+				const __m128i d16 = h ? _mm_unpackhi_epi8(dv, zero) : _mm_unpacklo_epi8(dv, zero);
+				const __m128i a = alpha_epi16(s16);
+				const __m128i ia = _mm_sub_epi16(full, a);
+				if (mode == composite_blend::ALPHA) {
+					// s * a + d * (255 - a) stays below 65536, one rounding for both
+					const __m128i t = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(s16, a), _mm_mullo_epi16(d16, ia)), round);
+					res[h] = _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+				}
+				else {
+					res[h] = mul255_epi16(d16, ia);
+				}
+			}
+			__m128i out = _mm_packus_epi16(res[0], res[1]);
+			if (mode == composite_blend::PREMULTIPLIED) out = _mm_adds_epu8(out, sv);
+			_mm_storeu_si128((__m128i*)(d + i * 4), out);
+		}
+#endif
+		for (; i < count; ++i) {
+			const uint8_t* sp = s + i * 4;
+			uint8_t* dp = d + i * 4;
+			const unsigned a = sp[3];
+			for (int k = 0; k < 4; ++k) {
+				if (mode == composite_blend::ALPHA) {
+					const unsigned t = sp[k] * a + dp[k] * (255 - a) + 128;
+					dp[k] = static_cast<uint8_t>((t + (t >> 8)) >> 8);
+				}
+				else {
+					dp[k] = static_cast<uint8_t>((std::min)(255u, sp[k] + static_cast<unsigned>(mul255(dp[k], 255 - a))));
+				}
+			}
+		}
+	}
+
+	// out = top * (256 - f) + bottom * f, f in 1/256
+	static void lerp_rows(const uint8_t* top, const uint8_t* bottom, uint8_t* out, const size_t count, const unsigned f)
+	{
+		const size_t bytes = count * 4;
+		size_t i = 0;
+#ifdef ALLEGROCPP_COMPOSITE_SSE2
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i wt = _mm_set1_epi16(static_cast<short>(256 - f));
+		const __m128i wb = _mm_set1_epi16(static_cast<short>(f));
+		const __m128i round = _mm_set1_epi16(128);
+		const auto mix = [&](const __m128i t, const __m128i b) {
+			return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(t, wt), _mm_mullo_epi16(b, wb)), round), 8);
+		};
+		for (; i + 16 <= bytes; i += 16) {
+			const __m128i t = _mm_loadu_si128((const __m128i*)(top + i));
+			const __m128i b = _mm_loadu_si128((const __m128i*)(bottom + i));
+			_mm_storeu_si128((__m128i*)(out + i), _mm_packus_epi16(mix(_mm_unpacklo_epi8(t, zero), _mm_unpacklo_epi8(b, zero)), mix(_mm_unpackhi_epi8(t, zero), _mm_unpackhi_epi8(b, zero))));
+		}
+#endif
+		for (; i < bytes; ++i) out[i] = static_cast<uint8_t>((top[i] * (256 - f) + bottom[i] * f + 128) >> 8);
+	}
+
+	// out[k] = row[i0[k]] * (256 - f[k]) + row[i1[k]] * f[k]
+	static void lerp_columns(const uint8_t* row, const int* i0, const int* i1, const uint16_t* f, uint8_t* out, const size_t count)
+	{
+		size_t k = 0;
+#ifdef ALLEGROCPP_COMPOSITE_SSE2
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i round = _mm_set1_epi16(128);
+		const __m128i full = _mm_set1_epi16(256);
+		const auto load = [&](const int idx) { int v; memcpy(&v, row + static_cast<size_t>(idx) * 4, 4); return _mm_cvtsi32_si128(v); };
+		for (; k + 2 <= count; k += 2) {
+			const __m128i a = _mm_unpacklo_epi8(_mm_unpacklo_epi32(load(i0[k]), load(i0[k + 1])), zero);
+			const __m128i b = _mm_unpacklo_epi8(_mm_unpacklo_epi32(load(i1[k]), load(i1[k + 1])), zero);
+			const __m128i w1 = _mm_set_epi16(f[k + 1], f[k + 1], f[k + 1], f[k + 1], f[k], f[k], f[k], f[k]);
+			const __m128i w0 = _mm_sub_epi16(full, w1);
+			const __m128i r = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(a, w0), _mm_mullo_epi16(b, w1)), round), 8);
+			_mm_storel_epi64((__m128i*)(out + k * 4), _mm_packus_epi16(r, zero));
+		}
+#endif
+		for (; k < count; ++k) {
+			const uint8_t* a = row + static_cast<size_t>(i0[k]) * 4;
+			const uint8_t* b = row + static_cast<size_t>(i1[k]) * 4;
+			for (int c = 0; c < 4; ++c) out[k * 4 + c] = static_cast<uint8_t>((a[c] * (256u - f[k]) + b[c] * f[k] + 128) >> 8);
+		}
+	}
+
+	// Source sample of each target pixel on one axis. i0/i1 are source pixels in [lo, hi), f the weight of i1 in 1/256.
+	static void map_axis(const int first, const int count, const double d, const double dsize, const double s, const double ssize, const bool flip, const bool linear,
+		const int lo, const int hi, std::vector<int>& i0, std::vector<int>& i1, std::vector<uint16_t>& f)
+	{
+		i0.resize(count);
+		i1.resize(count);
+		f.resize(count);
+		const double step = ssize / dsize;
+		for (int k = 0; k < count; ++k) {
+			double u = (first + k + 0.5 - d) * step;
+			if (flip) u = ssize - u;
+			u += s;
+			int i, w = 0;
+			if (!linear) {
+				i = static_cast<int>(std::floor(u));
+			}
+			else {
+				const double fl = std::floor(u - 0.5);
+				i = static_cast<int>(fl);
+				w = static_cast<int>(std::lround((u - 0.5 - fl) * 256.0));
+				if (w == 256) { ++i; w = 0; }
+			}
+			if (i < lo) { i = lo; w = 0; }
+			if (i >= hi - 1) { i = hi - 1; w = 0; }
+			i0[k] = i;
+			i1[k] = w ? i + 1 : i;
+			f[k] = static_cast<uint16_t>(w);
+		}
+	}
+
+	// Target pixels with their center in the rect, inside the surface and the clip. False if none.
+	static bool target_box(const int width, const int height, const float dx, const float dy, const float dw, const float dh, const composite_options& opts, int& x0, int& y0, int& x1, int& y1)
+	{
+		int cx0 = 0, cy0 = 0, cx1 = width, cy1 = height;
+		if (opts.clip_width >= 0 && opts.clip_height >= 0) {
+			cx0 = (std::max)(cx0, opts.clip_x);
+			cy0 = (std::max)(cy0, opts.clip_y);
+			cx1 = (std::min)(cx1, opts.clip_x + opts.clip_width);
+			cy1 = (std::min)(cy1, opts.clip_y + opts.clip_height);
+		}
+		x0 = (std::max)(static_cast<int>(std::ceil(dx - 0.5)), cx0);
+		y0 = (std::max)(static_cast<int>(std::ceil(dy - 0.5)), cy0);
+		x1 = (std::min)(static_cast<int>(std::ceil(static_cast<double>(dx) + dw - 0.5)), cx1);
+		y1 = (std::min)(static_cast<int>(std::ceil(static_cast<double>(dy) + dh - 0.5)), cy1);
+		return x0 < x1 && y0 < y1;
+	}
+
+	// Source pixels the rect touches, inside the surface. False if none.
+	static bool source_box(const int width, const int height, const float sx, const float sy, const float sw, const float sh, int& x0, int& y0, int& x1, int& y1)
+	{
+		x0 = (std::max)(static_cast<int>(std::floor(sx)), 0);
+		y0 = (std::max)(static_cast<int>(std::floor(sy)), 0);
+		x1 = (std::min)(static_cast<int>(std::ceil(static_cast<double>(sx) + sw)), width);
+		y1 = (std::min)(static_cast<int>(std::ceil(static_cast<double>(sy) + sh)), height);
+		return x0 < x1 && y0 < y1;
+	}
+
+	bool composite(const composite_surface& src, const float sx, const float sy, const float sw, const float sh,
+		const composite_surface& dst, const float dx, const float dy, const float dw, const float dh, const composite_options& opts)
+	{
+		if (!src.data || !dst.data || !(sw > 0.0f) || !(sh > 0.0f) || !(dw > 0.0f) || !(dh > 0.0f)) return false;
+		if (!pixel_convert_supported(src.format, composite_rgba8) || !pixel_convert_supported(composite_rgba8, dst.format)) return false;
+
+		int x0, y0, x1, y1, bx0, by0, bx1, by1;
+		if (!target_box(dst.width, dst.height, dx, dy, dw, dh, opts, x0, y0, x1, y1)) return true;
+		if (!source_box(src.width, src.height, sx, sy, sw, sh, bx0, by0, bx1, by1)) return true;
+
+		const bool linear = opts.filter == composite_filter::LINEAR;
+		const size_t n = static_cast<size_t>(x1 - x0);
+		std::vector<int> ix0, ix1, iy0, iy1;
+		std::vector<uint16_t> fx, fy;
+		map_axis(x0, x1 - x0, dx, dw, sx, sw, (opts.flags & ALLEGRO_FLIP_HORIZONTAL) != 0, linear, bx0, bx1, ix0, ix1, fx);
+		map_axis(y0, y1 - y0, dy, dh, sy, sh, (opts.flags & ALLEGRO_FLIP_VERTICAL) != 0, linear, by0, by1, iy0, iy1, fy);
+
+		// only the columns used are converted, indexes below are relative to cmin
+		const int cmin = *std::min_element(ix0.begin(), ix0.end());
+		const int cmax = *std::max_element(ix1.begin(), ix1.end());
+		bool straight = true, blended_columns = false;
+		for (size_t k = 0; k < n; ++k) {
+			if (fx[k]) blended_columns = true;
+			ix0[k] -= cmin;
+			ix1[k] -= cmin;
+			if (ix0[k] != ix0[0] + static_cast<int>(k)) straight = false;
+		}
+		straight = straight && !blended_columns; // target row is a plain run of a source row
+
+		const int src_bytes = al_get_pixel_size(src.format);
+		const int dst_bytes = al_get_pixel_size(dst.format);
+		const bool tinted = opts.tint.r != 255 || opts.tint.g != 255 || opts.tint.b != 255 || opts.tint.a != 255;
+		const bool direct_dst = is_rgba8(dst.format);
+		const size_t span = static_cast<size_t>(cmax - cmin + 1);
+
+		const auto src_row = [&](const int y) { return static_cast<const uint8_t*>(src.data) + static_cast<ptrdiff_t>(y) * src.pitch; };
+
+		// two converted source rows, the older one is replaced (linear needs both, upscaling reuses them)
+		std::vector<uint8_t> cache[2], vbuf, line(n * 4), dline(direct_dst ? 0 : n * 4);
+		int cached[2] = { -1, -1 }, last = 0;
+		const auto fetch = [&](const int y) -> const uint8_t* {
+			for (int s = 0; s < 2; ++s) if (cached[s] == y) { last = s; return cache[s].data(); }
+			const int s = 1 - last;
+			cache[s].resize(span * 4);
+			convert_pixels(src_row(y) + static_cast<ptrdiff_t>(cmin) * src_bytes, src.format, cache[s].data(), composite_rgba8, span);
+			cached[s] = y;
+			last = s;
+			return cache[s].data();
+		};
+
+		for (int y = y0; y < y1; ++y) {
+			const size_t k = static_cast<size_t>(y - y0);
+			uint8_t* drow = static_cast<uint8_t*>(dst.data) + static_cast<ptrdiff_t>(y) * dst.pitch + static_cast<ptrdiff_t>(x0) * dst_bytes;
+			const uint8_t* srun = src_row(iy0[k]) + static_cast<ptrdiff_t>(cmin + ix0[0]) * src_bytes;
+
+			if (straight && !fy[k] && !tinted && opts.blend == composite_blend::COPY) {
+				convert_pixels(srun, src.format, drow, dst.format, n);
+				continue;
+			}
+
+			if (straight && !fy[k]) {
+				convert_pixels(srun, src.format, line.data(), composite_rgba8, n);
+			}
+			else {
+				const uint8_t* r = fetch(iy0[k]);
+				if (fy[k]) {
+					vbuf.resize(span * 4);
+					lerp_rows(r, fetch(iy1[k]), vbuf.data(), span, fy[k]);
+					r = vbuf.data();
+				}
+				if (blended_columns) lerp_columns(r, ix0.data(), ix1.data(), fx.data(), line.data(), n);
+				else if (straight) memcpy(line.data(), r + static_cast<size_t>(ix0[0]) * 4, n * 4);
+				else for (size_t i = 0; i < n; ++i) memcpy(line.data() + i * 4, r + static_cast<size_t>(ix0[i]) * 4, 4);
+			}
+
+			if (tinted) tint_span(line.data(), n, opts.tint);
+
+			if (opts.blend == composite_blend::COPY) {
+				convert_pixels(line.data(), composite_rgba8, drow, dst.format, n);
+			}
+			else if (direct_dst) {
+				blend_span(line.data(), drow, n, opts.blend);
+			}
+			else {
+				convert_pixels(drow, dst.format, dline.data(), composite_rgba8, n);
+				blend_span(line.data(), dline.data(), n, opts.blend);
+				convert_pixels(dline.data(), composite_rgba8, drow, dst.format, n);
+			}
+		}
+		return true;
+	}
+
+	static ALLEGRO_BITMAP* root_of(ALLEGRO_BITMAP* bmp)
+	{
+		while (bmp && al_is_sub_bitmap(bmp)) bmp = al_get_parent_bitmap(bmp);
+		return bmp;
+	}
+
+	bool composite_supported(ALLEGRO_BITMAP* src, ALLEGRO_BITMAP* dst)
+	{
+		if (!src || !dst) return false;
+		ALLEGRO_BITMAP* rs = root_of(src);
+		ALLEGRO_BITMAP* rd = root_of(dst);
+		if (rs == rd) return false;
+		if (!(al_get_bitmap_flags(src) & ALLEGRO_MEMORY_BITMAP) || !(al_get_bitmap_flags(dst) & ALLEGRO_MEMORY_BITMAP)) return false;
+		if (al_is_bitmap_locked(src) || al_is_bitmap_locked(dst) || al_is_bitmap_locked(rs) || al_is_bitmap_locked(rd)) return false;
+		return pixel_convert_supported(al_get_bitmap_format(src), composite_rgba8) && pixel_convert_supported(composite_rgba8, al_get_bitmap_format(dst));
+	}
+
+	bool composite(ALLEGRO_BITMAP* src, const float sx, const float sy, const float sw, const float sh,
+		ALLEGRO_BITMAP* dst, const float dx, const float dy, const float dw, const float dh, const composite_options& opts)
+	{
+		if (!composite_supported(src, dst) || !(sw > 0.0f) || !(sh > 0.0f) || !(dw > 0.0f) || !(dh > 0.0f)) return false;
+
+		int x0, y0, x1, y1, bx0, by0, bx1, by1;
+		if (!target_box(al_get_bitmap_width(dst), al_get_bitmap_height(dst), dx, dy, dw, dh, opts, x0, y0, x1, y1)) return true;
+		if (!source_box(al_get_bitmap_width(src), al_get_bitmap_height(src), sx, sy, sw, sh, bx0, by0, bx1, by1)) return true;
+
+		Locked_region from(src, bx0, by0, bx1 - bx0, by1 - by0, ALLEGRO_PIXEL_FORMAT_ANY, ALLEGRO_LOCK_READONLY);
+		Locked_region to(dst, x0, y0, x1 - x0, y1 - y0, ALLEGRO_PIXEL_FORMAT_ANY, opts.blend == composite_blend::COPY ? ALLEGRO_LOCK_WRITEONLY : ALLEGRO_LOCK_READWRITE);
+
+		const composite_surface s{ from.get_data(), from.get_pitch(), from.get_format(), from.get_width(), from.get_height() };
+		const composite_surface d{ to.get_data(), to.get_pitch(), to.get_format(), to.get_width(), to.get_height() };
+		composite_options local = opts;
+		local.clip_width = local.clip_height = -1; // the lock is the clip now
+		return composite(s, sx - bx0, sy - by0, sw, sh, d, dx - x0, dy - y0, dw, dh, local);
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,273 @@
+#include "damage_tracker.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace AllegroCPP {
+
+	namespace _damage_tracker {
+
+		struct watched {
+			ALLEGRO_BITMAP* backbuffer;
+			Damage_tracker* tracker;
+		};
+
+		static std::mutex mtx;
+		static std::vector<watched> list;
+		static std::atomic<size_t> count = 0;
+
+		static int64_t area(const damage_rect& r)
+		{
+			return static_cast<int64_t>(r.width) * r.height;
+		}
+
+		static damage_rect unite(const damage_rect& a, const damage_rect& b)
+		{
+			const int x0 = (std::min)(a.x, b.x), y0 = (std::min)(a.y, b.y);
+			const int x1 = (std::max)(a.x + a.width, b.x + b.width), y1 = (std::max)(a.y + a.height, b.y + b.height);
+			return { x0, y0, x1 - x0, y1 - y0 };
+		}
+
+		static int64_t overlap(const damage_rect& a, const damage_rect& b)
+		{
+			const int w = (std::min)(a.x + a.width, b.x + b.width) - (std::max)(a.x, b.x);
+			const int h = (std::min)(a.y + a.height, b.y + b.height) - (std::max)(a.y, b.y);
+			return w > 0 && h > 0 ? static_cast<int64_t>(w) * h : 0;
+		}
+
+		// pixels a union would present that neither rect needs
+		static int64_t waste(const damage_rect& a, const damage_rect& b)
+		{
+			return area(unite(a, b)) - (area(a) + area(b) - overlap(a, b));
+		}
+
+		static bool contains(const damage_rect& a, const damage_rect& b)
+		{
+			return b.x >= a.x && b.y >= a.y && b.x + b.width <= a.x + a.width && b.y + b.height <= a.y + a.height;
+		}
+
+		static bool clip(damage_rect& r, const int x0, const int y0, const int x1, const int y1)
+		{
+			const int rx1 = (std::min)(r.x + r.width, x1), ry1 = (std::min)(r.y + r.height, y1);
+			r.x = (std::max)(r.x, x0);
+			r.y = (std::max)(r.y, y0);
+			r.width = rx1 - r.x;
+			r.height = ry1 - r.y;
+			return r.width > 0 && r.height > 0;
+		}
+
+		// target's root bitmap and its offset in there
+		static Damage_tracker* find_for_target(ALLEGRO_BITMAP* target, int& off_x, int& off_y)
+		{
+			off_x = off_y = 0;
+			ALLEGRO_BITMAP* root = target;
+			if (al_is_sub_bitmap(target)) {
+				off_x = al_get_bitmap_x(target);
+				off_y = al_get_bitmap_y(target);
+				root = al_get_parent_bitmap(target);
+			}
+			for (const auto& i : list) {
+				if (i.backbuffer == root) return i.tracker;
+			}
+			return nullptr;
+		}
+
+	}
+
+	void Damage_tracker::merge_in(damage_rect r)
+	{
+		using namespace _damage_tracker;
+
+		// join anything it touches (or nearly), rects never overlap after this
+		for (size_t i = 0; i < m_rects.size();) {
+			const damage_rect& e = m_rects[i];
+			if (contains(e, r)) return;
+			if (overlap(e, r) > 0 || waste(e, r) <= (area(e) + area(r)) / 4) {
+				r = unite(e, r);
+				m_rects.erase(m_rects.begin() + i);
+				i = 0;
+				continue;
+			}
+			++i;
+		}
+		m_rects.push_back(r);
+
+		while (m_rects.size() > m_max_rects && m_rects.size() > 1) {
+			size_t ba = 0, bb = 1;
+			int64_t best = waste(m_rects[0], m_rects[1]);
+			for (size_t a = 0; a < m_rects.size(); ++a) {
+				for (size_t b = a + 1; b < m_rects.size(); ++b) {
+					const int64_t w = waste(m_rects[a], m_rects[b]);
+					if (w < best) { best = w; ba = a; bb = b; }
+				}
+			}
+			const damage_rect u = unite(m_rects[ba], m_rects[bb]);
+			m_rects.erase(m_rects.begin() + bb);
+			m_rects.erase(m_rects.begin() + ba);
+			merge_in(u);
+		}
+	}
+
+	Damage_tracker::Damage_tracker(Display& disp, const size_t max_rects, const float full_flip_ratio)
+		: m_disp(disp.get_display_ref()), m_backbuffer(disp.get_backbuffer()), m_max_rects((std::max)(max_rects, static_cast<size_t>(1))), m_full_ratio(full_flip_ratio)
+	{
+		if (!m_backbuffer) throw std::invalid_argument("Display is empty!");
+
+		std::lock_guard<std::mutex> l(_damage_tracker::mtx);
+		_damage_tracker::list.push_back({ m_backbuffer, this });
+		++_damage_tracker::count;
+	}
+
+	Damage_tracker::~Damage_tracker()
+	{
+		std::lock_guard<std::mutex> l(_damage_tracker::mtx);
+		auto& lst = _damage_tracker::list;
+		lst.erase(std::remove_if(lst.begin(), lst.end(), [this](const _damage_tracker::watched& w) { return w.tracker == this; }), lst.end());
+		--_damage_tracker::count;
+	}
+
+	void Damage_tracker::add(const int pos_x, const int pos_y, const int width, const int height)
+	{
+		add(damage_rect{ pos_x, pos_y, width, height });
+	}
+
+	void Damage_tracker::add(const damage_rect& rect)
+	{
+		damage_rect r = rect;
+		if (!_damage_tracker::clip(r, 0, 0, al_get_bitmap_width(m_backbuffer), al_get_bitmap_height(m_backbuffer))) return;
+
+		std::lock_guard<std::mutex> l(m_mtx);
+		if (m_full) return;
+		merge_in(r);
+	}
+
+	void Damage_tracker::invalidate()
+	{
+		std::lock_guard<std::mutex> l(m_mtx);
+		m_full = true;
+		m_rects.clear();
+	}
+
+	std::vector<damage_rect> Damage_tracker::get_pending() const
+	{
+		std::lock_guard<std::mutex> l(m_mtx);
+		return m_rects;
+	}
+
+	bool Damage_tracker::is_full() const
+	{
+		std::lock_guard<std::mutex> l(m_mtx);
+		return m_full;
+	}
+
+	bool Damage_tracker::present()
+	{
+		const auto disp = m_disp.lock();
+		if (!disp) return false;
+
+		std::lock_guard<std::mutex> l(m_mtx);
+		std::vector<damage_rect> rects;
+		rects.swap(m_rects);
+		bool full = m_full;
+		m_full = false;
+		++m_stats.presents;
+
+		if (!full && rects.empty()) return true;
+
+		const int64_t total = static_cast<int64_t>(al_get_display_width(disp.get())) * al_get_display_height(disp.get());
+		int64_t damaged = 0;
+		for (const auto& i : rects) damaged += _damage_tracker::area(i);
+
+		if (!al_get_display_option(disp.get(), ALLEGRO_UPDATE_DISPLAY_REGION) || static_cast<double>(damaged) > static_cast<double>(total) * m_full_ratio) full = true;
+
+		if (al_get_current_display() != disp.get()) al_set_target_backbuffer(disp.get());
+		if (full) {
+			al_flip_display();
+			++m_stats.full_flips;
+			m_stats.pixels_presented += static_cast<uint64_t>(total);
+			return true;
+		}
+		for (const auto& i : rects) al_update_display_region(i.x, i.y, i.width, i.height);
+		m_stats.region_updates += rects.size();
+		m_stats.pixels_presented += static_cast<uint64_t>(damaged);
+		return true;
+	}
+
+	void Damage_tracker::set_max_rects(const size_t max_rects)
+	{
+		std::lock_guard<std::mutex> l(m_mtx);
+		m_max_rects = (std::max)(max_rects, static_cast<size_t>(1));
+	}
+
+	void Damage_tracker::set_full_flip_ratio(const float ratio)
+	{
+		std::lock_guard<std::mutex> l(m_mtx);
+		m_full_ratio = ratio;
+	}
+
+	damage_stats Damage_tracker::get_stats() const
+	{
+		std::lock_guard<std::mutex> l(m_mtx);
+		return m_stats;
+	}
+
+	bool damage_tracking_active()
+	{
+		return _damage_tracker::count.load(std::memory_order_relaxed) != 0;
+	}
+
+	void damage_report(const float pos_x, const float pos_y, const float width, const float height)
+	{
+		if (!damage_tracking_active()) return;
+		ALLEGRO_BITMAP* target = al_get_target_bitmap();
+		if (!target) return;
+
+		std::lock_guard<std::mutex> l(_damage_tracker::mtx);
+		int off_x, off_y;
+		Damage_tracker* tracker = _damage_tracker::find_for_target(target, off_x, off_y);
+		if (!tracker) return;
+
+		// bounds of the transformed corners, one pixel extra for antialiasing and rounding
+		float xs[4] = { pos_x, pos_x + width, pos_x, pos_x + width };
+		float ys[4] = { pos_y, pos_y, pos_y + height, pos_y + height };
+		const ALLEGRO_TRANSFORM* t = al_get_current_transform();
+		if (t) for (int i = 0; i < 4; ++i) al_transform_coordinates(t, &xs[i], &ys[i]);
+
+		damage_rect r;
+		r.x = static_cast<int>(std::floor(*std::min_element(xs, xs + 4))) - 1;
+		r.y = static_cast<int>(std::floor(*std::min_element(ys, ys + 4))) - 1;
+		r.width = static_cast<int>(std::ceil(*std::max_element(xs, xs + 4))) + 1 - r.x;
+		r.height = static_cast<int>(std::ceil(*std::max_element(ys, ys + 4))) + 1 - r.y;
+
+		int cx, cy, cw, ch;
+		al_get_clipping_rectangle(&cx, &cy, &cw, &ch);
+		if (!_damage_tracker::clip(r, cx, cy, cx + cw, cy + ch)) return;
+
+		r.x += off_x;
+		r.y += off_y;
+		tracker->add(r);
+	}
+
+	void damage_report_all()
+	{
+		if (!damage_tracking_active()) return;
+		ALLEGRO_BITMAP* target = al_get_target_bitmap();
+		if (!target) return;
+
+		std::lock_guard<std::mutex> l(_damage_tracker::mtx);
+		int off_x, off_y;
+		Damage_tracker* tracker = _damage_tracker::find_for_target(target, off_x, off_y);
+		if (!tracker) return;
+
+		damage_rect r;
+		al_get_clipping_rectangle(&r.x, &r.y, &r.width, &r.height);
+		if (!al_is_sub_bitmap(target) && r.x <= 0 && r.y <= 0 && r.x + r.width >= al_get_bitmap_width(target) && r.y + r.height >= al_get_bitmap_height(target)) {
+			tracker->invalidate();
+			return;
+		}
+		r.x += off_x;
+		r.y += off_y;
+		tracker->add(r);
+	}
+
+}
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "display.h"
+#include "damage_tracker.h"
 
 #ifdef _WIN32
 #include <windows.h>
@@ -380,6 +381,7 @@ namespace AllegroCPP {
 		ALLEGRO_BITMAP* oldtarg = al_get_target_bitmap();
 		al_set_target_backbuffer(m_disp.get());
 		al_clear_to_color(color);
+		damage_report_all();
 		al_set_target_bitmap(oldtarg);
 		return true;
 	}
@@ -0,0 +1,359 @@
+#include "draw_command_buffer.h"
+#include "damage_tracker.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <type_traits>
+
+namespace AllegroCPP {
+
+	namespace _draw_command {
+
+		// every command is a header and its payload, padded so the next header (and vertex data) stays 8 byte aligned
+		struct header {
+			Draw_command_buffer::command cmd;
+			uint8_t pad[3];
+			uint32_t size; // payload, padding included
+		};
+
+		struct bitmap_cmd {
+			uint32_t slot;
+			bitmap_cut cut;
+			bitmap_rotate_transform transf;
+			ALLEGRO_COLOR color;
+			bitmap_scale scale;
+			bitmap_position_and_flags pos_and_flag;
+		};
+
+		struct text_cmd {
+			uint32_t font;
+		};
+
+		struct glyph_cmd {
+			uint32_t font;
+			int codepoint;
+			float target_x, target_y;
+			ALLEGRO_COLOR color;
+		};
+
+		struct vertexes_cmd {
+			int32_t texture; // -1 none
+			int32_t type;
+			uint32_t count; // ALLEGRO_VERTEX after this
+			uint32_t pad;
+		};
+
+		struct clear_cmd {
+			ALLEGRO_COLOR color;
+		};
+
+		struct blender_cmd {
+			int op, src, dst, alpha_op, alpha_src, alpha_dst;
+		};
+
+		static_assert(std::is_trivially_copyable_v<bitmap_cmd> && std::is_trivially_copyable_v<glyph_cmd>);
+		static_assert(sizeof(vertex_point) == sizeof(ALLEGRO_VERTEX));
+		static_assert(sizeof(header) == 8 && sizeof(vertexes_cmd) % 8 == 0);
+
+		constexpr size_t padded(const size_t len) { return (len + 7) & ~static_cast<size_t>(7); }
+
+		template<typename T>
+		static T read(const uint8_t* p)
+		{
+			T t;
+			memcpy(&t, p, sizeof(T));
+			return t;
+		}
+
+	}
+
+	template<typename T>
+	void Draw_command_buffer::push(const command cmd, const T& payload, const void* extra, const size_t extra_len)
+	{
+		const size_t size = _draw_command::padded(sizeof(T) + extra_len);
+		const _draw_command::header h{ cmd, {}, static_cast<uint32_t>(size) };
+
+		const size_t off = m_stream.size();
+		m_stream.resize(off + sizeof(h) + size, 0);
+		memcpy(m_stream.data() + off, &h, sizeof(h));
+		memcpy(m_stream.data() + off + sizeof(h), &payload, sizeof(T));
+		if (extra_len) memcpy(m_stream.data() + off + sizeof(h) + sizeof(T), extra, extra_len);
+		++m_commands;
+	}
+
+	uint32_t Draw_command_buffer::bitmap_slot(const Bitmap& bmp)
+	{
+		ALLEGRO_BITMAP* raw = bmp.get_for_draw();
+		auto it = m_bitmap_index.find(raw);
+		if (it != m_bitmap_index.end()) return it->second;
+		const uint32_t slot = static_cast<uint32_t>(m_bitmaps.size());
+		m_bitmaps.push_back(bmp.make_ref());
+		m_bitmap_index[raw] = slot;
+		return slot;
+	}
+
+	Draw_command_buffer::Draw_command_buffer(Draw_command_buffer&& oth) noexcept
+		: m_stream(std::move(oth.m_stream)), m_bitmaps(std::move(oth.m_bitmaps)), m_bitmap_index(std::move(oth.m_bitmap_index)), m_fonts(std::move(oth.m_fonts)), m_commands(oth.m_commands)
+	{
+		oth.m_commands = 0;
+	}
+
+	void Draw_command_buffer::operator=(Draw_command_buffer&& oth) noexcept
+	{
+		m_stream = std::move(oth.m_stream);
+		m_bitmaps = std::move(oth.m_bitmaps);
+		m_bitmap_index = std::move(oth.m_bitmap_index);
+		m_fonts = std::move(oth.m_fonts);
+		m_commands = oth.m_commands;
+		oth.m_commands = 0;
+	}
+
+	bool Draw_command_buffer::record(const Bitmap& bmp)
+	{
+		if (!bmp.get_for_draw()) return false;
+		const auto& p = bmp.m_stored_draw_props;
+		push(command::BITMAP, _draw_command::bitmap_cmd{ bitmap_slot(bmp), p._cut, p._transf, p._color, p._scale, p._pos_and_flag });
+		return true;
+	}
+
+	bool Draw_command_buffer::record(const Bitmap& bmp, const float target_x, const float target_y, const int flags)
+	{
+		if (!bmp.get_for_draw()) return false;
+		const auto& p = bmp.m_stored_draw_props;
+		push(command::BITMAP, _draw_command::bitmap_cmd{ bitmap_slot(bmp), p._cut, p._transf, p._color, p._scale, bitmap_position_and_flags{ target_x, target_y, flags } });
+		return true;
+	}
+
+	bool Draw_command_buffer::record(const Font& font)
+	{
+		if (font.empty()) return false;
+		m_fonts.push_back(font.make_ref());
+		push(command::TEXT, _draw_command::text_cmd{ static_cast<uint32_t>(m_fonts.size() - 1) });
+		return true;
+	}
+
+	bool Draw_command_buffer::record(const Font& font, const float target_x, const float target_y, const UTFstring& str)
+	{
+		if (font.empty()) return false;
+		m_fonts.push_back(font.make_ref());
+		m_fonts.back().m_stored_draw_props._string = str;
+		m_fonts.back().m_stored_draw_props._pos = { target_x, target_y };
+		push(command::TEXT, _draw_command::text_cmd{ static_cast<uint32_t>(m_fonts.size() - 1) });
+		return true;
+	}
+
+	bool Draw_command_buffer::record_glyph(const Font& font, const float target_x, const float target_y, const int codepoint, const ALLEGRO_COLOR color)
+	{
+		if (font.empty()) return false;
+		m_fonts.push_back(font.make_ref());
+		push(command::GLYPH, _draw_command::glyph_cmd{ static_cast<uint32_t>(m_fonts.size() - 1), codepoint, target_x, target_y, color });
+		return true;
+	}
+
+	bool Draw_command_buffer::record(const Vertexes& vtx)
+	{
+		bool good = false;
+		vtx.csafe([&](const std::vector<vertex_point>& pts) {
+			if (pts.empty()) return;
+			const int32_t tex = vtx.textur.valid() ? static_cast<int32_t>(bitmap_slot(vtx.textur)) : -1;
+			push(command::VERTEXES, _draw_command::vertexes_cmd{ tex, static_cast<int32_t>(vtx.type), static_cast<uint32_t>(pts.size()), 0 }, pts.data(), pts.size() * sizeof(ALLEGRO_VERTEX));
+			good = true;
+		});
+		return good;
+	}
+
+	void Draw_command_buffer::record_clear(const ALLEGRO_COLOR color)
+	{
+		push(command::CLEAR, _draw_command::clear_cmd{ color });
+	}
+
+	void Draw_command_buffer::record_blender(const int op, const int src, const int dst)
+	{
+		push(command::BLENDER, _draw_command::blender_cmd{ op, src, dst, op, src, dst });
+	}
+
+	void Draw_command_buffer::record_blender(const int op, const int src, const int dst, const int alpha_op, const int alpha_src, const int alpha_dst)
+	{
+		push(command::BLENDER, _draw_command::blender_cmd{ op, src, dst, alpha_op, alpha_src, alpha_dst });
+	}
+
+	void Draw_command_buffer::record_blend_color(const ALLEGRO_COLOR color)
+	{
+		push(command::BLEND_COLOR, _draw_command::clear_cmd{ color });
+	}
+
+	void Draw_command_buffer::append(const Draw_command_buffer& oth)
+	{
+		if (&oth == this) return;
+
+		// other's slots in this buffer
+		std::vector<uint32_t> bmp_map(oth.m_bitmaps.size());
+		for (size_t i = 0; i < oth.m_bitmaps.size(); ++i) bmp_map[i] = bitmap_slot(oth.m_bitmaps[i]);
+		const uint32_t font_base = static_cast<uint32_t>(m_fonts.size());
+		for (const auto& i : oth.m_fonts) m_fonts.push_back(i.make_ref());
+
+		const size_t base = m_stream.size();
+		m_stream.insert(m_stream.end(), oth.m_stream.begin(), oth.m_stream.end());
+		m_commands += oth.m_commands;
+
+		for (size_t off = base; off < m_stream.size();) {
+			const auto h = _draw_command::read<_draw_command::header>(m_stream.data() + off);
+			uint8_t* p = m_stream.data() + off + sizeof(h);
+			switch (h.cmd) {
+			case command::BITMAP:
+			{
+				auto c = _draw_command::read<_draw_command::bitmap_cmd>(p);
+				c.slot = bmp_map[c.slot];
+				memcpy(p, &c, sizeof(c));
+			}
+				break;
+			case command::TEXT:
+			{
+				auto c = _draw_command::read<_draw_command::text_cmd>(p);
+				c.font += font_base;
+				memcpy(p, &c, sizeof(c));
+			}
+				break;
+			case command::GLYPH:
+			{
+				auto c = _draw_command::read<_draw_command::glyph_cmd>(p);
+				c.font += font_base;
+				memcpy(p, &c, sizeof(c));
+			}
+				break;
+			case command::VERTEXES:
+			{
+				auto c = _draw_command::read<_draw_command::vertexes_cmd>(p);
+				if (c.texture >= 0) c.texture = static_cast<int32_t>(bmp_map[static_cast<size_t>(c.texture)]);
+				memcpy(p, &c, sizeof(c));
+			}
+				break;
+			default:
+				break;
+			}
+			off += sizeof(h) + h.size;
+		}
+	}
+
+	bool Draw_command_buffer::replay()
+	{
+		if (!al_get_target_bitmap()) return false;
+
+		int op, src, dst, aop, asrc, adst;
+		al_get_separate_blender(&op, &src, &dst, &aop, &asrc, &adst);
+		const ALLEGRO_COLOR blend_color = al_get_blend_color();
+		bool blender_changed = false;
+
+		// hold runs of bitmaps and text, Allegro wants no state change while held
+		const bool was_held = al_is_bitmap_drawing_held();
+		bool held = false;
+		const auto hold = [&](const bool on) {
+			if (was_held || held == on) return;
+			al_hold_bitmap_drawing(on);
+			held = on;
+		};
+
+		for (size_t off = 0; off < m_stream.size();) {
+			const auto h = _draw_command::read<_draw_command::header>(m_stream.data() + off);
+			const uint8_t* p = m_stream.data() + off + sizeof(h);
+			off += sizeof(h) + h.size;
+
+			switch (h.cmd) {
+			case command::BITMAP:
+			{
+				hold(true);
+				const auto c = _draw_command::read<_draw_command::bitmap_cmd>(p);
+				Bitmap& b = m_bitmaps[c.slot];
+				auto& props = b.m_stored_draw_props;
+				props._cut = c.cut;
+				props._transf = c.transf;
+				props._color = c.color;
+				props._scale = c.scale;
+				props._pos_and_flag = c.pos_and_flag;
+				b.draw();
+			}
+				break;
+			case command::TEXT:
+				hold(true);
+				m_fonts[_draw_command::read<_draw_command::text_cmd>(p).font].draw();
+				break;
+			case command::GLYPH:
+			{
+				hold(true);
+				const auto c = _draw_command::read<_draw_command::glyph_cmd>(p);
+				m_fonts[c.font].draw_glyph(c.target_x, c.target_y, c.codepoint, c.color);
+			}
+				break;
+			case command::VERTEXES:
+			{
+				hold(false);
+				const auto c = _draw_command::read<_draw_command::vertexes_cmd>(p);
+				const ALLEGRO_VERTEX* v = reinterpret_cast<const ALLEGRO_VERTEX*>(p + sizeof(c));
+				al_draw_prim(v, nullptr, c.texture >= 0 ? m_bitmaps[static_cast<size_t>(c.texture)].get_for_draw() : nullptr, 0, static_cast<int>(c.count), c.type);
+				if (!damage_tracking_active()) break;
+
+				float x0 = v[0].x, y0 = v[0].y, x1 = x0, y1 = y0;
+				for (uint32_t i = 1; i < c.count; ++i) {
+					x0 = (std::min)(x0, v[i].x);
+					y0 = (std::min)(y0, v[i].y);
+					x1 = (std::max)(x1, v[i].x);
+					y1 = (std::max)(y1, v[i].y);
+				}
+				damage_report(x0, y0, x1 - x0, y1 - y0);
+			}
+				break;
+			case command::CLEAR:
+				hold(false);
+				al_clear_to_color(_draw_command::read<_draw_command::clear_cmd>(p).color);
+				damage_report_all();
+				break;
+			case command::BLENDER:
+			{
+				hold(false);
+				const auto c = _draw_command::read<_draw_command::blender_cmd>(p);
+				al_set_separate_blender(c.op, c.src, c.dst, c.alpha_op, c.alpha_src, c.alpha_dst);
+				blender_changed = true;
+			}
+				break;
+			case command::BLEND_COLOR:
+				hold(false);
+				al_set_blend_color(_draw_command::read<_draw_command::clear_cmd>(p).color);
+				blender_changed = true;
+				break;
+			}
+		}
+
+		hold(false);
+		if (blender_changed) {
+			al_set_separate_blender(op, src, dst, aop, asrc, adst);
+			al_set_blend_color(blend_color);
+		}
+		return true;
+	}
+
+	void Draw_command_buffer::clear()
+	{
+		m_stream.clear();
+		m_bitmaps.clear();
+		m_bitmap_index.clear();
+		m_fonts.clear();
+		m_commands = 0;
+	}
+
+	bool Draw_command_buffer::empty() const
+	{
+		return m_commands == 0;
+	}
+
+	size_t Draw_command_buffer::size() const
+	{
+		return m_commands;
+	}
+
+	size_t Draw_command_buffer::stream_bytes() const
+	{
+		return m_stream.size();
+	}
+
+}
\ No newline at end of file
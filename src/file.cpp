@@ -1,7 +1,21 @@
 #include "file.h"
+#include "numeric_text.h"
+#include "cpu_features.h"
 
 #include <utility>
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#if !defined(ALLEGROCPP_X86) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 namespace AllegroCPP {
 
 	File_shareable_ptr make_shareable_file(ALLEGRO_FILE* fp, std::function<void(ALLEGRO_FILE*)> destr)
@@ -10,6 +24,148 @@ namespace AllegroCPP {
 		return std::shared_ptr<upt>(new upt(fp, destr));
 	}
 
+	// Reads while characters can be part of a T. The first one that can't (the separator) is consumed too.
+	template<typename T>
+	static void read_number(File& f, T& val)
+	{
+		char buf[_numeric_text::buffer_size];
+		size_t len = 0;
+		bool overflow = false;
+		for (char c; f.read(&c, sizeof(c)) != 0 && _numeric_text::accepts<T>(c);) {
+			if (len < sizeof(buf)) buf[len++] = c;
+			else overflow = true;
+		}
+		if (overflow) val = 0;
+		else _numeric_text::parse(buf, len, val);
+	}
+
+#ifdef ALLEGROCPP_X86
+	// order is the 16 byte shuffle that reverses each value in a block. Both return how many bytes they did.
+	ALLEGROCPP_TARGET("ssse3")
+	static size_t byteswap_ssse3(uint8_t* d, const uint8_t* s, const size_t bytes, const int8_t* order)
+	{
+		const __m128i mask = _mm_load_si128((const __m128i*)order);
+		size_t p = 0;
+		for (; p + 16 <= bytes; p += 16) {
+			const __m128i v = _mm_loadu_si128((const __m128i*)(s + p));
+			_mm_storeu_si128((__m128i*)(d + p), _mm_shuffle_epi8(v, mask));
+		}
+		return p;
+	}
+
+	ALLEGROCPP_TARGET("avx2")
+	static size_t byteswap_avx2(uint8_t* d, const uint8_t* s, const size_t bytes, const int8_t* order)
+	{
+		const __m256i mask = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i*)order)); // shuffle is per 128 bit lane, same pattern on both
+		size_t p = 0;
+		for (; p + 32 <= bytes; p += 32) {
+			const __m256i v = _mm256_loadu_si256((const __m256i*)(s + p));
+			_mm256_storeu_si256((__m256i*)(d + p), _mm256_shuffle_epi8(v, mask));
+		}
+		return p;
+	}
+#endif
+
+	void byteswap_array(void* dst, const void* src, const size_t count, const size_t width)
+	{
+		uint8_t* d = (uint8_t*)dst;
+		const uint8_t* s = (const uint8_t*)src;
+		const size_t bytes = count * width;
+		size_t p = 0;
+
+		if (width != 2 && width != 4 && width != 8) {
+			if (d != s) memmove(d, s, bytes);
+			return;
+		}
+
+#ifdef ALLEGROCPP_X86
+		const auto& cpu = _cpu_features::get();
+		if (cpu.ssse3) {
+			alignas(16) int8_t order[16];
+			for (int i = 0; i < 16; ++i) order[i] = static_cast<int8_t>((i / width) * width + (width - 1 - i % width));
+			if (cpu.avx2) p = byteswap_avx2(d, s, bytes, order);
+			p += byteswap_ssse3(d + p, s + p, bytes - p, order);
+		}
+#elif defined(__ARM_NEON)
+		for (; p + 16 <= bytes; p += 16) {
+			const uint8x16_t v = vld1q_u8(s + p);
+			vst1q_u8(d + p, width == 2 ? vrev16q_u8(v) : (width == 4 ? vrev32q_u8(v) : vrev64q_u8(v)));
+		}
+#endif
+
+		for (; p < bytes; p += width) {
+			uint8_t tmp[8];
+			memcpy(tmp, s + p, width);
+			for (size_t b = 0; b < width; ++b) d[p + b] = tmp[width - 1 - b];
+		}
+	}
+
+	// Allegro does not export the stdio interface, so grab it once from a clean state.
+	static const ALLEGRO_FILE_INTERFACE* stdio_file_interface()
+	{
+		static const ALLEGRO_FILE_INTERFACE* stdio = [] {
+			ALLEGRO_STATE st;
+			al_store_state(&st, ALLEGRO_STATE_NEW_FILE_INTERFACE);
+			al_set_standard_file_interface();
+			const ALLEGRO_FILE_INTERFACE* ptr = al_get_new_file_interface();
+			al_restore_state(&st);
+			return ptr;
+		}();
+		return stdio;
+	}
+
+	file_positional_source::file_positional_source(File_shareable_ptr fp, const int fdesc, const bool owns)
+		: keep(fp), fd(fdesc), owns_fd(owns)
+	{
+	}
+
+	file_positional_source::~file_positional_source()
+	{
+#ifndef _WIN32
+		if (owns_fd && fd >= 0) ::close(fd);
+#endif
+	}
+
+	size_t file_positional_source::read_at(const int64_t offset, void* buf, const size_t len)
+	{
+		if (offset < 0) return 0;
+#ifndef _WIN32
+		if (fd >= 0) {
+			size_t done = 0;
+			while (done < len) {
+				const ssize_t res = ::pread(fd, (char*)buf + done, len - done, static_cast<off_t>(offset + done));
+				if (res < 0 && errno == EINTR) continue;
+				if (res <= 0) break;
+				done += static_cast<size_t>(res);
+			}
+			return done;
+		}
+#endif
+		if (!keep || !keep->get()) return 0;
+
+		std::lock_guard<std::mutex> l(mtx);
+		ALLEGRO_FILE* fp = keep->get();
+		const int64_t was = al_ftell(fp);
+		if (!al_fseek(fp, offset, ALLEGRO_SEEK_SET)) return 0;
+		const size_t done = al_fread(fp, buf, len);
+		al_fclearerr(fp);
+		al_fseek(fp, was, ALLEGRO_SEEK_SET);
+		return done;
+	}
+
+	int64_t file_positional_source::size()
+	{
+#ifndef _WIN32
+		if (fd >= 0) {
+			struct stat st {};
+			return ::fstat(fd, &st) == 0 ? static_cast<int64_t>(st.st_size) : -1;
+		}
+#endif
+		if (!keep || !keep->get()) return -1;
+		std::lock_guard<std::mutex> l(mtx);
+		return al_fsize(keep->get());
+	}
+
 	File::File(const std::string& path, const std::string& mode)
 		: m_curr_path(path)
 	{
@@ -17,6 +173,7 @@ namespace AllegroCPP {
 		if (!al_is_system_installed()) al_init();
 
 		if (!(m_fp = make_shareable_file(al_fopen(path.c_str(), mode.c_str()), [](ALLEGRO_FILE* f) { al_fclose(f); }))) throw std::runtime_error("Could not open file!");
+		m_native_path = al_get_new_file_interface() == stdio_file_interface();
 	}
 
 
@@ -28,9 +185,11 @@ namespace AllegroCPP {
 		if (!al_is_system_installed()) al_init();
 
 		if (!(m_fp = make_shareable_file(al_fopen_interface(interfac, path.c_str(), mode.c_str()), [](ALLEGRO_FILE* f) { al_fclose(f); }))) throw std::runtime_error("Could not open file!");
+		m_native_path = interfac == stdio_file_interface();
 	}
 
 	File::File(const int fd, const std::string& mode)
+		: m_fd(fd)
 	{
 		if (fd < 0 || mode.empty()) throw std::invalid_argument("FD or mode is empty!");
 		if (!al_is_system_installed()) al_init();		
@@ -61,17 +220,17 @@ namespace AllegroCPP {
 
 	bool File::valid() const
 	{
-		return m_fp->get();
+		return m_fp && m_fp->get();
 	}
 
 	File::operator bool() const
 	{
-		return m_fp->get();
+		return m_fp && m_fp->get();
 	}
 
 	File::operator ALLEGRO_FILE* ()
 	{
-		return m_fp->get();
+		return m_fp ? m_fp->get() : nullptr;
 	}
 
 	File::operator File_shareable_ptr() const
@@ -80,15 +239,40 @@ namespace AllegroCPP {
 	}
 
 	File::File(File&& oth) noexcept
-		: m_fp(std::exchange(oth.m_fp, {})), m_curr_path(std::move(oth.m_curr_path))
+		: m_fp(std::exchange(oth.m_fp, {})), m_curr_path(std::move(oth.m_curr_path)), m_fd(std::exchange(oth.m_fd, -1)),
+		m_native_path(std::exchange(oth.m_native_path, false)), m_split_value(std::exchange(oth.m_split_value, false)), m_positional(std::exchange(oth.m_positional, {}))
 	{
 	}
 
 	void File::operator=(File&& oth) noexcept
 	{
 		m_fp.reset();
+		m_positional.reset();
 		m_curr_path = std::move(oth.m_curr_path);
 		m_fp = std::exchange(oth.m_fp, {});
+		m_fd = std::exchange(oth.m_fd, -1);
+		m_native_path = std::exchange(oth.m_native_path, false);
+		m_split_value = std::exchange(oth.m_split_value, false);
+		m_positional = std::exchange(oth.m_positional, {});
+	}
+
+	std::shared_ptr<file_positional_source> File::get_positional()
+	{
+		std::lock_guard<std::mutex> l(m_positional_mtx);
+		if (m_positional) return m_positional;
+		if (!m_fp) return {};
+
+		int fd = m_fd;
+		bool owns = false;
+#ifndef _WIN32
+		if (fd < 0 && m_native_path && !m_curr_path.empty()) {
+			// one extra descriptor for all cursors, only the first time.
+			fd = ::open(m_curr_path.c_str(), O_RDONLY | O_CLOEXEC);
+			owns = fd >= 0;
+		}
+#endif
+		m_positional = std::make_shared<file_positional_source>(m_fp, fd, owns);
+		return m_positional;
 	}
 
 	size_t File::read(void* dat, const size_t len)
@@ -113,7 +297,9 @@ namespace AllegroCPP {
 
 	bool File::seek(const int64_t offset, const int whence)
 	{
-		return m_fp ? al_fseek(m_fp->get(), offset, whence) : false;
+		if (!m_fp || !al_fseek(m_fp->get(), offset, whence)) return false;
+		m_split_value = false;
+		return true;
 	}
 
 	bool File::eof() const
@@ -123,11 +309,12 @@ namespace AllegroCPP {
 
 	bool File::has_error() const
 	{
-		return m_fp ? (al_ferror((ALLEGRO_FILE*)m_fp->get()) != 0) : false;
+		return m_fp ? (m_split_value || al_ferror((ALLEGRO_FILE*)m_fp->get()) != 0) : false;
 	}
 
 	file_error_report File::get_error() const
 	{
+		if (m_fp && m_split_value && al_ferror((ALLEGRO_FILE*)m_fp->get()) == 0) return file_error_report{ "Array read or write stopped inside a value", EIO };
 		return m_fp ? file_error_report{ al_ferrmsg((ALLEGRO_FILE*)m_fp->get()), al_ferror((ALLEGRO_FILE*)m_fp->get()) } : file_error_report{"null", 0};
 	}
 
@@ -182,7 +369,7 @@ namespace AllegroCPP {
 
 	size_t File::write16be(int16_t c)
 	{
-		return m_fp ? al_fwrite16le(m_fp->get(), c) : -1;
+		return m_fp ? al_fwrite16be(m_fp->get(), c) : -1;
 	}
 
 	int32_t File::read32le()
@@ -202,7 +389,7 @@ namespace AllegroCPP {
 
 	size_t File::write32be(int32_t c)
 	{
-		return m_fp ? al_fwrite32le(m_fp->get(), c) : -1;
+		return m_fp ? al_fwrite32be(m_fp->get(), c) : -1;
 	}
 
 	File& File::operator<<(const char* val)
@@ -237,88 +424,77 @@ namespace AllegroCPP {
 	File& File::operator<<(short val)
 	{
 		if (!m_fp) throw std::runtime_error("Can't write on null/empty file!");
-		const auto str = std::to_string(val);
-		this->write(str.data(), str.size());
+		_numeric_text::format(val, [this](const char* str, const size_t len) { this->write(str, len); });
 		return *this;
 	}
 
 	File& File::operator<<(unsigned short val)
 	{
 		if (!m_fp) throw std::runtime_error("Can't write on null/empty file!");
-		const auto str = std::to_string(val);
-		this->write(str.data(), str.size());
+		_numeric_text::format(val, [this](const char* str, const size_t len) { this->write(str, len); });
 		return *this;
 	}
 
 	File& File::operator<<(int val)
 	{
 		if (!m_fp) throw std::runtime_error("Can't write on null/empty file!");
-		const auto str = std::to_string(val);
-		this->write(str.data(), str.size());
+		_numeric_text::format(val, [this](const char* str, const size_t len) { this->write(str, len); });
 		return *this;
 	}
 
 	File& File::operator<<(unsigned int val)
 	{
 		if (!m_fp) throw std::runtime_error("Can't write on null/empty file!");
-		const auto str = std::to_string(val);
-		this->write(str.data(), str.size());
+		_numeric_text::format(val, [this](const char* str, const size_t len) { this->write(str, len); });
 		return *this;
 	}
 
 	File& File::operator<<(long val)
 	{
 		if (!m_fp) throw std::runtime_error("Can't write on null/empty file!");
-		const auto str = std::to_string(val);
-		this->write(str.data(), str.size());
+		_numeric_text::format(val, [this](const char* str, const size_t len) { this->write(str, len); });
 		return *this;
 	}
 
 	File& File::operator<<(unsigned long val)
 	{
 		if (!m_fp) throw std::runtime_error("Can't write on null/empty file!");
-		const auto str = std::to_string(val);
-		this->write(str.data(), str.size());
+		_numeric_text::format(val, [this](const char* str, const size_t len) { this->write(str, len); });
 		return *this;
 	}
 
 	File& File::operator<<(long long val)
 	{
 		if (!m_fp) throw std::runtime_error("Can't write on null/empty file!");
-		const auto str = std::to_string(val);
-		this->write(str.data(), str.size());
+		_numeric_text::format(val, [this](const char* str, const size_t len) { this->write(str, len); });
 		return *this;
 	}
 
 	File& File::operator<<(unsigned long long val)
 	{
 		if (!m_fp) throw std::runtime_error("Can't write on null/empty file!");
-		const auto str = std::to_string(val);
-		this->write(str.data(), str.size());
+		_numeric_text::format(val, [this](const char* str, const size_t len) { this->write(str, len); });
 		return *this;
 	}
 
 	File& File::operator<<(float val)
 	{
 		if (!m_fp) throw std::runtime_error("Can't write on null/empty file!");
-		const auto str = std::to_string(val);
-		this->write(str.data(), str.size());
+		_numeric_text::format(val, [this](const char* str, const size_t len) { this->write(str, len); });
 		return *this;
 	}
 
 	File& File::operator<<(double val)
 	{
 		if (!m_fp) throw std::runtime_error("Can't write on null/empty file!");
-		const auto str = std::to_string(val);
-		this->write(str.data(), str.size());
+		_numeric_text::format(val, [this](const char* str, const size_t len) { this->write(str, len); });
 		return *this;
 	}
 
 	File& File::operator<<(long double val)
 	{
 		if (!m_fp) throw std::runtime_error("Can't write on null/empty file!");
-		const auto str = std::to_string(val);
-		this->write(str.data(), str.size());
+		_numeric_text::format(val, [this](const char* str, const size_t len) { this->write(str, len); });
 		return *this;
 	}
 
@@ -388,150 +564,77 @@ namespace AllegroCPP {
 	File& File::operator>>(short& val)
 	{
 		if (!m_fp) throw std::runtime_error("Can't write on null/empty file!");
-		std::string _buf;
-		for (char _tmp; this->read(&_tmp, sizeof(_tmp)) != 0 && (std::isdigit(_tmp) || _tmp == '-') && !this->eof();) _buf += _tmp;
-		if (_buf.empty()) val = 0;
-		else {
-#ifdef _WIN32
-			if (sscanf_s(_buf.data(), "%hd", &val) == 1) return *this;
-			val = 0;
-#else
-			if (sscanf(_buf.data(), "%hd", &val) == 1) return *this;
-			val = 0;
-#endif
-		}
+		read_number(*this, val);
 		return *this;
 	}
 
 	File& File::operator>>(unsigned short& val)
 	{
 		if (!m_fp) throw std::runtime_error("Can't write on null/empty file!");
-		std::string _buf;
-		for (char _tmp; this->read(&_tmp, sizeof(_tmp)) != 0 && std::isdigit(_tmp) && !this->eof();) _buf += _tmp;
-		if (_buf.empty()) val = 0;
-		else {
-#ifdef _WIN32
-			if (sscanf_s(_buf.data(), "%hu", &val) == 1) return *this;
-			val = 0;
-#else
-			if (sscanf(_buf.data(), "%hu", &val) == 1) return *this;
-			val = 0;
-#endif
-		}
+		read_number(*this, val);
 		return *this;
 	}
 
 	File& File::operator>>(int& val)
 	{
 		if (!m_fp) throw std::runtime_error("Can't write on null/empty file!");
-		std::string _buf;
-		for (char _tmp; this->read(&_tmp, sizeof(_tmp)) != 0 && std::isdigit(_tmp) && !this->eof();) _buf += _tmp;
-		if (_buf.empty()) val = 0;
-		else {
-			val = std::stoi(_buf);
-		}
+		read_number(*this, val);
 		return *this;
 	}
 
 	File& File::operator>>(unsigned int& val)
 	{
 		if (!m_fp) throw std::runtime_error("Can't write on null/empty file!");
-		std::string _buf;
-		for (char _tmp; this->read(&_tmp, sizeof(_tmp)) != 0 && std::isdigit(_tmp) && !this->eof();) _buf += _tmp;
-		if (_buf.empty()) val = 0;
-		else {
-#ifdef _WIN32
-			if (sscanf_s(_buf.data(), "%u", &val) == 1) return *this;
-			val = 0;
-#else
-			if (sscanf(_buf.data(), "%u", &val) == 1) return *this;
-			val = 0;
-#endif
-		}
+		read_number(*this, val);
 		return *this;
 	}
 
 	File& File::operator>>(long& val)
 	{
 		if (!m_fp) throw std::runtime_error("Can't write on null/empty file!");
-		std::string _buf;
-		for (char _tmp; this->read(&_tmp, sizeof(_tmp)) != 0 && std::isdigit(_tmp) && !this->eof();) _buf += _tmp;
-		if (_buf.empty()) val = 0;
-		else {
-			val = std::stol(_buf);
-		}
+		read_number(*this, val);
 		return *this;
 	}
 
 	File& File::operator>>(unsigned long& val)
 	{
 		if (!m_fp) throw std::runtime_error("Can't write on null/empty file!");
-		std::string _buf;
-		for (char _tmp; this->read(&_tmp, sizeof(_tmp)) != 0 && std::isdigit(_tmp) && !this->eof();) _buf += _tmp;
-		if (_buf.empty()) val = 0;
-		else {
-			val = std::stoul(_buf);
-		}
+		read_number(*this, val);
 		return *this;
 	}
 
 	File& File::operator>>(long long& val)
 	{
 		if (!m_fp) throw std::runtime_error("Can't write on null/empty file!");
-		std::string _buf;
-		for (char _tmp; this->read(&_tmp, sizeof(_tmp)) != 0 && std::isdigit(_tmp) && !this->eof();) _buf += _tmp;
-		if (_buf.empty()) val = 0;
-		else {
-			val = std::stoll(_buf);
-		}
+		read_number(*this, val);
 		return *this;
 	}
 
 	File& File::operator>>(unsigned long long& val)
 	{
 		if (!m_fp) throw std::runtime_error("Can't write on null/empty file!");
-		std::string _buf;
-		for (char _tmp; this->read(&_tmp, sizeof(_tmp)) != 0 && std::isdigit(_tmp) && !this->eof();) _buf += _tmp;
-		if (_buf.empty()) val = 0;
-		else {
-			val = std::stoull(_buf);
-		}
+		read_number(*this, val);
 		return *this;
 	}
 
 	File& File::operator>>(float& val)
 	{
 		if (!m_fp) throw std::runtime_error("Can't write on null/empty file!");
-		std::string _buf;
-		for (char _tmp; this->read(&_tmp, sizeof(_tmp)) != 0 && std::isdigit(_tmp) && !this->eof();) _buf += _tmp;
-		if (_buf.empty()) val = 0;
-		else {
-			val = std::stof(_buf);
-		}
+		read_number(*this, val);
 		return *this;
 	}
 
 	File& File::operator>>(double& val)
 	{
 		if (!m_fp) throw std::runtime_error("Can't write on null/empty file!");
-		std::string _buf;
-		for (char _tmp; this->read(&_tmp, sizeof(_tmp)) != 0 && std::isdigit(_tmp) && !this->eof();) _buf += _tmp;
-		if (_buf.empty()) val = 0;
-		else {
-			val = std::stod(_buf);
-		}
+		read_number(*this, val);
 		return *this;
 	}
 
 	File& File::operator>>(long double& val)
 	{
 		if (!m_fp) throw std::runtime_error("Can't write on null/empty file!");
-		std::string _buf;
-		for (char _tmp; this->read(&_tmp, sizeof(_tmp)) != 0 && std::isdigit(_tmp) && !this->eof();) _buf += _tmp;
-		if (_buf.empty()) val = 0;
-		else {
-			val = std::stold(_buf);
-		}
+		read_number(*this, val);
 		return *this;
 	}
 
@@ -578,11 +681,190 @@ namespace AllegroCPP {
 		return File(path, "rb");
 	}
 
+	size_t File::read_at(const int64_t offset, void* buf, const size_t len)
+	{
+		auto src = get_positional();
+		return src ? src->read_at(offset, buf, len) : 0;
+	}
+
+	File_cursor File::make_cursor(const int64_t begin, const int64_t length)
+	{
+		auto src = get_positional();
+		if (!src) throw std::runtime_error("Can't read on null/empty file!");
+		return File_cursor(src, begin, length);
+	}
+
+	File_lines File::lines(const size_t chunk)
+	{
+		return File_lines(*this, chunk);
+	}
+
 	void File::close()
 	{
+		m_positional.reset();
 		m_fp.reset();
 	}
 
+	File_cursor::File_cursor(std::shared_ptr<file_positional_source> src, const int64_t begin, const int64_t length)
+		: m_src(src), m_begin(begin < 0 ? 0 : begin)
+	{
+		if (!m_src) throw std::invalid_argument("Source is null!");
+		if (length >= 0) m_length = length;
+		else {
+			const int64_t total = m_src->size();
+			m_length = total > m_begin ? total - m_begin : 0;
+		}
+	}
+
+	bool File_cursor::empty() const
+	{
+		return !m_src;
+	}
+
+	bool File_cursor::valid() const
+	{
+		return m_src != nullptr;
+	}
+
+	File_cursor::operator bool() const
+	{
+		return m_src != nullptr;
+	}
+
+	size_t File_cursor::read(void* buf, const size_t len)
+	{
+		const size_t got = read_at(m_pos, buf, len);
+		m_pos += static_cast<int64_t>(got);
+		return got;
+	}
+
+	size_t File_cursor::read_at(const int64_t offset, void* buf, const size_t len)
+	{
+		if (!m_src || offset < 0 || offset >= m_length) return 0;
+		const size_t max = static_cast<size_t>(m_length - offset);
+		return m_src->read_at(m_begin + offset, buf, len < max ? len : max);
+	}
+
+	bool File_cursor::seek(const int64_t offset, const int whence)
+	{
+		int64_t npos = 0;
+		switch (whence) {
+		case ALLEGRO_SEEK_SET:
+			npos = offset;
+			break;
+		case ALLEGRO_SEEK_CUR:
+			npos = m_pos + offset;
+			break;
+		case ALLEGRO_SEEK_END:
+			npos = m_length + offset;
+			break;
+		default:
+			return false;
+		}
+		if (npos < 0 || npos > m_length) return false;
+		m_pos = npos;
+		return true;
+	}
+
+	int64_t File_cursor::tell() const
+	{
+		return m_src ? m_pos : -1;
+	}
+
+	int64_t File_cursor::size() const
+	{
+		return m_src ? m_length : -1;
+	}
+
+	bool File_cursor::eof() const
+	{
+		return !m_src || m_pos >= m_length;
+	}
+
+	File_cursor File_cursor::slice(const int64_t begin, const int64_t length) const
+	{
+		if (!m_src) throw std::runtime_error("Cursor is empty!");
+		const int64_t b = begin < 0 ? 0 : (begin > m_length ? m_length : begin);
+		const int64_t l = (length < 0 || b + length > m_length) ? m_length - b : length;
+		return File_cursor(m_src, m_begin + b, l);
+	}
+
+	File_lines::iterator::iterator(File_lines* src)
+		: m_src(src)
+	{
+		if (m_src && !m_src->next(m_line)) m_src = nullptr;
+	}
+
+	File_lines::iterator::reference File_lines::iterator::operator*() const
+	{
+		return m_line;
+	}
+
+	File_lines::iterator::pointer File_lines::iterator::operator->() const
+	{
+		return &m_line;
+	}
+
+	File_lines::iterator& File_lines::iterator::operator++()
+	{
+		if (m_src && !m_src->next(m_line)) m_src = nullptr;
+		return *this;
+	}
+
+	void File_lines::iterator::operator++(int)
+	{
+		++(*this);
+	}
+
+	bool File_lines::iterator::operator==(const iterator& o) const
+	{
+		return m_src == o.m_src;
+	}
+
+	File_lines::File_lines(File& f, const size_t chunk)
+		: m_file(&f), m_buf(chunk < 64 ? 64 : chunk)
+	{
+	}
+
+	bool File_lines::next(std::string_view& line)
+	{
+		while (true) {
+			const char* nl = m_beg < m_end ? static_cast<const char*>(memchr(m_buf.data() + m_beg, '\n', m_end - m_beg)) : nullptr;
+
+			if (nl || (m_eof && m_beg < m_end)) {
+				const size_t stop = nl ? static_cast<size_t>(nl - m_buf.data()) : m_end;
+				size_t len = stop - m_beg;
+				if (len > 0 && m_buf[m_beg + len - 1] == '\r') --len;
+				line = std::string_view(m_buf.data() + m_beg, len);
+				m_beg = nl ? stop + 1 : m_end;
+				return true;
+			}
+			if (m_eof) return false;
+
+			// keep the partial line at the front, grow only if it fills the whole buffer
+			if (m_beg > 0) {
+				if (m_end > m_beg) memmove(m_buf.data(), m_buf.data() + m_beg, m_end - m_beg);
+				m_end -= m_beg;
+				m_beg = 0;
+			}
+			if (m_end == m_buf.size()) m_buf.resize(m_buf.size() * 2);
+
+			const size_t got = m_file->read(m_buf.data() + m_end, m_buf.size() - m_end);
+			if (got == 0 || got == static_cast<size_t>(-1)) m_eof = true;
+			else m_end += got;
+		}
+	}
+
+	File_lines::iterator File_lines::begin()
+	{
+		return iterator(this);
+	}
+
+	File_lines::iterator File_lines::end()
+	{
+		return iterator();
+	}
+
 	//ALLEGRO_FILE* File::drop()
 	//{
 	//	ALLEGRO_FILE* nf = m_fp;
@@ -590,11 +872,42 @@ namespace AllegroCPP {
 	//	return m_fp.;
 	//}
 
+#ifdef __linux__
+	// Temp file with no directory entry at all. Nothing to remove later, nothing left behind if the process dies.
+	static int open_anonymous_tmp(const std::string& name)
+	{
+		int fd = -1;
+#ifdef O_TMPFILE
+		if (ALLEGRO_PATH* dir = al_get_standard_path(ALLEGRO_TEMP_PATH); dir) {
+			fd = ::open(al_path_cstr(dir, ALLEGRO_NATIVE_PATH_SEP), O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+			al_destroy_path(dir);
+		}
+#endif
+#ifdef MFD_CLOEXEC
+		if (fd < 0) fd = ::memfd_create(name.c_str(), MFD_CLOEXEC); // tmpfs not available / not supported by the fs
+#endif
+		return fd;
+	}
+#endif
+
 	File_tmp::File_tmp(const std::string& tmppath, const std::string& mode)
 	{
 		if (tmppath.empty()) throw std::invalid_argument("File format is empty!");
 		if (!al_is_system_installed()) al_init();
 
+#ifdef __linux__
+		if (const int fd = open_anonymous_tmp(tmppath); fd >= 0) {
+			if (ALLEGRO_FILE* fpp = al_fopen_fd(fd, mode.c_str()); fpp) {
+				// reopening this path gives an independent offset on the same inode, so clone_for_read() keeps working.
+				m_curr_path = "/proc/self/fd/" + std::to_string(fd);
+				m_fd = fd;
+				m_fp = make_shareable_file(fpp, [](ALLEGRO_FILE* f) { al_fclose(f); }); // closes fd, kernel drops the file
+				return;
+			}
+			::close(fd);
+		}
+#endif
+
 		ALLEGRO_PATH* tmpptr = al_create_path(nullptr);
 		auto* fpp = al_make_temp_file(tmppath.c_str(), &tmpptr);
 		if (!fpp) throw std::runtime_error("Could not open temp file!");
@@ -603,9 +916,9 @@ namespace AllegroCPP {
 		al_fclose(fpp);
 
 		if (!(m_fp = make_shareable_file(al_fopen(m_curr_path.c_str(), mode.c_str()), [path = m_curr_path](ALLEGRO_FILE* f) { al_fclose(f); if (!path.empty()) { std::remove(path.c_str()); } }))) {
-			al_destroy_path(tmpptr);
 			throw std::runtime_error("Could not open temp file!");
 		}
+		m_native_path = al_get_new_file_interface() == stdio_file_interface();
 
 		//m_curr_path = al_path_cstr(tmpptr, ALLEGRO_NATIVE_PATH_SEP);
 		//al_destroy_path(tmpptr);
@@ -632,12 +945,12 @@ namespace AllegroCPP {
 		if (!al_is_system_installed()) al_init();
 
 		if (!(m_mem = (char*)al_malloc(memlen))) throw std::runtime_error("Can't alloc!");
-		m_fp = make_shareable_file(al_open_memfile(m_mem, memlen, "wb+"), [this](ALLEGRO_FILE* f) { al_fclose(f);  al_free(m_mem); });
+		m_fp = make_shareable_file(al_open_memfile(m_mem, memlen, "wb+"), [mem = m_mem](ALLEGRO_FILE* f) { al_fclose(f); al_free(mem); }); // cursors may outlive this object
 	}
 
 	File_memory::~File_memory()
 	{
-		this->File::~File(); // close file FIRST
+		m_fp.reset(); // memory is freed with the last reference to the file
 	}
 
 	File_memory::File_memory(File_memory&& oth) noexcept
@@ -648,8 +961,7 @@ namespace AllegroCPP {
 
 	void File_memory::operator=(File_memory&& oth) noexcept
 	{
-		this->File::operator=(std::move(oth));
-		if (m_mem) al_free(m_mem);
+		this->File::operator=(std::move(oth)); // old memory is freed by the old file deleter
 		m_mem = std::exchange(oth.m_mem, nullptr);
 	}
 
@@ -686,6 +998,71 @@ namespace AllegroCPP {
 		{
 		}
 
+		void token_bucket::configure(const double r, const double b)
+		{
+			std::lock_guard<std::mutex> l(mtx);
+			rate = r > 0.0 ? r : 0.0;
+			burst = b > 0.0 ? b : (rate / 10.0 < 1500.0 ? 1500.0 : rate / 10.0);
+			tokens = burst;
+			last = al_get_time();
+			limited = rate > 0.0;
+		}
+
+		void token_bucket::refill()
+		{
+			const double now = al_get_time();
+			tokens += (now - last) * rate;
+			if (tokens > burst) tokens = burst;
+			last = now;
+		}
+
+		size_t token_bucket::allowance(const size_t want, const bool whole)
+		{
+			std::lock_guard<std::mutex> l(mtx);
+			if (rate <= 0.0) return want;
+
+			refill();
+			if (whole) return tokens >= (static_cast<double>(want) < burst ? static_cast<double>(want) : burst) ? want : 0;
+			if (tokens <= 0.0) return 0;
+			return static_cast<double>(want) <= tokens ? want : static_cast<size_t>(tokens);
+		}
+
+		double token_bucket::wait_for(const size_t need)
+		{
+			std::lock_guard<std::mutex> l(mtx);
+			if (rate <= 0.0) return 0.0;
+
+			refill();
+			const double target = static_cast<double>(need) < burst ? static_cast<double>(need) : burst;
+			return tokens >= target ? 0.0 : (target - tokens) / rate;
+		}
+
+		void token_bucket::consume(const size_t sent)
+		{
+			std::lock_guard<std::mutex> l(mtx);
+			bytes_sent += sent;
+			if (rate > 0.0) tokens -= static_cast<double>(sent);
+		}
+
+		void token_bucket::deferred(const size_t held)
+		{
+			std::lock_guard<std::mutex> l(mtx);
+			bytes_deferred += held;
+			++throttled_writes;
+		}
+
+		socket_rate_stats token_bucket::stats()
+		{
+			std::lock_guard<std::mutex> l(mtx);
+			socket_rate_stats st;
+			st.bytes_sent = bytes_sent;
+			st.bytes_deferred = bytes_deferred;
+			st.throttled_writes = throttled_writes;
+			st.rate = rate;
+			st.available = rate > 0.0 ? tokens : 0.0;
+			return st;
+		}
+
 		bool socket_user_data::has_host() const
 		{
 			for (const auto& i : m_socks) { if (i.type == socket_type::TCP_HOST || i.type == socket_type::UDP_HOST) return true; }
@@ -712,6 +1089,7 @@ namespace AllegroCPP {
 			if (!sud) { throw std::bad_alloc(); }
 
 			sud->badflag = 0;
+			if (theconf.host) sud->m_host_bucket = std::make_shared<token_bucket>();
 			sud->original_addr = theconf.addr;
 			sud->original_port = theconf.port;
 			socket_type type = theconf.host ? (theconf.protocol == SOCK_STREAM ? socket_type::TCP_HOST : socket_type::UDP_HOST) : (theconf.protocol == SOCK_STREAM ? socket_type::TCP_CLIENT : socket_type::UDP_CLIENT);
@@ -807,6 +1185,14 @@ namespace AllegroCPP {
 			return true;
 		}
 
+		// Accepted client shares the host total and gets the per client limit.
+		static void inherit_limits(socket_user_data& host, socket_user_data& client)
+		{
+			client.m_host_bucket = host.m_host_bucket;
+			const double rate = host.m_client_rate;
+			if (rate > 0.0) client.m_bucket->configure(rate, host.m_client_burst);
+		}
+
 		size_t sock_read(ALLEGRO_FILE* fp, void* ptr, size_t size)
 		{
 			socket_user_data* sud = (socket_user_data*)al_get_file_userdata(fp);
@@ -832,6 +1218,7 @@ namespace AllegroCPP {
 
 					oths.ptr->m_socks.push_back({ accep, trigginfo, socket_type::TCP_CLIENT, ittrg->src_ip });
 					oths.ptr->badflag = 0;
+					inherit_limits(*sud, *oths.ptr);
 					res = sizeof(socket_user_data);
 				}
 					break;
@@ -850,6 +1237,7 @@ namespace AllegroCPP {
 					else { // res > 0 or not SocketBUFFERSMALL (expected if package is > 1 because hackz)
 						oths.ptr->m_socks.push_back({ ittrg->sock, trigginfo, socket_type::UDP_HOST_CLIENT, ittrg->src_ip });
 						oths.ptr->badflag = 0;
+						inherit_limits(*sud, *oths.ptr);
 						res = sizeof(socket_user_data);
 					}
 					break;
@@ -891,27 +1279,107 @@ namespace AllegroCPP {
 		{
 			socket_user_data* sud = (socket_user_data*)al_get_file_userdata(fp);
 			if (!sud) return 0;
+			if (sud->m_host_bucket && !sud->has_host()) return sock_write_queued(sud, ptr, size); // accepted by a host
+			return sock_send(sud, ptr, size, true);
+		}
+
+		bool sock_drain(socket_user_data* sud)
+		{
+			while (!sud->m_out.empty()) {
+				const auto& front = sud->m_out.front();
+				const size_t sent = sock_send(sud, front.data() + sud->m_out_sent, front.size() - sud->m_out_sent, false, false); // counted as held when queued
+				sud->m_out_sent += sent;
+				sud->m_out_bytes -= sent;
+				if (sud->badflag & static_cast<int32_t>(socket_errors::SEND_FAILED)) { // broken, nothing queued will go
+					sud->m_out.clear();
+					sud->m_out_sent = 0;
+					sud->m_out_bytes = 0;
+					return false;
+				}
+				if (sud->m_out_sent < front.size()) return false;
+				sud->m_out.pop_front();
+				sud->m_out_sent = 0;
+			}
+			return true;
+		}
+
+		size_t sock_write_queued(socket_user_data* sud, const void* ptr, const size_t size)
+		{
+			std::lock_guard<std::mutex> l(sud->m_out_mtx);
+			const bool was_empty = sock_drain(sud);
+			const size_t sent = was_empty ? sock_send(sud, ptr, size, false) : 0;
+			if (sent == size || (sud->badflag & static_cast<int32_t>(socket_errors::SEND_FAILED))) return sent;
+
+			const bool datagram = sud->m_socks[0].type != socket_type::TCP_CLIENT;
+			const size_t left = size - sent;
+			const size_t used = sud->m_out_bytes;
+			const size_t room = used < max_out_queue ? max_out_queue - used : 0;
+			const size_t take = datagram ? (left <= room ? left : 0) : (std::min)(left, room);
+			if (take == 0) return sent; // queue full: a short write, like a blocked send
+
+			sud->m_out.emplace_back((const uint8_t*)ptr + sent, (const uint8_t*)ptr + sent + take);
+			sud->m_out_bytes += take;
+			if (!was_empty) { // sock_send didn't see this one
+				if (sud->m_bucket->limited.load(std::memory_order_relaxed)) sud->m_bucket->deferred(take);
+				if (sud->m_host_bucket->limited.load(std::memory_order_relaxed)) sud->m_host_bucket->deferred(take);
+			}
+			return sent + take;
+		}
+
+		size_t sock_send(socket_user_data* sud, const void* ptr, const size_t size, const bool wait, const bool count_held)
+		{
 			if (sud->m_socks.empty() || sud->has_host()) { sud->badflag |= static_cast<int32_t>(socket_errors::MODE_WAS_INVALID); return 0; }
-			int res = 0;
 
 			auto& curr = sud->m_socks[0];
+			const bool datagram = curr.type != socket_type::TCP_CLIENT;
+
+			token_bucket* limits[2]{};
+			size_t nlimits = 0;
+			if (sud->m_bucket->limited.load(std::memory_order_relaxed)) limits[nlimits++] = sud->m_bucket.get();
+			if (sud->m_host_bucket && sud->m_host_bucket->limited.load(std::memory_order_relaxed)) limits[nlimits++] = sud->m_host_bucket.get();
+
+			size_t done = 0;
+			bool held = false;
+			while (done < size) {
+				const size_t left = size - done;
+				size_t allowed = left;
+				for (size_t i = 0; i < nlimits && allowed > 0; ++i) allowed = limits[i]->allowance(allowed, datagram); // a datagram goes whole or not at all
+
+				if (allowed < left && !held) {
+					held = true;
+					for (size_t i = 0; i < nlimits && count_held; ++i) limits[i]->deferred(left - allowed);
+				}
+				if (allowed == 0) {
+					if (!wait) break;
+					double secs = 0.0;
+					for (size_t i = 0; i < nlimits; ++i) secs = (std::max)(secs, limits[i]->wait_for(datagram ? left : (std::min)(left, static_cast<size_t>(1500))));
+					al_rest((std::min)(secs, 0.05)); // short naps, so a limit lifted meanwhile is seen soon
+					continue;
+				}
 
-			switch (curr.type) {
-			case socket_type::TCP_CLIENT:
-			case socket_type::UDP_CLIENT:
-				res = ::send(curr.sock, (char*)ptr, static_cast<int>(size), 0);
-				if (res <= 0) { sud->badflag |= static_cast<int32_t>(socket_errors::SEND_FAILED); }
-				break;
-			case socket_type::UDP_HOST_CLIENT:
-				res = ::sendto(curr.sock, (char*)ptr, static_cast<int>(size), 0, (sockaddr*)&curr.info, sizeof(curr.info));
-				if (res <= 0) { sud->badflag |= static_cast<int32_t>(socket_errors::SEND_FAILED); }
-				break;
-			default:
-				sud->badflag |= static_cast<int32_t>(socket_errors::MODE_WAS_INVALID);
-				return 0;
-			}
+				int res = 0;
+				switch (curr.type) {
+				case socket_type::TCP_CLIENT:
+				case socket_type::UDP_CLIENT:
+					res = ::send(curr.sock, (char*)ptr + done, static_cast<int>(allowed), 0);
+					break;
+				case socket_type::UDP_HOST_CLIENT:
+					res = ::sendto(curr.sock, (char*)ptr + done, static_cast<int>(allowed), 0, (sockaddr*)&curr.info, sizeof(curr.info));
+					break;
+				default:
+					sud->badflag |= static_cast<int32_t>(socket_errors::MODE_WAS_INVALID);
+					return done;
+				}
+				if (res <= 0) {
+					sud->badflag |= static_cast<int32_t>(socket_errors::SEND_FAILED);
+					break;
+				}
 
-			return res > 0 ? static_cast<size_t>(res) : 0;
+				for (size_t i = 0; i < nlimits; ++i) limits[i]->consume(static_cast<size_t>(res));
+				done += static_cast<size_t>(res);
+				if (datagram) break;
+			}
+			return done;
 		}
 
 		bool sock_flush(ALLEGRO_FILE* fp)
@@ -1016,19 +1484,19 @@ namespace AllegroCPP {
 			return SocketInvalid;
 		}
 
-		void setsocktimeout_auto(SocketType sock, unsigned long ms)
+		void setsocktimeout_auto(SocketType sock, unsigned long ms, const int option)
 		{
 			if (!SocketGood(sock)) return;
 			// LINUX
 #ifdef _WIN32
 			// WINDOWS
 			DWORD timeout = static_cast<DWORD>(ms);
-			::setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+			::setsockopt(sock, SOL_SOCKET, option, (const char*)&timeout, sizeof(timeout));
 #else
 			struct timeval tv;
-			tv.tv_sec = ms / 1000000;
-			tv.tv_usec = ms % 1000000;
-			::setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (const char*)&tv, sizeof tv);
+			tv.tv_sec = ms / 1000;
+			tv.tv_usec = (ms % 1000) * 1000;
+			::setsockopt(sock, SOL_SOCKET, option, (const char*)&tv, sizeof tv);
 #endif
 		}
 
@@ -1084,7 +1552,7 @@ namespace AllegroCPP {
 
 		bool _FileSocket::valid() const
 		{
-			return !has_error();
+			return this->File::valid() && !has_error();
 		}
 
 		const std::string& _FileSocket::get_filepath() const
@@ -1110,7 +1578,7 @@ namespace AllegroCPP {
 
 		_FileSocket::operator bool() const
 		{
-			return !has_error();
+			return valid();
 		}
 		
 		std::string _FileSocket::gets(const size_t max)
@@ -1263,11 +1731,90 @@ namespace AllegroCPP {
 		if (!sod) return false;
 
 		for (auto& i : sod->m_socks) {
-			_socketmap::setsocktimeout_auto(i.sock, 1000);
+			_socketmap::setsocktimeout_auto(i.sock, ms);
 		}
 		return sod->m_socks.size() > 0;
 	}
 
+	bool File_client::set_timeout_write(const unsigned long ms)
+	{
+		if (!m_fp) return false;
+		_socketmap::socket_user_data* sod = (_socketmap::socket_user_data*)al_get_file_userdata(m_fp->get());
+		if (!sod) return false;
+
+		for (auto& i : sod->m_socks) {
+			_socketmap::setsocktimeout_auto(i.sock, ms, SO_SNDTIMEO);
+		}
+		return sod->m_socks.size() > 0;
+	}
+
+	bool File_client::wait_for_data(const long timeout_ms)
+	{
+		if (!m_fp) return false;
+		_socketmap::socket_user_data* sod = (_socketmap::socket_user_data*)al_get_file_userdata(m_fp->get());
+		if (!sod || sod->m_socks.empty()) return false;
+
+		SocketPollFD pfd{};
+		pfd.fd = sod->m_socks[0].sock;
+		pfd.events = SocketPOLLIN;
+		return pollSocket(&pfd, 1, timeout_ms) > 0 && pfd.revents != 0; // data, hang up or error: read() won't block
+	}
+
+	bool File_client::set_rate_limit(const double bytes_per_second, const double burst_bytes)
+	{
+		if (!m_fp) return false;
+		_socketmap::socket_user_data* sod = (_socketmap::socket_user_data*)al_get_file_userdata(m_fp->get());
+		if (!sod) return false;
+
+		sod->m_bucket->configure(bytes_per_second, burst_bytes);
+		return true;
+	}
+
+	size_t File_client::write_some(const void* ptr, const size_t size)
+	{
+		if (!m_fp) return 0;
+		_socketmap::socket_user_data* sod = (_socketmap::socket_user_data*)al_get_file_userdata(m_fp->get());
+		if (!sod) return 0;
+		if (!sod->m_host_bucket || sod->has_host()) return _socketmap::sock_send(sod, ptr, size, false);
+
+		std::lock_guard<std::mutex> l(sod->m_out_mtx);
+		if (!_socketmap::sock_drain(sod)) return 0; // queued bytes go first
+		return _socketmap::sock_send(sod, ptr, size, false);
+	}
+
+	size_t File_client::queued() const
+	{
+		if (!m_fp) return 0;
+		_socketmap::socket_user_data* sod = (_socketmap::socket_user_data*)al_get_file_userdata(m_fp->get());
+		return sod ? sod->m_out_bytes.load() : 0;
+	}
+
+	size_t File_client::send_queued()
+	{
+		if (!m_fp) return 0;
+		_socketmap::socket_user_data* sod = (_socketmap::socket_user_data*)al_get_file_userdata(m_fp->get());
+		if (!sod || sod->m_out_bytes == 0) return 0;
+
+		std::lock_guard<std::mutex> l(sod->m_out_mtx);
+		const size_t before = sod->m_out_bytes;
+		_socketmap::sock_drain(sod);
+		return before - sod->m_out_bytes;
+	}
+
+	socket_rate_stats File_client::get_rate_stats() const
+	{
+		if (!m_fp) return {};
+		_socketmap::socket_user_data* sod = (_socketmap::socket_user_data*)al_get_file_userdata(m_fp->get());
+		return sod ? sod->m_bucket->stats() : socket_rate_stats{};
+	}
+
+	socket_rate_stats File_client::get_host_rate_stats() const
+	{
+		if (!m_fp) return {};
+		_socketmap::socket_user_data* sod = (_socketmap::socket_user_data*)al_get_file_userdata(m_fp->get());
+		return (sod && sod->m_host_bucket) ? sod->m_host_bucket->stats() : socket_rate_stats{};
+	}
+
 	File_host::File_host(const uint16_t port, const int protocol, const int family)
 	{
 		if (family == PF_UNSPEC) {
@@ -1358,6 +1905,32 @@ namespace AllegroCPP {
 		return File_client(nsud.ptr);
 	}
 
+	bool File_host::set_rate_limit(const double bytes_per_second, const double burst_bytes)
+	{
+		if (!m_fp) return false;
+		_socketmap::socket_user_data* sod = (_socketmap::socket_user_data*)al_get_file_userdata(m_fp->get());
+		if (!sod || !sod->m_host_bucket) return false;
+		sod->m_host_bucket->configure(bytes_per_second, burst_bytes);
+		return true;
+	}
+
+	bool File_host::set_client_rate_limit(const double bytes_per_second, const double burst_bytes)
+	{
+		if (!m_fp) return false;
+		_socketmap::socket_user_data* sod = (_socketmap::socket_user_data*)al_get_file_userdata(m_fp->get());
+		if (!sod) return false;
+		sod->m_client_rate = bytes_per_second > 0.0 ? bytes_per_second : 0.0;
+		sod->m_client_burst = burst_bytes;
+		return true;
+	}
+
+	socket_rate_stats File_host::get_rate_stats() const
+	{
+		if (!m_fp) return {};
+		_socketmap::socket_user_data* sod = (_socketmap::socket_user_data*)al_get_file_userdata(m_fp->get());
+		return (sod && sod->m_host_bucket) ? sod->m_host_bucket->stats() : socket_rate_stats{};
+	}
+
 #ifdef _WIN32
 	File_memory file_load_resource_name_in_memory(int defined_name, const char* type_name)
 	{
@@ -0,0 +1,497 @@
+#include "file_compressed.h"
+#include "hash.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <utility>
+
+namespace AllegroCPP {
+
+	namespace _compressmap {
+
+		constexpr char stream_magic[4] = { 'A', 'C', 'Z', '1' };
+		constexpr uint32_t stored_flag = 0x80000000u;
+		constexpr size_t max_block = static_cast<size_t>(1) << 24;
+		constexpr size_t min_match = 4;
+		constexpr int hash_bits = 12;
+
+		static ALLEGRO_FILE_INTERFACE compressed_interface =
+		{
+		   comp_open,
+		   comp_close,
+		   comp_read,
+		   comp_write,
+		   comp_flush,
+		   comp_tell,
+		   comp_seek,
+		   comp_eof,
+		   comp_error,
+		   comp_errmsg,
+		   comp_clearerr,
+		   comp_ungetc,
+		   comp_size
+		};
+
+		static inline uint32_t load32(const uint8_t* p)
+		{
+			uint32_t v;
+			memcpy(&v, p, sizeof(v));
+			return v;
+		}
+
+		static inline void put32le(uint8_t* p, const uint32_t v)
+		{
+			p[0] = static_cast<uint8_t>(v);
+			p[1] = static_cast<uint8_t>(v >> 8);
+			p[2] = static_cast<uint8_t>(v >> 16);
+			p[3] = static_cast<uint8_t>(v >> 24);
+		}
+
+		static inline uint32_t get32le(const uint8_t* p)
+		{
+			return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) | (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+		}
+
+		size_t lz_bound(const size_t len)
+		{
+			return len + len / 255 + 16;
+		}
+
+		size_t lz_compress(const void* srcv, const size_t len, void* dstv, const size_t dst_cap)
+		{
+			const uint8_t* src = static_cast<const uint8_t*>(srcv);
+			uint8_t* dst = static_cast<uint8_t*>(dstv);
+			size_t op = 0;
+
+			// token, literal run, offset, match run. False if dst is too small.
+			const auto emit = [&](const size_t lit_beg, const size_t lit_len, const size_t offset, const size_t match_len) {
+				const size_t ml = match_len ? match_len - min_match : 0;
+				if (op + 1 + lit_len / 255 + 1 + lit_len + 2 + ml / 255 + 1 > dst_cap) return false;
+
+				uint8_t& token = dst[op++];
+				token = static_cast<uint8_t>((lit_len >= 15 ? 15 : lit_len) << 4);
+				if (lit_len >= 15) {
+					size_t l = lit_len - 15;
+					for (; l >= 255; l -= 255) dst[op++] = 255;
+					dst[op++] = static_cast<uint8_t>(l);
+				}
+				memcpy(dst + op, src + lit_beg, lit_len);
+				op += lit_len;
+
+				if (match_len == 0) return true; // last sequence
+
+				dst[op++] = static_cast<uint8_t>(offset);
+				dst[op++] = static_cast<uint8_t>(offset >> 8);
+				token |= static_cast<uint8_t>(ml >= 15 ? 15 : ml);
+				if (ml >= 15) {
+					size_t l = ml - 15;
+					for (; l >= 255; l -= 255) dst[op++] = 255;
+					dst[op++] = static_cast<uint8_t>(l);
+				}
+				return true;
+			};
+
+			uint32_t table[1 << hash_bits] = {}; // last position seen for each hash, verified before use
+			size_t anchor = 0;
+			size_t ip = 0;
+
+			if (len > min_match) {
+				const size_t limit = len - min_match;
+				while (ip <= limit) {
+					const uint32_t seq = load32(src + ip);
+					const uint32_t h = (seq * 2654435761u) >> (32 - hash_bits);
+					const size_t ref = table[h];
+					table[h] = static_cast<uint32_t>(ip);
+
+					if (ref < ip && ip - ref <= 0xFFFF && load32(src + ref) == seq) {
+						size_t ml = min_match;
+						while (ip + ml < len && src[ref + ml] == src[ip + ml]) ++ml;
+						if (!emit(anchor, ip - anchor, ip - ref, ml)) return 0;
+						ip += ml;
+						anchor = ip;
+					}
+					else ip += 1 + ((ip - anchor) >> 6); // skip faster on data that does not compress
+				}
+			}
+
+			if (!emit(anchor, len - anchor, 0, 0)) return 0;
+			return op;
+		}
+
+		bool lz_decompress(const void* srcv, const size_t len, void* dstv, const size_t raw_len)
+		{
+			const uint8_t* src = static_cast<const uint8_t*>(srcv);
+			uint8_t* dst = static_cast<uint8_t*>(dstv);
+			size_t ip = 0, op = 0;
+
+			while (ip < len) {
+				const uint8_t token = src[ip++];
+
+				size_t lit = token >> 4;
+				if (lit == 15) {
+					for (uint8_t b = 255; b == 255;) {
+						if (ip >= len) return false;
+						b = src[ip++];
+						lit += b;
+					}
+				}
+				if (lit > len - ip || lit > raw_len - op) return false;
+				memcpy(dst + op, src + ip, lit);
+				ip += lit;
+				op += lit;
+
+				if (ip == len) break; // last sequence has no match
+
+				if (len - ip < 2) return false;
+				const size_t offset = static_cast<size_t>(src[ip]) | (static_cast<size_t>(src[ip + 1]) << 8);
+				ip += 2;
+				if (offset == 0 || offset > op) return false;
+
+				size_t ml = (token & 15) + min_match;
+				if ((token & 15) == 15) {
+					for (uint8_t b = 255; b == 255;) {
+						if (ip >= len) return false;
+						b = src[ip++];
+						ml += b;
+					}
+				}
+				if (ml > raw_len - op) return false;
+
+				const uint8_t* from = dst + op - offset;
+				if (offset >= ml) memcpy(dst + op, from, ml);
+				else for (size_t p = 0; p < ml; ++p) dst[op + p] = from[p]; // overlapping run
+				op += ml;
+			}
+			return op == raw_len;
+		}
+
+		static bool read_exact(ALLEGRO_FILE* fp, void* buf, const size_t len)
+		{
+			size_t done = 0;
+			while (done < len) {
+				const size_t got = al_fread(fp, static_cast<char*>(buf) + done, len - done);
+				if (got == 0 || got == static_cast<size_t>(-1)) return false;
+				done += got;
+			}
+			return true;
+		}
+
+		static std::vector<uint8_t> decode_block(const std::vector<uint8_t>& packed, const uint32_t raw_len, const bool stored, const uint32_t crc)
+		{
+			std::vector<uint8_t> raw;
+			if (stored) {
+				if (packed.size() != raw_len) throw std::runtime_error("Stored block has wrong size!");
+				raw = packed;
+			}
+			else {
+				raw.resize(raw_len);
+				if (!lz_decompress(packed.data(), packed.size(), raw.data(), raw.size())) throw std::runtime_error("Block failed to decompress!");
+			}
+			if (crc32c(raw.data(), raw.size()) != crc) throw std::runtime_error("Block checksum mismatch!");
+			return raw;
+		}
+
+		static void set_error(compressed_user_data* cud, const std::string& msg)
+		{
+			cud->error = 1;
+			cud->errmsg = msg;
+		}
+
+		static bool write_block(compressed_user_data* cud, const uint8_t* data, const size_t len)
+		{
+			ALLEGRO_FILE* base = cud->base->get();
+
+			if (!cud->header_done) {
+				if (al_fwrite(base, stream_magic, sizeof(stream_magic)) != sizeof(stream_magic)) { set_error(cud, "Could not write to base file"); return false; }
+				cud->header_done = true;
+			}
+			if (len == 0) return true;
+
+			cud->packed.resize(12 + lz_bound(len));
+			size_t packed_len = lz_compress(data, len, cud->packed.data() + 12, cud->packed.size() - 12);
+			uint32_t flag = 0;
+			if (packed_len == 0 || packed_len >= len) { // not worth it
+				memcpy(cud->packed.data() + 12, data, len);
+				packed_len = len;
+				flag = stored_flag;
+			}
+
+			put32le(cud->packed.data(), static_cast<uint32_t>(len));
+			put32le(cud->packed.data() + 4, static_cast<uint32_t>(packed_len) | flag);
+			put32le(cud->packed.data() + 8, crc32c(data, len));
+
+			if (al_fwrite(base, cud->packed.data(), 12 + packed_len) != 12 + packed_len) { set_error(cud, "Could not write to base file"); return false; }
+			return true;
+		}
+
+		// Read block headers and start decoding until read_ahead blocks are in flight.
+		static void fill(compressed_user_data* cud)
+		{
+			ALLEGRO_FILE* base = cud->base->get();
+
+			while (!cud->base_done && cud->decoding.size() < cud->read_ahead) {
+				uint8_t head[12];
+				if (!read_exact(base, head, sizeof(head))) { cud->base_done = true; break; } // no end block, stream cut short
+
+				const uint32_t raw_len = get32le(head);
+				const uint32_t packed_word = get32le(head + 4);
+				const uint32_t crc = get32le(head + 8);
+				const bool stored = (packed_word & stored_flag) != 0;
+				const uint32_t packed_len = packed_word & ~stored_flag;
+
+				if (raw_len == 0 && packed_word == 0) { cud->base_done = true; break; } // end of stream
+				if (raw_len > max_block || packed_len > lz_bound(max_block)) { set_error(cud, "Block header is corrupt"); cud->base_done = true; break; }
+
+				std::vector<uint8_t> packed(packed_len);
+				if (!read_exact(base, packed.data(), packed.size())) { set_error(cud, "Stream ended in the middle of a block"); cud->base_done = true; break; }
+
+				if (cud->read_ahead > 1 && cud->pool && !cud->pool->is_worker_thread()) { // from a task of that pool, waiting on it could deadlock
+					cud->decoding.push_back(cud->pool->submit([packed = std::move(packed), raw_len, stored, crc] { return decode_block(packed, raw_len, stored, crc); }));
+				}
+				else {
+					std::promise<std::vector<uint8_t>> done;
+					try { done.set_value(decode_block(packed, raw_len, stored, crc)); }
+					catch (...) { done.set_exception(std::current_exception()); }
+					cud->decoding.push_back(done.get_future());
+				}
+			}
+		}
+
+		// Move to the next decoded block. False at the end or on error.
+		static bool next_block(compressed_user_data* cud)
+		{
+			if (cud->decoding.empty()) fill(cud);
+			if (cud->decoding.empty()) return false;
+
+			try {
+				cud->current = cud->decoding.front().get();
+			}
+			catch (const std::exception& e) {
+				set_error(cud, e.what());
+				cud->decoding.clear();
+				cud->base_done = true;
+				return false;
+			}
+			cud->decoding.pop_front();
+			cud->current_pos = 0;
+
+			if (cud->read_ahead > 1) fill(cud); // keep the workers busy while this one is consumed
+			return true;
+		}
+
+		void* comp_open(const char* nconf, const char* plen)
+		{
+			const compressed_config* __conf = (compressed_config*)nconf;
+			const uint64_t* __conflen = (uint64_t*)plen;
+
+			if (!__conf || !__conflen || (*__conflen) != sizeof(compressed_config)) throw std::invalid_argument("Expected specific input, got something else");
+
+			compressed_user_data* cud = new compressed_user_data();
+			cud->base = __conf->base;
+			cud->write = __conf->write;
+			cud->block_size = __conf->block_size;
+			cud->read_ahead = __conf->read_ahead;
+			cud->pool = __conf->pool;
+
+			if (!cud->write) {
+				char magic[4]{};
+				if (!read_exact(cud->base->get(), magic, sizeof(magic)) || memcmp(magic, stream_magic, sizeof(magic)) != 0) {
+					set_error(cud, "Not a compressed stream");
+					cud->base_done = true;
+				}
+			}
+			return cud;
+		}
+
+		bool comp_close(ALLEGRO_FILE* fp)
+		{
+			compressed_user_data* cud = (compressed_user_data*)al_get_file_userdata(fp);
+			if (!cud) return false;
+
+			bool good = true;
+			if (cud->write && cud->error == 0) {
+				const uint8_t end[12] = {};
+				good = write_block(cud, cud->pending.data(), cud->pending.size()) && al_fwrite(cud->base->get(), end, sizeof(end)) == sizeof(end);
+				al_fflush(cud->base->get());
+			}
+			for (auto& i : cud->decoding) if (i.valid()) i.wait(); // tasks own their data, this just avoids outliving the pool
+
+			delete cud;
+			return good;
+		}
+
+		size_t comp_read(ALLEGRO_FILE* fp, void* ptr, size_t size)
+		{
+			compressed_user_data* cud = (compressed_user_data*)al_get_file_userdata(fp);
+			if (!cud || cud->write) return 0;
+
+			uint8_t* out = static_cast<uint8_t*>(ptr);
+			size_t done = 0;
+
+			if (cud->ungot >= 0 && size > 0) {
+				out[done++] = static_cast<uint8_t>(cud->ungot);
+				cud->ungot = -1;
+			}
+
+			while (done < size) {
+				if (cud->current_pos == cud->current.size() && !next_block(cud)) break;
+				const size_t now = (std::min)(size - done, cud->current.size() - cud->current_pos);
+				memcpy(out + done, cud->current.data() + cud->current_pos, now);
+				cud->current_pos += now;
+				done += now;
+			}
+
+			cud->position += static_cast<int64_t>(done);
+			return done;
+		}
+
+		size_t comp_write(ALLEGRO_FILE* fp, const void* ptr, size_t size)
+		{
+			compressed_user_data* cud = (compressed_user_data*)al_get_file_userdata(fp);
+			if (!cud || !cud->write || cud->error) return 0;
+
+			const uint8_t* in = static_cast<const uint8_t*>(ptr);
+			size_t done = 0;
+
+			while (done < size) {
+				if (cud->pending.empty() && size - done >= cud->block_size) { // whole block straight from the caller
+					if (!write_block(cud, in + done, cud->block_size)) break;
+					done += cud->block_size;
+					continue;
+				}
+				const size_t now = (std::min)(size - done, cud->block_size - cud->pending.size());
+				cud->pending.insert(cud->pending.end(), in + done, in + done + now);
+				done += now;
+				if (cud->pending.size() == cud->block_size) {
+					if (!write_block(cud, cud->pending.data(), cud->pending.size())) break;
+					cud->pending.clear();
+				}
+			}
+
+			cud->position += static_cast<int64_t>(done);
+			return done;
+		}
+
+		bool comp_flush(ALLEGRO_FILE* fp)
+		{
+			compressed_user_data* cud = (compressed_user_data*)al_get_file_userdata(fp);
+			if (!cud) return false;
+			if (!cud->write) return true;
+
+			if (!write_block(cud, cud->pending.data(), cud->pending.size())) return false;
+			cud->pending.clear();
+			return al_fflush(cud->base->get());
+		}
+
+		int64_t comp_tell(ALLEGRO_FILE* fp)
+		{
+			compressed_user_data* cud = (compressed_user_data*)al_get_file_userdata(fp);
+			return cud ? cud->position : -1;
+		}
+
+		bool comp_seek(ALLEGRO_FILE* fp, int64_t offset, int whence)
+		{
+			compressed_user_data* cud = (compressed_user_data*)al_get_file_userdata(fp);
+			if (!cud || cud->write || offset < 0) return false;
+
+			int64_t skip = 0;
+			switch (whence) {
+			case ALLEGRO_SEEK_CUR:
+				skip = offset;
+				break;
+			case ALLEGRO_SEEK_SET:
+				if (offset < cud->position) return false;
+				skip = offset - cud->position;
+				break;
+			default:
+				return false;
+			}
+
+			uint8_t trash[1 << 12];
+			while (skip > 0) {
+				const size_t got = comp_read(fp, trash, static_cast<size_t>((std::min)(skip, static_cast<int64_t>(sizeof(trash)))));
+				if (got == 0) return false;
+				skip -= static_cast<int64_t>(got);
+			}
+			return true;
+		}
+
+		bool comp_eof(ALLEGRO_FILE* fp)
+		{
+			compressed_user_data* cud = (compressed_user_data*)al_get_file_userdata(fp);
+			if (!cud) return true;
+			if (cud->write) return false;
+			return cud->ungot < 0 && cud->current_pos == cud->current.size() && cud->decoding.empty() && cud->base_done;
+		}
+
+		int comp_error(ALLEGRO_FILE* fp)
+		{
+			compressed_user_data* cud = (compressed_user_data*)al_get_file_userdata(fp);
+			return cud ? cud->error : 1;
+		}
+
+		const char* comp_errmsg(ALLEGRO_FILE* fp)
+		{
+			compressed_user_data* cud = (compressed_user_data*)al_get_file_userdata(fp);
+			if (!cud) return "Internal pointer is NULL";
+			return cud->error ? cud->errmsg.c_str() : "";
+		}
+
+		void comp_clearerr(ALLEGRO_FILE* fp)
+		{
+			compressed_user_data* cud = (compressed_user_data*)al_get_file_userdata(fp);
+			if (cud) cud->error = 0;
+		}
+
+		int comp_ungetc(ALLEGRO_FILE* fp, int c)
+		{
+			compressed_user_data* cud = (compressed_user_data*)al_get_file_userdata(fp);
+			if (!cud || cud->write || cud->ungot >= 0) return -1;
+			cud->ungot = c & 0xFF;
+			--cud->position;
+			return c;
+		}
+
+		off_t comp_size(ALLEGRO_FILE*)
+		{
+			return -1;
+		}
+	}
+
+	File_compressed::File_compressed(File& base, const Mode mode, const size_t block_size, const size_t read_ahead, Thread_pool* pool)
+	{
+		if (block_size == 0 || block_size > _compressmap::max_block) throw std::invalid_argument("Block size must be between 1 and 16 MiB!");
+
+		_compressmap::compressed_config conf;
+		uint64_t len = sizeof(conf);
+
+		conf.base = static_cast<File_shareable_ptr>(base);
+		if (!conf.base || !conf.base->get()) throw std::invalid_argument("Base file is null/empty!");
+		conf.write = mode == Mode::COMPRESS;
+		conf.block_size = block_size;
+		conf.read_ahead = read_ahead;
+		if (!conf.write && read_ahead != 1) {
+			conf.pool = pool ? pool : &Thread_pool::global();
+			if (read_ahead == 0) conf.read_ahead = conf.pool->size() + 1;
+		}
+		if (conf.read_ahead == 0) conf.read_ahead = 1;
+
+		m_fp = make_shareable_file(al_fopen_interface(&_compressmap::compressed_interface, (char*)&conf, (char*)&len),
+			[](ALLEGRO_FILE* f) { al_fclose(f); });
+
+		if (!m_fp || !m_fp->get()) throw std::runtime_error("Could not create File_compressed");
+		m_curr_path = base.get_filepath();
+	}
+
+	File_compressed::File_compressed(File_compressed&& oth) noexcept
+		: File(std::move(oth))
+	{
+	}
+
+	void File_compressed::operator=(File_compressed&& oth) noexcept
+	{
+		this->File::operator=(std::move(oth));
+	}
+
+}
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include "font.h"
+#include "damage_tracker.h"
 
+#include <algorithm>
 #include <atomic>
 
 namespace AllegroCPP {
@@ -366,6 +368,22 @@ namespace AllegroCPP {
 		return m_font ? al_get_glyph_advance(m_font.get(), codepoint, codepoint2) : 0;
 	}
 
+	// Damage of one line of text at x, y. justify_max_x >= 0 spans to there (or further if Allegro gives up justifying).
+	static void report_text_damage(ALLEGRO_FONT* font, const ALLEGRO_USTR* str, const float x, const float y, const text_alignment align, const float justify_max_x = -1.0f)
+	{
+		if (!damage_tracking_active()) return; // measuring text isn't free
+		int bbx, bby, bbw, bbh;
+		al_get_ustr_dimensions(font, str, &bbx, &bby, &bbw, &bbh);
+		const float width = static_cast<float>(al_get_ustr_width(font, str));
+		float left = x;
+		if (align == text_alignment::CENTER) left = x - width * 0.5f;
+		else if (align == text_alignment::RIGHT) left = x - width;
+		const float right = (std::max)({ left + width, left + bbx + bbw, justify_max_x });
+		const float top = (std::min)(y, y + bby);
+		const float bottom = (std::max)(y + al_get_font_line_height(font), y + bby + bbh);
+		damage_report((std::min)(left, left + bbx), top, right - (std::min)(left, left + bbx), bottom - top);
+	}
+
 	bool Font::draw() const
 	{
 		if (!m_font) return false;
@@ -395,10 +413,12 @@ namespace AllegroCPP {
 			{
 				const auto& sett = m_stored_draw_props._justified_props;
 				al_draw_justified_ustr(m_font.get(), m_stored_draw_props._color, m_stored_draw_props._pos.target_x, sett.max_x, m_stored_draw_props._pos.target_y, sett.diff, sett.extra_flags, _str);
+				report_text_damage(m_font.get(), _str, m_stored_draw_props._pos.target_x, m_stored_draw_props._pos.target_y, text_alignment::LEFT, sett.max_x);
 			}
 			else
 			{
 				al_draw_ustr(m_font.get(), m_stored_draw_props._color, m_stored_draw_props._pos.target_x, m_stored_draw_props._pos.target_y, static_cast<int>(m_stored_draw_props._align), _str);
+				report_text_damage(m_font.get(), _str, m_stored_draw_props._pos.target_x, m_stored_draw_props._pos.target_y, m_stored_draw_props._align);
 			}
 		}
 
@@ -426,6 +446,8 @@ namespace AllegroCPP {
 		if (!m_font) return false;
 
 		al_draw_glyph(m_font.get(), color, target_x, target_y, codepoint);
+		int bbx, bby, bbw, bbh;
+		if (damage_tracking_active() && al_get_glyph_dimensions(m_font.get(), codepoint, &bbx, &bby, &bbw, &bbh)) damage_report(target_x + bbx, target_y + bby, static_cast<float>(bbw), static_cast<float>(bbh));
 		return true;
 	}
 
@@ -450,9 +472,11 @@ namespace AllegroCPP {
 			if (!s->delim_opt.has_value()) return false; // needs just_settings!
 			const auto& sett = s->delim_opt.value();
 			al_draw_justified_ustr(s->font.get(), s->color, s->target_x, sett.max_x, y, sett.diff, sett.extra_flags, line);
+			report_text_damage(s->font.get(), line, s->target_x, y, text_alignment::LEFT, sett.max_x);
 		}
 		else { // LEFT, CENTER, RIGHT
 			al_draw_ustr(s->font.get(), s->color, s->target_x, y, static_cast<int>(s->align), line);
+			report_text_damage(s->font.get(), line, s->target_x, y, s->align);
 		}
 
 		return true;
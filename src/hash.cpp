@@ -0,0 +1,314 @@
+#include "hash.h"
+#include "cpu_features.h"
+
+#include <string.h>
+
+#include <atomic>
+#include <vector>
+
+#if !defined(ALLEGROCPP_X86) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+namespace AllegroCPP {
+
+	constexpr uint32_t crc32c_poly = 0x82F63B78u; // reflected
+	constexpr uint64_t xxh_p1 = 11400714785074694791ULL;
+	constexpr uint64_t xxh_p2 = 14029467366897019727ULL;
+	constexpr uint64_t xxh_p3 = 1609587929392839161ULL;
+	constexpr uint64_t xxh_p4 = 9650029242287828579ULL;
+	constexpr uint64_t xxh_p5 = 2870177450012600261ULL;
+
+	static inline uint32_t load32le(const uint8_t* p)
+	{
+		return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) | (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+	}
+
+	static inline uint64_t load64le(const uint8_t* p)
+	{
+		return static_cast<uint64_t>(load32le(p)) | (static_cast<uint64_t>(load32le(p + 4)) << 32);
+	}
+
+	static inline uint64_t rotl64(const uint64_t x, const int r)
+	{
+		return (x << r) | (x >> (64 - r));
+	}
+
+	// Slicing by 8, used when there is no CRC instruction.
+	struct _crc32c_tables {
+		uint32_t t[8][256];
+
+		_crc32c_tables() {
+			for (uint32_t i = 0; i < 256; ++i) {
+				uint32_t c = i;
+				for (int k = 0; k < 8; ++k) c = (c & 1) ? (c >> 1) ^ crc32c_poly : (c >> 1);
+				t[0][i] = c;
+			}
+			for (uint32_t i = 0; i < 256; ++i) {
+				for (int k = 1; k < 8; ++k) t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xFF];
+			}
+		}
+	};
+
+	// a * b modulo the CRC polynomial, bit reflected.
+	static uint32_t crc32c_multmodp(uint32_t a, uint32_t b)
+	{
+		uint32_t m = static_cast<uint32_t>(1) << 31;
+		uint32_t p = 0;
+		while (true) {
+			if (a & m) {
+				p ^= b;
+				if ((a & (m - 1)) == 0) break;
+			}
+			m >>= 1;
+			b = (b & 1) ? (b >> 1) ^ crc32c_poly : (b >> 1);
+		}
+		return p;
+	}
+
+	// x^(n * 2^k) modulo the CRC polynomial.
+	static uint32_t crc32c_x2nmodp(uint64_t n, unsigned k)
+	{
+		static const auto table = [] {
+			std::vector<uint32_t> t(32);
+			uint32_t p = static_cast<uint32_t>(1) << 30; // x^1
+			t[0] = p;
+			for (size_t i = 1; i < t.size(); ++i) t[i] = p = crc32c_multmodp(p, p);
+			return t;
+		}();
+
+		uint32_t p = static_cast<uint32_t>(1) << 31; // x^0
+		while (n) {
+			if (n & 1) p = crc32c_multmodp(table[k & 31], p);
+			n >>= 1;
+			++k;
+		}
+		return p;
+	}
+
+#ifdef ALLEGROCPP_X86
+	// c is the running (inverted) value, as in crc32c().
+	ALLEGROCPP_TARGET("sse4.2")
+	static uint32_t crc32c_sse42(const uint8_t* p, size_t left, uint32_t c)
+	{
+#if defined(__x86_64__) || defined(_M_X64)
+		for (; left >= 8; p += 8, left -= 8) {
+			uint64_t v;
+			memcpy(&v, p, 8);
+			c = static_cast<uint32_t>(_mm_crc32_u64(c, v));
+		}
+#endif
+		for (; left >= 4; p += 4, left -= 4) c = _mm_crc32_u32(c, load32le(p));
+		for (; left > 0; --left) c = _mm_crc32_u8(c, *p++);
+		return c;
+	}
+#endif
+
+	uint32_t crc32c(const void* data, const size_t len, const uint32_t crc)
+	{
+		const uint8_t* p = static_cast<const uint8_t*>(data);
+		size_t left = len;
+		uint32_t c = ~crc;
+
+#if defined(__ARM_FEATURE_CRC32) && !defined(ALLEGROCPP_X86)
+		for (; left >= 8; p += 8, left -= 8) {
+			uint64_t v;
+			memcpy(&v, p, 8);
+			c = __crc32cd(c, v);
+		}
+		for (; left > 0; --left) c = __crc32cb(c, *p++);
+#else
+#ifdef ALLEGROCPP_X86
+		if (_cpu_features::get().sse42) return ~crc32c_sse42(p, left, c);
+#endif
+		static const _crc32c_tables tables;
+		const auto& t = tables.t;
+		for (; left >= 8; p += 8, left -= 8) {
+			const uint32_t lo = load32le(p) ^ c;
+			const uint32_t hi = load32le(p + 4);
+			c = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+				t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+		}
+		for (; left > 0; --left) c = (c >> 8) ^ t[0][(c ^ *p++) & 0xFF];
+#endif
+		return ~c;
+	}
+
+	uint32_t crc32c_combine(const uint32_t crc_a, const uint32_t crc_b, const uint64_t len_b)
+	{
+		return crc32c_multmodp(crc32c_x2nmodp(len_b, 3), crc_a) ^ crc_b;
+	}
+
+	static inline uint64_t xxh64_round(uint64_t acc, const uint64_t input)
+	{
+		acc += input * xxh_p2;
+		acc = rotl64(acc, 31);
+		return acc * xxh_p1;
+	}
+
+	static inline uint64_t xxh64_merge(uint64_t acc, const uint64_t val)
+	{
+		acc ^= xxh64_round(0, val);
+		return acc * xxh_p1 + xxh_p4;
+	}
+
+	uint64_t xxhash64(const void* data, const size_t len, const uint64_t seed)
+	{
+		const uint8_t* p = static_cast<const uint8_t*>(data);
+		const uint8_t* const end = p + len;
+		uint64_t h;
+
+		if (len >= 32) {
+			uint64_t v1 = seed + xxh_p1 + xxh_p2;
+			uint64_t v2 = seed + xxh_p2;
+			uint64_t v3 = seed;
+			uint64_t v4 = seed - xxh_p1;
+			for (; p + 32 <= end; p += 32) {
+				v1 = xxh64_round(v1, load64le(p));
+				v2 = xxh64_round(v2, load64le(p + 8));
+				v3 = xxh64_round(v3, load64le(p + 16));
+				v4 = xxh64_round(v4, load64le(p + 24));
+			}
+			h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+			h = xxh64_merge(h, v1);
+			h = xxh64_merge(h, v2);
+			h = xxh64_merge(h, v3);
+			h = xxh64_merge(h, v4);
+		}
+		else h = seed + xxh_p5;
+
+		h += static_cast<uint64_t>(len);
+
+		for (; p + 8 <= end; p += 8) {
+			h ^= xxh64_round(0, load64le(p));
+			h = rotl64(h, 27) * xxh_p1 + xxh_p4;
+		}
+		if (p + 4 <= end) {
+			h ^= static_cast<uint64_t>(load32le(p)) * xxh_p1;
+			h = rotl64(h, 23) * xxh_p2 + xxh_p3;
+			p += 4;
+		}
+		for (; p < end; ++p) {
+			h ^= static_cast<uint64_t>(*p) * xxh_p5;
+			h = rotl64(h, 11) * xxh_p1;
+		}
+
+		h ^= h >> 33;
+		h *= xxh_p2;
+		h ^= h >> 29;
+		h *= xxh_p3;
+		h ^= h >> 32;
+		return h;
+	}
+
+	// Chunks are taken from a shared counter by the pool and by the calling thread, so a busy pool can't stall the call.
+	// Kept alive by shared_ptr: tasks that start after everything is done just find no work left.
+	struct _hash_chunk_job {
+		File_cursor src;
+		int64_t total = 0;
+		size_t chunk = 0;
+		size_t count = 0;
+		std::function<void(const size_t, const uint8_t*, const size_t)> fn;
+
+		std::atomic<size_t> next = 0;
+		std::mutex mtx;
+		std::condition_variable cond;
+		size_t done = 0;
+		bool failed = false;
+
+		void run()
+		{
+			File_cursor cur = src;
+			std::vector<uint8_t> buf;
+			for (size_t i; (i = next.fetch_add(1)) < count;) {
+				const int64_t off = static_cast<int64_t>(i) * static_cast<int64_t>(chunk);
+				const size_t len = static_cast<size_t>((total - off) < static_cast<int64_t>(chunk) ? (total - off) : static_cast<int64_t>(chunk));
+				if (buf.size() < len) buf.resize(len);
+
+				const bool good = cur.read_at(off, buf.data(), len) == len;
+				if (good) fn(i, buf.data(), len);
+
+				std::lock_guard<std::mutex> l(mtx);
+				if (!good) failed = true;
+				if (++done == count) cond.notify_all();
+			}
+		}
+	};
+
+	static void hash_chunks(File_cursor src, const file_hash_options& opt, std::function<void(const size_t, const uint8_t*, const size_t)> fn, size_t& count)
+	{
+		if (!src) throw std::runtime_error("Can't hash null/empty file!");
+		if (opt.chunk == 0) throw std::invalid_argument("Chunk size is zero!");
+
+		auto job = std::make_shared<_hash_chunk_job>();
+		job->src = src;
+		job->total = src.size();
+		job->chunk = opt.chunk;
+		job->count = static_cast<size_t>((job->total + static_cast<int64_t>(opt.chunk) - 1) / static_cast<int64_t>(opt.chunk));
+		job->fn = std::move(fn);
+		count = job->count;
+		if (count == 0) return;
+
+		Thread_pool& pool = opt.pool ? *opt.pool : Thread_pool::global();
+		const size_t helpers = pool.is_worker_thread() ? 0 : ((count - 1) < pool.size() ? (count - 1) : pool.size()); // from a task of that pool: all inline, never wait on it
+		for (size_t p = 0; p < helpers; ++p) pool.push([job] { job->run(); });
+
+		job->run();
+
+		std::unique_lock<std::mutex> l(job->mtx);
+		job->cond.wait(l, [&] { return job->done == job->count; });
+		if (job->failed) throw std::runtime_error("Could not read file while hashing!");
+	}
+
+	uint32_t crc32c(File_cursor src, const file_hash_options& opt)
+	{
+		std::vector<uint32_t> crcs;
+		std::vector<size_t> lens;
+		const size_t expected = opt.chunk ? static_cast<size_t>((src.size() + static_cast<int64_t>(opt.chunk) - 1) / static_cast<int64_t>(opt.chunk)) : 0;
+		crcs.resize(expected);
+		lens.resize(expected);
+
+		size_t count = 0;
+		hash_chunks(src, opt, [&](const size_t i, const uint8_t* data, const size_t len) {
+			crcs[i] = crc32c(data, len);
+			lens[i] = len;
+		}, count);
+
+		if (count == 0) return crc32c(nullptr, 0);
+		uint32_t crc = crcs[0];
+		for (size_t i = 1; i < count; ++i) crc = crc32c_combine(crc, crcs[i], lens[i]);
+		return crc;
+	}
+
+	uint32_t crc32c(File& file, const file_hash_options& opt)
+	{
+		return crc32c(file.make_cursor(), opt);
+	}
+
+	uint64_t xxhash64_tree(File_cursor src, const uint64_t seed, const file_hash_options& opt)
+	{
+		std::vector<uint64_t> digests;
+		const size_t expected = opt.chunk ? static_cast<size_t>((src.size() + static_cast<int64_t>(opt.chunk) - 1) / static_cast<int64_t>(opt.chunk)) : 0;
+		digests.resize(expected);
+
+		size_t count = 0;
+		hash_chunks(src, opt, [&](const size_t i, const uint8_t* data, const size_t len) {
+			digests[i] = xxhash64(data, len, seed);
+		}, count);
+
+		if (count == 0) return xxhash64(nullptr, 0, seed);
+		if (count == 1) return digests[0];
+
+		std::vector<uint8_t> leaves(count * 8);
+		for (size_t i = 0; i < count; ++i) {
+			for (int b = 0; b < 8; ++b) leaves[i * 8 + b] = static_cast<uint8_t>(digests[i] >> (8 * b));
+		}
+		return xxhash64(leaves.data(), leaves.size(), seed);
+	}
+
+	uint64_t xxhash64_tree(File& file, const uint64_t seed, const file_hash_options& opt)
+	{
+		return xxhash64_tree(file.make_cursor(), seed, opt);
+	}
+
+}
\ No newline at end of file
@@ -9,6 +9,8 @@ namespace AllegroCPP {
 		if (!bmp) throw std::invalid_argument("Bitmap was null!");
 
 		if (!(m_ptr = al_lock_bitmap(bmp, format, flags))) throw std::runtime_error("Can't lock bitmap.");
+		m_width = al_get_bitmap_width(bmp);
+		m_height = al_get_bitmap_height(bmp);
 	}
 
 	Locked_region::Locked_region(ALLEGRO_BITMAP* bmp, const int pos_x, const int pos_y, const int width, const int height, const int format, const int flags)
@@ -18,6 +20,8 @@ namespace AllegroCPP {
 		if (!bmp) throw std::invalid_argument("Bitmap was null!");
 
 		if (!(m_ptr = al_lock_bitmap_region(bmp, pos_x, pos_y, width, height, format, flags))) throw std::runtime_error("Can't lock bitmap.");
+		m_width = width;
+		m_height = height;
 	}
 
 	Locked_region::~Locked_region()
@@ -26,7 +30,7 @@ namespace AllegroCPP {
 	}
 
 	Locked_region::Locked_region(Locked_region&& oth) noexcept
-		: m_locked(oth.m_locked), m_ptr(oth.m_ptr), m_format(oth.m_format), m_flags(oth.m_flags)
+		: m_locked(oth.m_locked), m_ptr(oth.m_ptr), m_format(oth.m_format), m_flags(oth.m_flags), m_width(oth.m_width), m_height(oth.m_height)
 	{
 		oth.m_locked = nullptr;
 		oth.m_ptr = nullptr;
@@ -39,33 +43,35 @@ namespace AllegroCPP {
 		m_ptr = oth.m_ptr;
 		m_format = oth.m_format;
 		m_flags = oth.m_flags;
+		m_width = oth.m_width;
+		m_height = oth.m_height;
 		oth.m_locked = nullptr;
 		oth.m_ptr = nullptr;
 	}
 
 	int Locked_region::get_format_pixel_size() const
 	{
-		return m_ptr ? al_get_pixel_size(m_format) : -1;
+		return m_ptr ? al_get_pixel_size(m_ptr->format) : -1;
 	}
 
 	int Locked_region::get_format_bits() const
 	{
-		return m_ptr ? al_get_pixel_format_bits(m_format) : -1;
+		return m_ptr ? al_get_pixel_format_bits(m_ptr->format) : -1;
 	}
 
 	int Locked_region::get_pixel_block_size() const
 	{
-		return m_ptr ? al_get_pixel_block_size(m_format) : -1;
+		return m_ptr ? al_get_pixel_block_size(m_ptr->format) : -1;
 	}
 
 	int Locked_region::get_pixel_block_width() const
 	{
-		return m_ptr ? al_get_pixel_block_width(m_format) : -1;
+		return m_ptr ? al_get_pixel_block_width(m_ptr->format) : -1;
 	}
 
 	int Locked_region::get_pixel_block_height() const
 	{
-		return m_ptr ? al_get_pixel_block_height(m_format) : -1;
+		return m_ptr ? al_get_pixel_block_height(m_ptr->format) : -1;
 	}
 
 	void* Locked_region::get_data()
@@ -93,6 +99,16 @@ namespace AllegroCPP {
 		return m_ptr ? m_ptr->pixel_size : -1;
 	}
 
+	int Locked_region::get_width() const
+	{
+		return m_ptr ? m_width : -1;
+	}
+
+	int Locked_region::get_height() const
+	{
+		return m_ptr ? m_height : -1;
+	}
+
 	bool Locked_region::put_pixel(const int pos_x, const int pos_y, const ALLEGRO_COLOR color)
 	{
 		if (!m_ptr || !m_locked) return false;
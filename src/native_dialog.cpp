@@ -1,4 +1,5 @@
 #include "native_dialog.h"
+#include "numeric_text.h"
 
 #include <utility>
 
@@ -221,57 +222,68 @@ namespace AllegroCPP {
 
 	Text_log& Text_log::operator<<(short val)
 	{
-		return *this << std::to_string(val);
+		_numeric_text::format(val, [this](const char* str, const size_t len) { this->write(str, len); });
+		return *this;
 	}
 
 	Text_log& Text_log::operator<<(unsigned short val)
 	{
-		return *this << std::to_string(val);
+		_numeric_text::format(val, [this](const char* str, const size_t len) { this->write(str, len); });
+		return *this;
 	}
 
 	Text_log& Text_log::operator<<(int val)
 	{
-		return *this << std::to_string(val);
+		_numeric_text::format(val, [this](const char* str, const size_t len) { this->write(str, len); });
+		return *this;
 	}
 
 	Text_log& Text_log::operator<<(unsigned int val)
 	{
-		return *this << std::to_string(val);
+		_numeric_text::format(val, [this](const char* str, const size_t len) { this->write(str, len); });
+		return *this;
 	}
 
 	Text_log& Text_log::operator<<(long val)
 	{
-		return *this << std::to_string(val);
+		_numeric_text::format(val, [this](const char* str, const size_t len) { this->write(str, len); });
+		return *this;
 	}
 
 	Text_log& Text_log::operator<<(unsigned long val)
 	{
-		return *this << std::to_string(val);
+		_numeric_text::format(val, [this](const char* str, const size_t len) { this->write(str, len); });
+		return *this;
 	}
 
 	Text_log& Text_log::operator<<(long long val)
 	{
-		return *this << std::to_string(val);
+		_numeric_text::format(val, [this](const char* str, const size_t len) { this->write(str, len); });
+		return *this;
 	}
 
 	Text_log& Text_log::operator<<(unsigned long long val)
 	{
-		return *this << std::to_string(val);
+		_numeric_text::format(val, [this](const char* str, const size_t len) { this->write(str, len); });
+		return *this;
 	}
 
 	Text_log& Text_log::operator<<(float val)
 	{
-		return *this << std::to_string(val);
+		_numeric_text::format(val, [this](const char* str, const size_t len) { this->write(str, len); });
+		return *this;
 	}
 
 	Text_log& Text_log::operator<<(double val)
 	{
-		return *this << std::to_string(val);
+		_numeric_text::format(val, [this](const char* str, const size_t len) { this->write(str, len); });
+		return *this;
 	}
 
 	Text_log& Text_log::operator<<(long double val)
 	{
-		return *this << std::to_string(val);
+		_numeric_text::format(val, [this](const char* str, const size_t len) { this->write(str, len); });
+		return *this;
 	}
 
 	Text_log& Text_log::operator<<(std::streambuf* sb)
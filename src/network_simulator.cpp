@@ -0,0 +1,264 @@
+#include "network_simulator.h"
+
+#ifndef ALLEGROCPP_DISABLE_FILESOCKET
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+namespace AllegroCPP {
+
+	Network_simulator::_endpoint::_endpoint(File_client&& s)
+		: sock(std::move(s))
+	{
+	}
+
+	Network_simulator::Network_simulator(const uint16_t listen_port, const std::string& target_addr, const uint16_t target_port, const file_protocol protocol, const network_conditions& cond)
+		: m_target_addr(target_addr), m_target_port(target_port), m_protocol(protocol), m_cond(cond)
+	{
+		if (!al_is_system_installed()) al_init();
+		if (target_port == 0) throw std::invalid_argument("Target port is zero!");
+
+		m_host = std::make_unique<File_host>(listen_port, protocol);
+		if (!m_host->valid()) throw std::runtime_error("Could not listen on port!");
+
+		m_scheduler.create([this] { return schedule_once(); }, Thread::Mode::NORMAL);
+		m_accepter.create([this] { return accept_once(); }, Thread::Mode::NORMAL);
+	}
+
+	Network_simulator::~Network_simulator()
+	{
+		stop();
+	}
+
+	bool Network_simulator::accept_once()
+	{
+		if (!m_running) return false;
+		prune_finished();
+
+		File_client down = m_host->listen(100);
+		if (!down.valid()) return true;
+
+		auto conn = std::make_unique<_connection>();
+		try {
+			conn->up = std::make_shared<_endpoint>(File_client(m_target_addr, m_target_port, m_protocol));
+		}
+		catch (...) {
+			return true; // target not there, drop this client
+		}
+		if (!conn->up->sock.valid()) return true;
+		conn->down = std::make_shared<_endpoint>(std::move(down));
+
+		{
+			std::lock_guard<std::mutex> l(m_stats_mtx);
+			conn->to_up.stream = static_cast<uint32_t>(m_stats.connections * 2);
+			conn->to_down.stream = static_cast<uint32_t>(m_stats.connections * 2 + 1);
+			++m_stats.connections;
+		}
+
+		_connection* raw = conn.get();
+		raw->reader_up.create([this, raw] { if (pump(raw->down, raw->up, raw->to_up)) return true; ++raw->readers_done; return false; }, Thread::Mode::NORMAL);
+		raw->reader_down.create([this, raw] { if (pump(raw->up, raw->down, raw->to_down)) return true; ++raw->readers_done; return false; }, Thread::Mode::NORMAL);
+
+		std::lock_guard<std::mutex> l(m_conn_mtx);
+		m_connections.push_back(std::move(conn));
+
+		return m_protocol == file_protocol::TCP; // UDP host socket is now owned by the one peer
+	}
+
+	void Network_simulator::prune_finished()
+	{
+		std::lock_guard<std::mutex> l(m_conn_mtx);
+		m_connections.erase(std::remove_if(m_connections.begin(), m_connections.end(), [](const std::unique_ptr<_connection>& c) {
+			if (c->readers_done < 2) return false;
+			c->reader_up.join(); // already out of their loops, queued packets keep the endpoints alive
+			c->reader_down.join();
+			return true;
+		}), m_connections.end());
+	}
+
+	bool Network_simulator::pump(const std::shared_ptr<_endpoint>& src, const std::shared_ptr<_endpoint>& dst, _direction& dir)
+	{
+		if (!m_running) return false;
+
+		{
+			std::lock_guard<std::mutex> l(src->mtx);
+			if (!src->open) { // closed by the other side through the queue, only this thread touches the socket now
+				src->sock.close();
+				return false;
+			}
+		}
+
+		if (!src->sock.wait_for_data(20)) return true;
+
+		std::vector<char> buf(static_cast<size_t>(1) << 16);
+		size_t got = 0;
+		{
+			std::lock_guard<std::mutex> l(src->mtx);
+			got = src->sock.read(buf.data(), buf.size());
+		}
+
+		if (got == 0) {
+			if (m_protocol == file_protocol::TCP) { // disconnected, close the other end after the same delay
+				enqueue(dst, dir, {});
+				return false;
+			}
+			return true;
+		}
+
+		buf.resize(got);
+		enqueue(dst, dir, std::move(buf));
+		return true;
+	}
+
+	void Network_simulator::enqueue(const std::shared_ptr<_endpoint>& dst, _direction& dir, std::vector<char>&& data)
+	{
+		network_conditions c;
+		uint64_t generation;
+		{
+			std::lock_guard<std::mutex> l(m_cond_mtx);
+			c = m_cond;
+			generation = m_cond_generation;
+		}
+		if (dir.generation != generation) { // new conditions restart the sequence, whatever the other threads drew
+			std::seed_seq seq{ c.seed, dir.stream };
+			dir.rng.seed(seq);
+			dir.generation = generation;
+		}
+
+		double extra = 0.0;
+		bool drop = false;
+		if (c.jitter > 0.0) {
+			switch (c.distribution) {
+			case delay_distribution::CONSTANT:
+				break;
+			case delay_distribution::UNIFORM:
+				extra = std::uniform_real_distribution<double>(-c.jitter, c.jitter)(dir.rng);
+				break;
+			case delay_distribution::NORMAL:
+				extra = std::normal_distribution<double>(0.0, c.jitter)(dir.rng);
+				break;
+			case delay_distribution::EXPONENTIAL:
+				extra = std::exponential_distribution<double>(1.0 / c.jitter)(dir.rng);
+				break;
+			}
+		}
+		if (m_protocol == file_protocol::UDP && !data.empty() && c.drop > 0.0) drop = std::uniform_real_distribution<double>(0.0, 1.0)(dir.rng) < c.drop;
+
+		if (drop) {
+			std::lock_guard<std::mutex> l(m_stats_mtx);
+			++m_stats.dropped;
+			return;
+		}
+
+		const double now = al_get_time();
+		double sent_at = now;
+		if (c.bandwidth > 0.0 && !data.empty()) { // serialization: queues behind what is still "on the wire"
+			dir.next_free = (std::max)(now, dir.next_free) + static_cast<double>(data.size()) / c.bandwidth;
+			sent_at = dir.next_free;
+		}
+
+		double due = sent_at + (std::max)(0.0, c.delay + extra);
+		if (m_protocol == file_protocol::TCP) due = (std::max)(due, dir.last_due); // a stream can't reorder
+		dir.last_due = due;
+
+		{
+			std::lock_guard<std::mutex> l(m_queue_mtx);
+			m_queue.push(_packet{ due, m_order++, due - now, dst, std::move(data) });
+		}
+		m_queue_cv.notify_one();
+	}
+
+	bool Network_simulator::schedule_once()
+	{
+		std::unique_lock<std::mutex> l(m_queue_mtx);
+		if (!m_running) return false;
+
+		if (m_queue.empty()) {
+			m_queue_cv.wait_for(l, std::chrono::milliseconds(50));
+			return true;
+		}
+
+		const double now = al_get_time();
+		const double due = m_queue.top().due;
+		if (due > now) {
+			m_queue_cv.wait_for(l, std::chrono::duration<double>((std::min)(due - now, 0.05)));
+			return true;
+		}
+
+		_packet p = std::move(const_cast<_packet&>(m_queue.top()));
+		m_queue.pop();
+		l.unlock();
+
+		std::lock_guard<std::mutex> el(p.dst->mtx);
+		if (!p.dst->open) return true;
+		if (p.data.empty()) {
+			p.dst->open = false; // its reader closes the socket
+			return true;
+		}
+
+		size_t done = 0;
+		if (m_protocol == file_protocol::TCP) {
+			while (done < p.data.size()) {
+				const size_t now_sent = p.dst->sock.write(p.data.data() + done, p.data.size() - done);
+				if (now_sent == 0) break;
+				done += now_sent;
+			}
+		}
+		else done = p.dst->sock.write(p.data.data(), p.data.size());
+
+		std::lock_guard<std::mutex> sl(m_stats_mtx);
+		++m_stats.packets;
+		m_stats.bytes += done;
+		m_delay_sum += p.delay;
+		return true;
+	}
+
+	void Network_simulator::set_conditions(const network_conditions& c)
+	{
+		std::lock_guard<std::mutex> l(m_cond_mtx);
+		m_cond = c;
+		++m_cond_generation;
+	}
+
+	network_conditions Network_simulator::get_conditions()
+	{
+		std::lock_guard<std::mutex> l(m_cond_mtx);
+		return m_cond;
+	}
+
+	network_simulator_stats Network_simulator::get_stats() const
+	{
+		std::lock_guard<std::mutex> l(m_stats_mtx);
+		network_simulator_stats st = m_stats;
+		st.average_delay = st.packets ? m_delay_sum / static_cast<double>(st.packets) : 0.0;
+		return st;
+	}
+
+	void Network_simulator::stop()
+	{
+		m_running = false;
+		m_queue_cv.notify_all();
+
+		m_accepter.join();
+		{
+			std::lock_guard<std::mutex> l(m_conn_mtx);
+			for (auto& i : m_connections) {
+				i->reader_up.join();
+				i->reader_down.join();
+			}
+		}
+		m_scheduler.join();
+
+		{
+			std::lock_guard<std::mutex> l(m_queue_mtx);
+			while (!m_queue.empty()) m_queue.pop();
+		}
+		std::lock_guard<std::mutex> l(m_conn_mtx);
+		m_connections.clear();
+		m_host.reset();
+	}
+
+}
+
+#endif // ALLEGROCPP_DISABLE_FILESOCKET
\ No newline at end of file
@@ -0,0 +1,450 @@
+#include "pixel_convert.h"
+#include "pixel_view.h"
+#include "cpu_features.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <bit>
+
+namespace AllegroCPP {
+
+	constexpr size_t convert_chunk = 1024; // pixels per pass through the rgba8 buffer
+
+	// Byte of each channel inside a 32 bit pixel in memory (little endian), -1 for none.
+	struct _layout32 {
+		int r, g, b, a;
+	};
+
+	static bool layout32(const int format, _layout32& out)
+	{
+		if constexpr (std::endian::native != std::endian::little) {
+			if (format != ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE) return false;
+		}
+		switch (format) {
+		case ALLEGRO_PIXEL_FORMAT_ARGB_8888: out = { 2, 1, 0, 3 }; return true;
+		case ALLEGRO_PIXEL_FORMAT_RGBA_8888: out = { 3, 2, 1, 0 }; return true;
+		case ALLEGRO_PIXEL_FORMAT_ABGR_8888: out = { 0, 1, 2, 3 }; return true;
+		case ALLEGRO_PIXEL_FORMAT_XRGB_8888: out = { 2, 1, 0, -1 }; return true;
+		case ALLEGRO_PIXEL_FORMAT_XBGR_8888: out = { 0, 1, 2, -1 }; return true;
+		case ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE: out = { 0, 1, 2, 3 }; return true;
+		default: return false;
+		}
+	}
+
+#ifdef ALLEGROCPP_X86
+	// order is the 16 byte shuffle of 4 pixels. Both return how many pixels they did.
+	ALLEGROCPP_TARGET("ssse3")
+	static size_t swizzle32_ssse3(const uint8_t* src, uint8_t* dst, const size_t count, const int8_t* order, const uint32_t fill)
+	{
+		const __m128i mask = _mm_load_si128((const __m128i*)order);
+		const __m128i fill4 = _mm_set1_epi32(static_cast<int>(fill));
+		size_t p = 0;
+		for (; p + 4 <= count; p += 4) {
+			const __m128i v = _mm_loadu_si128((const __m128i*)(src + p * 4));
+			_mm_storeu_si128((__m128i*)(dst + p * 4), _mm_or_si128(_mm_shuffle_epi8(v, mask), fill4));
+		}
+		return p;
+	}
+
+	ALLEGROCPP_TARGET("avx2")
+	static size_t swizzle32_avx2(const uint8_t* src, uint8_t* dst, const size_t count, const int8_t* order, const uint32_t fill)
+	{
+		const __m256i mask = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i*)order)); // shuffle is per 128 bit lane, same pattern on both
+		const __m256i fill8 = _mm256_set1_epi32(static_cast<int>(fill));
+		size_t p = 0;
+		for (; p + 8 <= count; p += 8) {
+			const __m256i v = _mm256_loadu_si256((const __m256i*)(src + p * 4));
+			_mm256_storeu_si256((__m256i*)(dst + p * 4), _mm256_or_si256(_mm256_shuffle_epi8(v, mask), fill8));
+		}
+		return p;
+	}
+#endif
+
+	// dst byte k of each pixel = src byte idx[k] (-1: 0), then or'ed with fill (alpha that the source doesn't have).
+	static void swizzle32(const uint8_t* src, uint8_t* dst, const size_t count, const int idx[4], const uint32_t fill)
+	{
+		size_t p = 0;
+#ifdef ALLEGROCPP_X86
+		const auto& cpu = _cpu_features::get();
+		if (cpu.ssse3) {
+			alignas(16) int8_t order[16];
+			for (int i = 0; i < 16; ++i) order[i] = idx[i % 4] < 0 ? static_cast<int8_t>(-128) : static_cast<int8_t>((i / 4) * 4 + idx[i % 4]);
+			if (cpu.avx2) p = swizzle32_avx2(src, dst, count, order, fill);
+			p += swizzle32_ssse3(src + p * 4, dst + p * 4, count - p, order, fill);
+		}
+#endif
+		uint8_t f[4];
+		memcpy(f, &fill, 4);
+		for (; p < count; ++p) {
+			const uint8_t* s = src + p * 4;
+			uint8_t px[4];
+			for (int k = 0; k < 4; ++k) px[k] = static_cast<uint8_t>((idx[k] < 0 ? 0 : s[idx[k]]) | f[k]);
+			memcpy(dst + p * 4, px, 4);
+		}
+	}
+
+	// to and from bytes r, g, b, a
+	static void swizzle_to_rgba8(const _layout32& l, const uint8_t* src, uint8_t* dst, const size_t count)
+	{
+		const int idx[4] = { l.r, l.g, l.b, l.a };
+		swizzle32(src, dst, count, idx, l.a < 0 ? 0xFF000000u : 0u);
+	}
+
+	static void swizzle_from_rgba8(const _layout32& l, const uint8_t* src, uint8_t* dst, const size_t count)
+	{
+		int idx[4] = { -1, -1, -1, -1 };
+		idx[l.r] = 0;
+		idx[l.g] = 1;
+		idx[l.b] = 2;
+		if (l.a >= 0) idx[l.a] = 3;
+		swizzle32(src, dst, count, idx, 0u);
+	}
+
+	static void rgb565_to_rgba8(const uint8_t* src, uint8_t* dst, const size_t count)
+	{
+		size_t p = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+		const __m128i m6 = _mm_set1_epi16(63);
+		const __m128i m5 = _mm_set1_epi16(31);
+		const __m128i alpha = _mm_set1_epi16(static_cast<short>(0xFF00));
+		for (; p + 8 <= count; p += 8) {
+			const __m128i v = _mm_loadu_si128((const __m128i*)(src + p * 2));
+			// round(v * 255 / max) without dividing
+			const __m128i r = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_srli_epi16(v, 11), _mm_set1_epi16(527)), _mm_set1_epi16(23)), 6);
+			const __m128i g = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_and_si128(_mm_srli_epi16(v, 5), m6), _mm_set1_epi16(259)), _mm_set1_epi16(33)), 6);
+			const __m128i b = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_and_si128(v, m5), _mm_set1_epi16(527)), _mm_set1_epi16(23)), 6);
+			const __m128i rg = _mm_or_si128(r, _mm_slli_epi16(g, 8));
+			const __m128i ba = _mm_or_si128(b, alpha);
+			_mm_storeu_si128((__m128i*)(dst + p * 4), _mm_unpacklo_epi16(rg, ba));
+			_mm_storeu_si128((__m128i*)(dst + p * 4 + 16), _mm_unpackhi_epi16(rg, ba));
+		}
+#endif
+		using T = pixel_traits<ALLEGRO_PIXEL_FORMAT_RGB_565>;
+		for (; p < count; ++p) {
+			T::type px;
+			memcpy(&px, src + p * 2, 2);
+			const pixel_rgba8 c = T::unpack(px);
+			memcpy(dst + p * 4, &c, 4);
+		}
+	}
+
+	static void rgba8_to_rgb565(const uint8_t* src, uint8_t* dst, const size_t count)
+	{
+		size_t p = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+		const __m128i m8 = _mm_set1_epi32(0xFF);
+		for (; p + 8 <= count; p += 8) {
+			const __m128i lo = _mm_loadu_si128((const __m128i*)(src + p * 4));
+			const __m128i hi = _mm_loadu_si128((const __m128i*)(src + p * 4 + 16));
+			const __m128i r = _mm_packs_epi32(_mm_and_si128(lo, m8), _mm_and_si128(hi, m8));
+			const __m128i g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(lo, 8), m8), _mm_and_si128(_mm_srli_epi32(hi, 8), m8));
+			const __m128i b = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(lo, 16), m8), _mm_and_si128(_mm_srli_epi32(hi, 16), m8));
+			// round(v * max / 255), exact for 0..255
+			const __m128i r5 = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(249)), _mm_set1_epi16(1014)), 11);
+			const __m128i g6 = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(g, _mm_set1_epi16(253)), _mm_set1_epi16(505)), 10);
+			const __m128i b5 = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(249)), _mm_set1_epi16(1014)), 11);
+			_mm_storeu_si128((__m128i*)(dst + p * 2), _mm_or_si128(_mm_or_si128(_mm_slli_epi16(r5, 11), _mm_slli_epi16(g6, 5)), b5));
+		}
+#endif
+		using T = pixel_traits<ALLEGRO_PIXEL_FORMAT_RGB_565>;
+		for (; p < count; ++p) {
+			pixel_rgba8 c;
+			memcpy(&c, src + p * 4, 4);
+			const T::type px = T::pack(c);
+			memcpy(dst + p * 2, &px, 2);
+		}
+	}
+
+	static void f32_to_rgba8(const uint8_t* src, uint8_t* dst, const size_t count)
+	{
+		size_t p = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+		for (; p + 4 <= count; p += 4) {
+			__m128i q[4];
+			for (int k = 0; k < 4; ++k) {
+				__m128 f = _mm_loadu_ps((const float*)(src + (p + k) * 16));
+				f = _mm_min_ps(_mm_max_ps(f, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+				q[k] = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(f, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+			}
+			_mm_storeu_si128((__m128i*)(dst + p * 4), _mm_packus_epi16(_mm_packs_epi32(q[0], q[1]), _mm_packs_epi32(q[2], q[3])));
+		}
+#endif
+		using T = pixel_traits<ALLEGRO_PIXEL_FORMAT_ABGR_F32>;
+		for (; p < count; ++p) {
+			T::type px;
+			memcpy(&px, src + p * 16, 16);
+			const pixel_rgba8 c = T::unpack(px);
+			memcpy(dst + p * 4, &c, 4);
+		}
+	}
+
+	static void rgba8_to_f32(const uint8_t* src, uint8_t* dst, const size_t count)
+	{
+		size_t p = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+		const __m128 div = _mm_set1_ps(255.0f);
+		const __m128i zero = _mm_setzero_si128();
+		for (; p + 4 <= count; p += 4) {
+			const __m128i v = _mm_loadu_si128((const __m128i*)(src + p * 4));
+			const __m128i lo = _mm_unpacklo_epi8(v, zero);
+			const __m128i hi = _mm_unpackhi_epi8(v, zero);
+			const __m128i px[4] = { _mm_unpacklo_epi16(lo, zero), _mm_unpackhi_epi16(lo, zero), _mm_unpacklo_epi16(hi, zero), _mm_unpackhi_epi16(hi, zero) };
+			for (int k = 0; k < 4; ++k) _mm_storeu_ps((float*)(dst + (p + k) * 16), _mm_div_ps(_mm_cvtepi32_ps(px[k]), div));
+		}
+#endif
+		using T = pixel_traits<ALLEGRO_PIXEL_FORMAT_ABGR_F32>;
+		for (; p < count; ++p) {
+			pixel_rgba8 c;
+			memcpy(&c, src + p * 4, 4);
+			const T::type px = T::pack(c);
+			memcpy(dst + p * 16, &px, 16);
+		}
+	}
+
+	template<int Format>
+	static void generic_to_rgba8(const uint8_t* src, uint8_t* dst, const size_t count)
+	{
+		using T = pixel_traits<Format>;
+		for (size_t p = 0; p < count; ++p) {
+			typename T::type px;
+			memcpy(&px, src + p * T::bytes, T::bytes);
+			const pixel_rgba8 c = T::unpack(px);
+			memcpy(dst + p * 4, &c, 4);
+		}
+	}
+
+	template<int Format>
+	static void generic_from_rgba8(const uint8_t* src, uint8_t* dst, const size_t count)
+	{
+		using T = pixel_traits<Format>;
+		for (size_t p = 0; p < count; ++p) {
+			pixel_rgba8 c;
+			memcpy(&c, src + p * 4, 4);
+			const typename T::type px = T::pack(c);
+			memcpy(dst + p * T::bytes, &px, T::bytes);
+		}
+	}
+
+	struct _format_ops {
+		int format;
+		size_t bytes;
+		void (*to)(const uint8_t*, uint8_t*, size_t);
+		void (*from)(const uint8_t*, uint8_t*, size_t);
+	};
+
+	template<int Format>
+	constexpr _format_ops generic_ops() { return { Format, pixel_traits<Format>::bytes, &generic_to_rgba8<Format>, &generic_from_rgba8<Format> }; }
+
+	static const _format_ops* find_ops(const int format)
+	{
+		static const _format_ops ops[] = {
+			generic_ops<ALLEGRO_PIXEL_FORMAT_ARGB_8888>(), // 32 bit ones are taken by the swizzle first, these are for big endian
+			generic_ops<ALLEGRO_PIXEL_FORMAT_RGBA_8888>(),
+			generic_ops<ALLEGRO_PIXEL_FORMAT_ABGR_8888>(),
+			generic_ops<ALLEGRO_PIXEL_FORMAT_XRGB_8888>(),
+			generic_ops<ALLEGRO_PIXEL_FORMAT_XBGR_8888>(),
+			generic_ops<ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE>(),
+			{ ALLEGRO_PIXEL_FORMAT_RGB_565, 2, &rgb565_to_rgba8, &rgba8_to_rgb565 },
+			generic_ops<ALLEGRO_PIXEL_FORMAT_RGBA_4444>(),
+			generic_ops<ALLEGRO_PIXEL_FORMAT_ARGB_4444>(),
+			generic_ops<ALLEGRO_PIXEL_FORMAT_RGBA_5551>(),
+			generic_ops<ALLEGRO_PIXEL_FORMAT_SINGLE_CHANNEL_8>(),
+			{ ALLEGRO_PIXEL_FORMAT_ABGR_F32, 16, &f32_to_rgba8, &rgba8_to_f32 }
+		};
+		for (const auto& i : ops) {
+			if (i.format == format) return &i;
+		}
+		return nullptr;
+	}
+
+	static void to_rgba8(const _format_ops& op, const uint8_t* src, uint8_t* dst, const size_t count)
+	{
+		_layout32 l;
+		if (layout32(op.format, l)) swizzle_to_rgba8(l, src, dst, count);
+		else op.to(src, dst, count);
+	}
+
+	static void from_rgba8(const _format_ops& op, const uint8_t* src, uint8_t* dst, const size_t count)
+	{
+		_layout32 l;
+		if (layout32(op.format, l)) swizzle_from_rgba8(l, src, dst, count);
+		else op.from(src, dst, count);
+	}
+
+	bool pixel_convert_supported(const int src_format, const int dst_format)
+	{
+		return find_ops(src_format) && find_ops(dst_format);
+	}
+
+	bool convert_pixels(const void* src, const int src_format, void* dst, const int dst_format, const size_t count)
+	{
+		const _format_ops* so = find_ops(src_format);
+		const _format_ops* d_o = find_ops(dst_format);
+		if (!so || !d_o || (!src && count) || (!dst && count)) return false;
+		if (count == 0) return true;
+
+		const uint8_t* s = static_cast<const uint8_t*>(src);
+		uint8_t* d = static_cast<uint8_t*>(dst);
+
+		if (src_format == dst_format) {
+			memmove(d, s, count * so->bytes);
+			return true;
+		}
+
+		_layout32 ls, ld;
+		if (layout32(src_format, ls) && layout32(dst_format, ld)) { // one shuffle
+			int idx[4] = { -1, -1, -1, -1 };
+			idx[ld.r] = ls.r;
+			idx[ld.g] = ls.g;
+			idx[ld.b] = ls.b;
+			uint32_t fill = 0;
+			if (ld.a >= 0) {
+				if (ls.a >= 0) idx[ld.a] = ls.a;
+				else fill = 0xFFu << (ld.a * 8);
+			}
+			swizzle32(s, d, count, idx, fill);
+			return true;
+		}
+
+		alignas(16) uint8_t tmp[convert_chunk * 4];
+		for (size_t p = 0; p < count; p += convert_chunk) {
+			const size_t now = (std::min)(convert_chunk, count - p);
+			to_rgba8(*so, s + p * so->bytes, tmp, now);
+			from_rgba8(*d_o, tmp, d + p * d_o->bytes, now);
+		}
+		return true;
+	}
+
+	bool convert_pixels(const void* src, const int src_pitch, const int src_format, void* dst, const int dst_pitch, const int dst_format, const int width, const int height)
+	{
+		if (!pixel_convert_supported(src_format, dst_format) || width < 0 || height < 0) return false;
+		const uint8_t* s = static_cast<const uint8_t*>(src);
+		uint8_t* d = static_cast<uint8_t*>(dst);
+		for (int y = 0; y < height; ++y) {
+			if (!convert_pixels(s + static_cast<ptrdiff_t>(y) * src_pitch, src_format, d + static_cast<ptrdiff_t>(y) * dst_pitch, dst_format, static_cast<size_t>(width))) return false;
+		}
+		return true;
+	}
+
+	bool convert_pixels(const Locked_region& src, Locked_region& dst)
+	{
+		if (!src.get_data() || !dst.get_data()) return false;
+		const int w = (std::min)(src.get_width(), dst.get_width());
+		const int h = (std::min)(src.get_height(), dst.get_height());
+		return convert_pixels(src.get_data(), src.get_pitch(), src.get_format(), dst.get_data(), dst.get_pitch(), dst.get_format(), w, h);
+	}
+
+	static void premultiply32(uint8_t* data, const size_t count, const int a)
+	{
+		size_t p = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i round = _mm_set1_epi16(128);
+		// 16 bit lanes of the alpha channel in two pixels
+		const __m128i alpha_lanes = _mm_set_epi16(a == 3 ? -1 : 0, a == 2 ? -1 : 0, a == 1 ? -1 : 0, a == 0 ? -1 : 0, a == 3 ? -1 : 0, a == 2 ? -1 : 0, a == 1 ? -1 : 0, a == 0 ? -1 : 0);
+		const __m128i keep = _mm_and_si128(alpha_lanes, _mm_set1_epi16(255)); // alpha times 255 stays alpha
+		const auto mul = [&](const __m128i x) {
+			__m128i m;
+			switch (a) { // broadcast each pixel's alpha to its 4 lanes
+			case 0: m = _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, 0x00), 0x00); break;
+			case 1: m = _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, 0x55), 0x55); break;
+			case 2: m = _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, 0xAA), 0xAA); break;
+			default: m = _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, 0xFF), 0xFF); break;
+			}
+			m = _mm_or_si128(_mm_andnot_si128(alpha_lanes, m), keep);
+			const __m128i t = _mm_add_epi16(_mm_mullo_epi16(x, m), round);
+			return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8); // exact /255
+		};
+		for (; p + 4 <= count; p += 4) {
+			const __m128i v = _mm_loadu_si128((const __m128i*)(data + p * 4));
+			_mm_storeu_si128((__m128i*)(data + p * 4), _mm_packus_epi16(mul(_mm_unpacklo_epi8(v, zero)), mul(_mm_unpackhi_epi8(v, zero))));
+		}
+#endif
+		for (; p < count; ++p) {
+			uint8_t* px = data + p * 4;
+			const unsigned al = px[a];
+			for (int k = 0; k < 4; ++k) {
+				if (k == a) continue;
+				const unsigned t = px[k] * al + 128;
+				px[k] = static_cast<uint8_t>((t + (t >> 8)) >> 8);
+			}
+		}
+	}
+
+	static void unpremultiply32(uint8_t* data, const size_t count, const int a)
+	{
+		for (size_t p = 0; p < count; ++p) {
+			uint8_t* px = data + p * 4;
+			const unsigned al = px[a];
+			if (al == 255) continue;
+			for (int k = 0; k < 4; ++k) {
+				if (k == a) continue;
+				px[k] = al == 0 ? 0 : static_cast<uint8_t>((std::min)(255u, (px[k] * 255u + al / 2) / al));
+			}
+		}
+	}
+
+	static bool alpha_pass(void* data, const int format, const size_t count, const bool premul)
+	{
+		const _format_ops* op = find_ops(format);
+		if (!op || (!data && count)) return false;
+		uint8_t* d = static_cast<uint8_t*>(data);
+
+		_layout32 l;
+		if (layout32(format, l)) {
+			if (l.a >= 0) premul ? premultiply32(d, count, l.a) : unpremultiply32(d, count, l.a);
+			return true;
+		}
+		if (format == ALLEGRO_PIXEL_FORMAT_ABGR_F32) {
+			for (size_t p = 0; p < count; ++p) {
+				float f[4];
+				memcpy(f, d + p * 16, 16);
+				for (int k = 0; k < 3; ++k) f[k] = premul ? f[k] * f[3] : (f[3] > 0.0f ? f[k] / f[3] : 0.0f);
+				memcpy(d + p * 16, f, 16);
+			}
+			return true;
+		}
+		if (format == ALLEGRO_PIXEL_FORMAT_RGB_565 || format == ALLEGRO_PIXEL_FORMAT_SINGLE_CHANNEL_8) return true; // no alpha
+
+		alignas(16) uint8_t tmp[convert_chunk * 4];
+		for (size_t p = 0; p < count; p += convert_chunk) {
+			const size_t now = (std::min)(convert_chunk, count - p);
+			op->to(d + p * op->bytes, tmp, now);
+			premul ? premultiply32(tmp, now, 3) : unpremultiply32(tmp, now, 3);
+			op->from(tmp, d + p * op->bytes, now);
+		}
+		return true;
+	}
+
+	static bool alpha_pass(Locked_region& lr, const bool premul)
+	{
+		uint8_t* d = static_cast<uint8_t*>(lr.get_data());
+		if (!d) return false;
+		for (int y = 0; y < lr.get_height(); ++y) {
+			if (!alpha_pass(d + static_cast<ptrdiff_t>(y) * lr.get_pitch(), lr.get_format(), static_cast<size_t>(lr.get_width()), premul)) return false;
+		}
+		return true;
+	}
+
+	bool premultiply_alpha(void* data, const int format, const size_t count)
+	{
+		return alpha_pass(data, format, count, true);
+	}
+
+	bool premultiply_alpha(Locked_region& lr)
+	{
+		return alpha_pass(lr, true);
+	}
+
+	bool unpremultiply_alpha(void* data, const int format, const size_t count)
+	{
+		return alpha_pass(data, format, count, false);
+	}
+
+	bool unpremultiply_alpha(Locked_region& lr)
+	{
+		return alpha_pass(lr, false);
+	}
+
+}
\ No newline at end of file
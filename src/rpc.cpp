@@ -0,0 +1,317 @@
+#include "rpc.h"
+#include "binary_stream.h"
+
+#ifndef ALLEGROCPP_DISABLE_FILESOCKET
+
+#include <utility>
+
+namespace AllegroCPP {
+
+	namespace _rpc {
+
+		connection::connection(File_client&& s)
+			: sock(std::move(s))
+		{
+			sock.set_timeout_write(static_cast<unsigned long>(send_timeout * 1000.0)); // a peer that stops reading can't hold send() (and mtx) forever
+		}
+
+		bool connection::send(const uint32_t id, const uint32_t code, const void* data, const size_t len)
+		{
+			if (len > max_payload) return false;
+
+			std::vector<uint8_t> frame;
+			frame.reserve(header_size + len);
+			{
+				Binary_memory_writer w(frame);
+				w.u32le(static_cast<uint32_t>(len));
+				w.u32le(id);
+				w.u32le(code);
+				w.bytes(data, len);
+			}
+
+			std::lock_guard<std::mutex> l(mtx);
+			const double deadline = al_get_time() + send_timeout;
+			size_t done = 0;
+			while (done < frame.size() && open) {
+				const size_t now = sock.write_some(frame.data() + done, frame.size() - done);
+				done += now;
+				if (done == frame.size()) break;
+				if (!sock.valid() || al_get_time() > deadline) break;
+				if (now == 0) al_rest(0.001); // rate limited, a partial frame would break the stream
+			}
+			if (done == frame.size()) return true;
+			open = false;
+			return false;
+		}
+
+		bool connection::pump(const std::function<void(uint32_t, uint32_t, std::vector<uint8_t>&&)>& fn)
+		{
+			if (!open) return false;
+			if (!sock.wait_for_data(20)) return true;
+
+			uint8_t buf[1 << 14];
+			size_t got = 0;
+			{
+				std::lock_guard<std::mutex> l(mtx);
+				got = sock.read(buf, sizeof(buf));
+			}
+			if (got == 0) {
+				open = false;
+				return false;
+			}
+			in.insert(in.end(), buf, buf + got);
+
+			size_t off = 0;
+			while (in.size() - off >= header_size) {
+				Binary_memory_reader r(in.data() + off, header_size);
+				const uint32_t size = r.u32le();
+				const uint32_t id = r.u32le();
+				const uint32_t code = r.u32le();
+
+				if (size > max_payload) { // garbage or not our protocol
+					open = false;
+					return false;
+				}
+				if (in.size() - off - header_size < size) break;
+
+				const auto beg = in.begin() + static_cast<ptrdiff_t>(off + header_size);
+				fn(id, code, std::vector<uint8_t>(beg, beg + size));
+				off += header_size + size;
+			}
+			in.erase(in.begin(), in.begin() + static_cast<ptrdiff_t>(off));
+			return true;
+		}
+
+	}
+
+	Rpc_client::Rpc_client(File_client&& connected, const int event_id)
+		: m_event_id(event_id)
+	{
+		if (!ALLEGRO_EVENT_TYPE_IS_USER(event_id)) throw std::invalid_argument("ID must be a USER_TYPE type to work (must follow macro ALLEGRO_EVENT_TYPE_IS_USER(X))");
+		if (!connected.valid()) throw std::invalid_argument("Client is not connected!");
+		m_conn = std::make_shared<_rpc::connection>(std::move(connected));
+
+		m_reader.create([this] {
+			if (m_conn->pump([this](uint32_t id, uint32_t code, std::vector<uint8_t>&& data) { finish({ id, static_cast<rpc_status>(code), std::move(data) }); })) return true;
+			fail_all();
+			return false;
+		}, Thread::Mode::NORMAL);
+	}
+
+	Rpc_client::Rpc_client(const std::string& addr, const uint16_t port, const int event_id)
+		: Rpc_client(File_client(addr, port, file_protocol::TCP), event_id)
+	{
+	}
+
+	Rpc_client::~Rpc_client()
+	{
+		close();
+	}
+
+	uint32_t Rpc_client::start(const uint32_t method, const void* data, const size_t len, _waiter&& w)
+	{
+		uint32_t id = 0;
+		{
+			std::lock_guard<std::mutex> l(m_wait_mtx);
+			if (m_conn->open) {
+				id = m_next_id++;
+				if (m_next_id == 0) m_next_id = 1;
+				m_waiting.emplace(id, std::move(w)); // before sending, the reply can be quick
+			}
+		}
+		if (id != 0 && m_conn->send(id, method, data, len)) return id;
+
+		if (id != 0) {
+			std::lock_guard<std::mutex> l(m_wait_mtx);
+			auto it = m_waiting.find(id);
+			if (it == m_waiting.end()) return 0; // already failed by the reader
+			w = std::move(it->second);
+			m_waiting.erase(it);
+		}
+		if (w.promise) w.promise->set_value({ id, rpc_status::DISCONNECTED, {} });
+		return 0;
+	}
+
+	void Rpc_client::finish(rpc_response&& res)
+	{
+		_waiter w;
+		{
+			std::lock_guard<std::mutex> l(m_wait_mtx);
+			auto it = m_waiting.find(res.id);
+			if (it == m_waiting.end()) return; // not ours
+			w = std::move(it->second);
+			m_waiting.erase(it);
+		}
+		if (w.promise) w.promise->set_value(std::move(res));
+		else m_event.emit(std::any(std::move(res)), m_event_id);
+	}
+
+	void Rpc_client::fail_all()
+	{
+		std::unordered_map<uint32_t, _waiter> all;
+		{
+			std::lock_guard<std::mutex> l(m_wait_mtx);
+			all.swap(m_waiting);
+		}
+		for (auto& i : all) {
+			rpc_response res{ i.first, rpc_status::DISCONNECTED, {} };
+			if (i.second.promise) i.second.promise->set_value(std::move(res));
+			else m_event.emit(std::any(std::move(res)), m_event_id);
+		}
+	}
+
+	std::future<rpc_response> Rpc_client::call(const uint32_t method, const void* data, const size_t len)
+	{
+		_waiter w;
+		w.promise.emplace();
+		auto fut = w.promise->get_future();
+		start(method, data, len, std::move(w));
+		return fut;
+	}
+
+	std::future<rpc_response> Rpc_client::call(const uint32_t method, const std::vector<uint8_t>& data)
+	{
+		return call(method, data.data(), data.size());
+	}
+
+	uint32_t Rpc_client::call_event(const uint32_t method, const void* data, const size_t len)
+	{
+		return start(method, data, len, _waiter{});
+	}
+
+	uint32_t Rpc_client::call_event(const uint32_t method, const std::vector<uint8_t>& data)
+	{
+		return call_event(method, data.data(), data.size());
+	}
+
+	size_t Rpc_client::in_flight()
+	{
+		std::lock_guard<std::mutex> l(m_wait_mtx);
+		return m_waiting.size();
+	}
+
+	bool Rpc_client::connected() const
+	{
+		return m_conn && m_conn->open;
+	}
+
+	void Rpc_client::close()
+	{
+		if (!m_conn) return;
+		m_conn->open = false;
+		m_reader.join();
+		fail_all();
+
+		std::lock_guard<std::mutex> l(m_conn->mtx);
+		m_conn->sock.close();
+	}
+
+	Rpc_client::operator ALLEGRO_EVENT_SOURCE* () const
+	{
+		return m_event;
+	}
+
+	Rpc_server::Rpc_server(const uint16_t port, handler fn, Thread_pool* pool)
+		: m_handler(std::move(fn)), m_pool(pool ? pool : &Thread_pool::global())
+	{
+		if (!al_is_system_installed()) al_init();
+		if (!m_handler) throw std::invalid_argument("Handler is empty!");
+
+		m_host = std::make_unique<File_host>(port, file_protocol::TCP);
+		if (!m_host->valid()) throw std::runtime_error("Could not listen on port!");
+
+		m_accepter.create([this] { return accept_once(); }, Thread::Mode::NORMAL);
+	}
+
+	Rpc_server::~Rpc_server()
+	{
+		stop();
+	}
+
+	bool Rpc_server::accept_once()
+	{
+		if (!m_running) return false;
+
+		File_client c = m_host->listen(100);
+		if (!c.valid()) return true;
+
+		auto cli = std::make_unique<_client>();
+		cli->conn = std::make_shared<_rpc::connection>(std::move(c));
+
+		std::shared_ptr<_rpc::connection> conn = cli->conn;
+		cli->reader.create([this, conn] {
+			if (!m_running) return false;
+			return conn->pump([this, &conn](uint32_t id, uint32_t method, std::vector<uint8_t>&& data) { dispatch(conn, id, method, std::move(data)); });
+		}, Thread::Mode::NORMAL);
+
+		std::lock_guard<std::mutex> l(m_clients_mtx);
+		for (auto it = m_clients.begin(); it != m_clients.end();) { // gone ones
+			if ((*it)->conn->open) ++it;
+			else {
+				(*it)->reader.join();
+				it = m_clients.erase(it);
+			}
+		}
+		m_clients.push_back(std::move(cli));
+		return true;
+	}
+
+	void Rpc_server::dispatch(const std::shared_ptr<_rpc::connection>& conn, const uint32_t id, const uint32_t method, std::vector<uint8_t>&& request)
+	{
+		{
+			std::lock_guard<std::mutex> l(m_tasks_mtx);
+			++m_running_tasks;
+		}
+
+		m_pool->push([this, conn, id, method, req = std::move(request)] {
+			std::vector<uint8_t> reply;
+			rpc_status st = rpc_status::FAILED;
+			try {
+				st = m_handler(method, req, reply);
+			}
+			catch (...) {
+				st = rpc_status::FAILED;
+				reply.clear();
+			}
+			conn->send(id, static_cast<uint32_t>(st), reply.data(), reply.size());
+
+			std::lock_guard<std::mutex> l(m_tasks_mtx);
+			--m_running_tasks;
+			m_tasks_cv.notify_all();
+		});
+	}
+
+	size_t Rpc_server::client_count()
+	{
+		std::lock_guard<std::mutex> l(m_clients_mtx);
+		size_t n = 0;
+		for (const auto& i : m_clients) n += i->conn->open ? 1 : 0;
+		return n;
+	}
+
+	void Rpc_server::stop()
+	{
+		m_running = false;
+		m_accepter.join();
+		{
+			std::lock_guard<std::mutex> l(m_clients_mtx);
+			for (auto& i : m_clients) i->reader.join();
+		}
+		{
+			std::unique_lock<std::mutex> l(m_tasks_mtx);
+			m_tasks_cv.wait(l, [this] { return m_running_tasks == 0; });
+		}
+
+		std::lock_guard<std::mutex> l(m_clients_mtx);
+		for (auto& i : m_clients) {
+			i->conn->open = false;
+			std::lock_guard<std::mutex> cl(i->conn->mtx);
+			i->conn->sock.close();
+		}
+		m_clients.clear();
+		m_host.reset();
+	}
+
+}
+
+#endif // ALLEGROCPP_DISABLE_FILESOCKET
\ No newline at end of file
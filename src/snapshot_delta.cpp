@@ -0,0 +1,198 @@
+#include "snapshot_delta.h"
+#include "binary_stream.h"
+#include "cpu_features.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <bit>
+
+namespace AllegroCPP {
+
+	constexpr size_t delta_min_skip = 4; // shorter equal stretches stay inside the literal, a skip costs about as much
+	constexpr size_t delta_block = 4096;
+
+#ifdef ALLEGROCPP_X86
+	// run_length over the whole 32 byte blocks of n: where it stops, or the end of the last block.
+	template<bool Equal>
+	ALLEGROCPP_TARGET("avx2")
+	static size_t run_length_avx2(const uint8_t* a, const uint8_t* b, const size_t n)
+	{
+		size_t p = 0;
+		for (; p + 32 <= n; p += 32) {
+			const uint32_t eq = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(a + p)), _mm256_loadu_si256((const __m256i*)(b + p)))));
+			const uint32_t stop = Equal ? ~eq : eq;
+			if (stop) return p + std::countr_zero(stop);
+		}
+		return p;
+	}
+
+	static const bool delta_avx2 = _cpu_features::get().avx2; // run_length is called once per run, don't ask every time
+#endif
+
+	// Leading bytes where a and b are equal (Equal) or differ (!Equal).
+	template<bool Equal>
+	static size_t run_length(const uint8_t* a, const uint8_t* b, const size_t n)
+	{
+		size_t p = 0;
+#ifdef ALLEGROCPP_X86
+		if (delta_avx2) {
+			p = run_length_avx2<Equal>(a, b, n);
+			if (p < (n & ~static_cast<size_t>(31))) return p;
+		}
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+		for (; p + 16 <= n; p += 16) {
+			const uint32_t eq = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + p)), _mm_loadu_si128((const __m128i*)(b + p)))));
+			const uint32_t stop = (Equal ? ~eq : eq) & 0xFFFF;
+			if (stop) return p + std::countr_zero(stop);
+		}
+#else
+		if constexpr (std::endian::native == std::endian::little) {
+			for (; p + 8 <= n; p += 8) {
+				uint64_t x, y;
+				memcpy(&x, a + p, 8);
+				memcpy(&y, b + p, 8);
+				uint64_t d = x ^ y;
+				if constexpr (!Equal) { // high bit of each byte set where the byte is zero (equal)
+					d = ~(((d & 0x7F7F7F7F7F7F7F7Full) + 0x7F7F7F7F7F7F7F7Full) | d | 0x7F7F7F7F7F7F7F7Full);
+				}
+				if (d) return p + std::countr_zero(d) / 8;
+			}
+		}
+#endif
+		for (; p < n; ++p) {
+			if ((a[p] == b[p]) != Equal) break;
+		}
+		return p;
+	}
+
+	// Same, over current[pos, len) against the baseline, zero past its end.
+	template<bool Equal>
+	static size_t scan(const uint8_t* base, const size_t base_len, const uint8_t* cur, const size_t pos, const size_t len)
+	{
+		static const uint8_t zeros[256] = {};
+		size_t p = pos;
+		while (p < len) {
+			const uint8_t* b = zeros;
+			size_t n = (std::min)(len - p, sizeof(zeros));
+			if (p < base_len) {
+				b = base + p;
+				n = (std::min)(len, base_len) - p;
+			}
+			const size_t got = run_length<Equal>(cur + p, b, n);
+			p += got;
+			if (got < n) break;
+		}
+		return p - pos;
+	}
+
+	bool snapshot_delta_encode(File& out, const void* baseline, const size_t baseline_len, const void* current, const size_t current_len, snapshot_delta_stats* stats)
+	{
+		const uint8_t* base = static_cast<const uint8_t*>(baseline);
+		const uint8_t* cur = static_cast<const uint8_t*>(current);
+		snapshot_delta_stats st;
+		const int64_t start = out.tell();
+
+		{
+			Binary_file_writer w(out);
+			w.varint(current_len);
+			w.varint(baseline_len);
+
+			uint8_t block[delta_block];
+			size_t pos = 0;
+			while (pos < current_len) {
+				const size_t skip = scan<true>(base, baseline_len, cur, pos, current_len);
+				const size_t lit_beg = pos + skip;
+
+				// literal goes on until an equal stretch worth a skip, or the end
+				size_t lit_end = lit_beg;
+				while (lit_end < current_len) {
+					lit_end += scan<false>(base, baseline_len, cur, lit_end, current_len);
+					const size_t same = scan<true>(base, baseline_len, cur, lit_end, current_len);
+					if (same >= delta_min_skip || lit_end + same == current_len) break;
+					lit_end += same;
+				}
+
+				w.varint(skip);
+				w.varint(lit_end - lit_beg);
+				for (size_t p = lit_beg; p < lit_end;) {
+					const size_t now = (std::min)(lit_end - p, delta_block);
+					const size_t with_base = p < baseline_len ? (std::min)(now, baseline_len - p) : 0;
+					for (size_t i = 0; i < with_base; ++i) block[i] = cur[p + i] ^ base[p + i];
+					memcpy(block + with_base, cur + p + with_base, now - with_base);
+					w.bytes(block, now);
+					p += now;
+				}
+
+				if (lit_end > lit_beg) {
+					++st.runs;
+					st.changed += lit_end - lit_beg;
+				}
+				pos = lit_end;
+			}
+
+			if (!w.flush()) return false;
+		}
+
+		if (stats) {
+			const int64_t end = out.tell();
+			st.bytes = (start >= 0 && end >= start) ? static_cast<size_t>(end - start) : 0;
+			*stats = st;
+		}
+		return true;
+	}
+
+	bool snapshot_delta_encode(File& out, const std::vector<uint8_t>& baseline, const std::vector<uint8_t>& current, snapshot_delta_stats* stats)
+	{
+		return snapshot_delta_encode(out, baseline.data(), baseline.size(), current.data(), current.size(), stats);
+	}
+
+	bool snapshot_delta_decode(File& in, const void* baseline, const size_t baseline_len, std::vector<uint8_t>& current, const size_t max_len)
+	{
+		const uint8_t* base = static_cast<const uint8_t*>(baseline);
+		Binary_file_reader r(in);
+
+		const uint64_t len = r.varint();
+		const uint64_t blen = r.varint();
+		if (!r.good() || blen != baseline_len || len > max_len || len > current.max_size()) return false;
+
+		current.assign(static_cast<size_t>(len), 0);
+		if (!current.empty() && baseline_len > 0) memcpy(current.data(), base, (std::min)(current.size(), baseline_len));
+
+		uint8_t block[delta_block];
+		size_t pos = 0;
+		bool ok = true;
+		while (ok && pos < current.size()) {
+			const uint64_t skip = r.varint();
+			const uint64_t lit = r.varint();
+			if (!r.good() || (skip == 0 && lit == 0) || skip > current.size() - pos || lit > current.size() - pos - skip) {
+				ok = false;
+				break;
+			}
+			pos += static_cast<size_t>(skip);
+
+			for (size_t left = static_cast<size_t>(lit); left > 0;) {
+				const size_t now = (std::min)(left, delta_block);
+				if (!r.bytes(block, now)) {
+					ok = false;
+					break;
+				}
+				uint8_t* dst = current.data() + pos;
+				for (size_t i = 0; i < now; ++i) dst[i] ^= block[i];
+				pos += now;
+				left -= now;
+			}
+		}
+
+		if (r.buffered() > 0) in.seek(-static_cast<int64_t>(r.buffered()), ALLEGRO_SEEK_CUR); // reader took more than the delta
+		if (!ok) current.clear();
+		return ok;
+	}
+
+	bool snapshot_delta_decode(File& in, const std::vector<uint8_t>& baseline, std::vector<uint8_t>& current, const size_t max_len)
+	{
+		return snapshot_delta_decode(in, baseline.data(), baseline.size(), current, max_len);
+	}
+
+}
\ No newline at end of file
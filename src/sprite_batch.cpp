@@ -0,0 +1,169 @@
+#include "sprite_batch.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace AllegroCPP {
+
+	static ALLEGRO_BITMAP* root_texture(ALLEGRO_BITMAP* b)
+	{
+		while (ALLEGRO_BITMAP* p = al_get_parent_bitmap(b)) b = p;
+		return b;
+	}
+
+	static void apply_blend(const sprite_blend_state& s)
+	{
+		al_set_separate_blender(s.op, s.src, s.dst, s.alpha_op, s.alpha_src, s.alpha_dst);
+	}
+
+	Sprite_batch::Sprite_batch(const Mode mode, const size_t reserve)
+		: m_mode(mode)
+	{
+		m_sprites.reserve(reserve);
+		m_order.reserve(reserve);
+	}
+
+	Sprite_batch::Sprite_batch(Sprite_batch&& oth) noexcept
+		: m_sprites(std::move(oth.m_sprites)), m_order(std::move(oth.m_order)), m_blends(std::move(oth.m_blends)), m_mode(oth.m_mode), m_last_groups(oth.m_last_groups)
+	{
+	}
+
+	void Sprite_batch::operator=(Sprite_batch&& oth) noexcept
+	{
+		m_sprites = std::move(oth.m_sprites);
+		m_order = std::move(oth.m_order);
+		m_blends = std::move(oth.m_blends);
+		m_mode = oth.m_mode;
+		m_last_groups = oth.m_last_groups;
+	}
+
+	uint32_t Sprite_batch::current_blend()
+	{
+		sprite_blend_state s{};
+		al_get_separate_blender(&s.op, &s.src, &s.dst, &s.alpha_op, &s.alpha_src, &s.alpha_dst);
+		if (!m_blends.empty() && m_blends.back() == s) return static_cast<uint32_t>(m_blends.size() - 1); // usual case, same as last
+		for (size_t i = 0; i < m_blends.size(); ++i) {
+			if (m_blends[i] == s) return static_cast<uint32_t>(i);
+		}
+		m_blends.push_back(s);
+		return static_cast<uint32_t>(m_blends.size() - 1);
+	}
+
+	bool Sprite_batch::add(const Bitmap& bmp)
+	{
+		ALLEGRO_BITMAP* to_draw = bmp.get_for_draw();
+		if (!to_draw) return false;
+		const auto& p = bmp.m_stored_draw_props;
+		p.check(to_draw);
+		return add(to_draw, p._cut, p._color, p._transf, p._scale, p._pos_and_flag);
+	}
+
+	bool Sprite_batch::add(const Bitmap& bmp, const float target_x, const float target_y, const int flags)
+	{
+		ALLEGRO_BITMAP* to_draw = bmp.get_for_draw();
+		if (!to_draw) return false;
+		const auto& p = bmp.m_stored_draw_props;
+		p.check(to_draw);
+		return add(to_draw, p._cut, p._color, p._transf, p._scale, bitmap_position_and_flags{ target_x, target_y, flags });
+	}
+
+	bool Sprite_batch::add(ALLEGRO_BITMAP* bmp, const bitmap_cut& cut, const ALLEGRO_COLOR tint, const bitmap_rotate_transform& transf, const bitmap_scale& scale, const bitmap_position_and_flags& pos)
+	{
+		if (!bmp) return false;
+
+		bitmap_cut c = cut;
+		if (c.width == 0 || c.height == 0) {
+			c.width = al_get_bitmap_width(bmp);
+			c.height = al_get_bitmap_height(bmp);
+		}
+
+		m_sprites.push_back(_sprite{
+			bmp, root_texture(bmp), current_blend(),
+			static_cast<float>(c.posx), static_cast<float>(c.posy), static_cast<float>(c.width), static_cast<float>(c.height),
+			tint,
+			transf.centerx, transf.centery, pos.target_x, pos.target_y, scale.scalex, scale.scaley, transf.rotationrad,
+			pos.flags
+		});
+		return true;
+	}
+
+	size_t Sprite_batch::flush()
+	{
+		m_last_groups = 0;
+		if (m_sprites.empty()) return 0;
+
+		m_order.resize(m_sprites.size());
+		for (uint32_t i = 0; i < static_cast<uint32_t>(m_order.size()); ++i) m_order[i] = i;
+		if (m_mode == Mode::SORTED) {
+			std::stable_sort(m_order.begin(), m_order.end(), [this](const uint32_t a, const uint32_t b) {
+				const _sprite& sa = m_sprites[a];
+				const _sprite& sb = m_sprites[b];
+				if (sa.blend != sb.blend) return sa.blend < sb.blend;
+				return std::less<ALLEGRO_BITMAP*>()(sa.texture, sb.texture);
+			});
+		}
+
+		sprite_blend_state old{};
+		al_get_separate_blender(&old.op, &old.src, &old.dst, &old.alpha_op, &old.alpha_src, &old.alpha_dst);
+		const bool was_held = al_is_bitmap_drawing_held();
+		if (was_held) al_hold_bitmap_drawing(false);
+
+		uint32_t blend = static_cast<uint32_t>(-1);
+		ALLEGRO_BITMAP* texture = nullptr;
+		for (const uint32_t idx : m_order) {
+			const _sprite& s = m_sprites[idx];
+			if (s.blend != blend || s.texture != texture) {
+				if (m_last_groups > 0) al_hold_bitmap_drawing(false); // draws the group
+				if (s.blend != blend) apply_blend(m_blends[s.blend]);
+				blend = s.blend;
+				texture = s.texture;
+				al_hold_bitmap_drawing(true);
+				++m_last_groups;
+			}
+			al_draw_tinted_scaled_rotated_bitmap_region(s.bmp, s.sx, s.sy, s.sw, s.sh, s.tint, s.cx, s.cy, s.dx, s.dy, s.xscale, s.yscale, s.angle, s.flags);
+		}
+		al_hold_bitmap_drawing(false);
+
+		apply_blend(old);
+		if (was_held) al_hold_bitmap_drawing(true);
+
+		const size_t groups = m_last_groups;
+		clear();
+		m_last_groups = groups;
+		return groups;
+	}
+
+	void Sprite_batch::clear()
+	{
+		m_sprites.clear();
+		m_order.clear();
+		m_blends.clear();
+		m_last_groups = 0;
+	}
+
+	void Sprite_batch::set_mode(const Mode mode)
+	{
+		m_mode = mode;
+	}
+
+	Sprite_batch::Mode Sprite_batch::get_mode() const
+	{
+		return m_mode;
+	}
+
+	size_t Sprite_batch::size() const
+	{
+		return m_sprites.size();
+	}
+
+	bool Sprite_batch::empty() const
+	{
+		return m_sprites.empty();
+	}
+
+	size_t Sprite_batch::last_group_count() const
+	{
+		return m_last_groups;
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,315 @@
+#include "texture_atlas.h"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+namespace AllegroCPP {
+
+	static int layout_int(const Config& cfg, const std::string& section, const std::string& key)
+	{
+		const std::string val = cfg.get(section, key);
+		try {
+			size_t used = 0;
+			const int res = std::stoi(val, &used);
+			if (used == val.size()) return res;
+		}
+		catch (...) {}
+		throw std::runtime_error("Invalid atlas layout!");
+	}
+
+	Texture_atlas::Texture_atlas(const atlas_options& opt)
+		: m_opt(opt)
+	{
+		if (opt.page_width <= 0 || opt.page_height <= 0 || opt.padding < 0 || opt.extrude < 0) throw std::invalid_argument("Invalid atlas options!");
+		if (!al_is_system_installed()) al_init();
+	}
+
+	Texture_atlas::Texture_atlas(const std::string& layout_path, const atlas_options& opt)
+		: m_opt(opt)
+	{
+		if (layout_path.empty()) throw std::invalid_argument("Layout path is empty!");
+		if (!al_is_system_installed()) al_init();
+
+		Config cfg(layout_path);
+		m_opt.page_width = layout_int(cfg, "atlas", "page_width");
+		m_opt.page_height = layout_int(cfg, "atlas", "page_height");
+		m_opt.padding = layout_int(cfg, "atlas", "padding");
+		m_opt.extrude = layout_int(cfg, "atlas", "extrude");
+		const int pages = layout_int(cfg, "atlas", "pages");
+		const int entries = layout_int(cfg, "atlas", "entries");
+		if (m_opt.page_width <= 0 || m_opt.page_height <= 0 || m_opt.padding < 0 || m_opt.extrude < 0 || pages < 0 || entries < 0) throw std::runtime_error("Invalid atlas layout!");
+
+		for (int i = 0; i < pages; ++i) {
+			const std::string file = cfg.get("page." + std::to_string(i), "file");
+			m_pages.push_back(_page{ Bitmap(file, m_opt.flags, m_opt.format), { { 0, 0, m_opt.page_width + m_opt.padding, m_opt.page_height + m_opt.padding } }, 0 });
+		}
+
+		const int e = m_opt.extrude;
+		for (int i = 0; i < entries; ++i) {
+			const std::string sec = "entry." + std::to_string(i);
+			atlas_entry en;
+			en.name = cfg.get(sec, "name");
+			en.page = layout_int(cfg, sec, "page");
+			en.posx = layout_int(cfg, sec, "x");
+			en.posy = layout_int(cfg, sec, "y");
+			en.width = layout_int(cfg, sec, "width");
+			en.height = layout_int(cfg, sec, "height");
+			if (en.name.empty() || m_names.count(en.name) || en.page < 0 || en.page >= pages || en.width <= 0 || en.height <= 0) throw std::runtime_error("Invalid atlas layout!");
+
+			_page& pg = m_pages[static_cast<size_t>(en.page)];
+			occupy(pg, { en.posx - e, en.posy - e, en.width + 2 * e + m_opt.padding, en.height + 2 * e + m_opt.padding });
+			pg.used += static_cast<long long>(en.width) * en.height;
+
+			m_names.emplace(en.name, m_entries.size());
+			m_entries.push_back(std::move(en));
+		}
+	}
+
+	Texture_atlas::Texture_atlas(Texture_atlas&& oth) noexcept
+		: m_opt(oth.m_opt), m_pages(std::move(oth.m_pages)), m_entries(std::move(oth.m_entries)), m_names(std::move(oth.m_names))
+	{
+	}
+
+	void Texture_atlas::operator=(Texture_atlas&& oth) noexcept
+	{
+		m_opt = oth.m_opt;
+		m_pages = std::move(oth.m_pages);
+		m_entries = std::move(oth.m_entries);
+		m_names = std::move(oth.m_names);
+	}
+
+	Texture_atlas::_page& Texture_atlas::new_page()
+	{
+		Bitmap bmp(m_opt.page_width, m_opt.page_height, m_opt.flags, m_opt.format);
+		bmp.clear_to_color(al_map_rgba(0, 0, 0, 0));
+		// padding may hang off the right and bottom edges
+		m_pages.push_back(_page{ std::move(bmp), { { 0, 0, m_opt.page_width + m_opt.padding, m_opt.page_height + m_opt.padding } }, 0 });
+		return m_pages.back();
+	}
+
+	bool Texture_atlas::find_slot(const _page& pg, const int w, const int h, _rect& out) const
+	{
+		int best_short = (std::numeric_limits<int>::max)();
+		int best_long = (std::numeric_limits<int>::max)();
+		for (const auto& f : pg.free) {
+			if (f.w < w || f.h < h) continue;
+			const int short_side = (std::min)(f.w - w, f.h - h);
+			const int long_side = (std::max)(f.w - w, f.h - h);
+			if (short_side < best_short || (short_side == best_short && long_side < best_long)) {
+				best_short = short_side;
+				best_long = long_side;
+				out = { f.x, f.y, w, h };
+			}
+		}
+		return best_short != (std::numeric_limits<int>::max)();
+	}
+
+	void Texture_atlas::occupy(_page& pg, const _rect& u)
+	{
+		std::vector<_rect> next;
+		next.reserve(pg.free.size() + 4);
+
+		for (const auto& f : pg.free) {
+			if (u.x >= f.x + f.w || u.x + u.w <= f.x || u.y >= f.y + f.h || u.y + u.h <= f.y) {
+				next.push_back(f);
+				continue;
+			}
+			// what is left of f around u, overlapping each other (maximal rectangles)
+			if (u.x > f.x) next.push_back({ f.x, f.y, u.x - f.x, f.h });
+			if (u.x + u.w < f.x + f.w) next.push_back({ u.x + u.w, f.y, f.x + f.w - (u.x + u.w), f.h });
+			if (u.y > f.y) next.push_back({ f.x, f.y, f.w, u.y - f.y });
+			if (u.y + u.h < f.y + f.h) next.push_back({ f.x, u.y + u.h, f.w, f.y + f.h - (u.y + u.h) });
+		}
+
+		// drop the ones inside another
+		std::vector<bool> gone(next.size(), false);
+		for (size_t i = 0; i < next.size(); ++i) {
+			if (gone[i]) continue;
+			const _rect& a = next[i];
+			for (size_t j = 0; j < next.size(); ++j) {
+				if (i == j || gone[j]) continue;
+				const _rect& b = next[j];
+				if (a.x >= b.x && a.y >= b.y && a.x + a.w <= b.x + b.w && a.y + a.h <= b.y + b.h) {
+					gone[i] = true;
+					break;
+				}
+			}
+		}
+
+		pg.free.clear();
+		for (size_t i = 0; i < next.size(); ++i) {
+			if (!gone[i]) pg.free.push_back(next[i]);
+		}
+	}
+
+	void Texture_atlas::copy_in(_page& pg, ALLEGRO_BITMAP* src, const int x, const int y) const
+	{
+		const float w = static_cast<float>(al_get_bitmap_width(src));
+		const float h = static_cast<float>(al_get_bitmap_height(src));
+		const float fx = static_cast<float>(x);
+		const float fy = static_cast<float>(y);
+		const float e = static_cast<float>(m_opt.extrude);
+
+		ALLEGRO_STATE st;
+		al_store_state(&st, ALLEGRO_STATE_TARGET_BITMAP | ALLEGRO_STATE_BLENDER | ALLEGRO_STATE_TRANSFORM);
+		al_set_target_bitmap(pg.bmp.get_for_draw());
+		al_use_transform(nullptr);
+		al_set_blender(ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_ZERO); // copy, alpha included
+
+		al_draw_bitmap(src, fx, fy, 0);
+		if (m_opt.extrude > 0) { // edge rows and columns stretched outwards, then the corners
+			al_draw_scaled_bitmap(src, 0, 0, 1, h, fx - e, fy, e, h, 0);
+			al_draw_scaled_bitmap(src, w - 1, 0, 1, h, fx + w, fy, e, h, 0);
+			al_draw_scaled_bitmap(src, 0, 0, w, 1, fx, fy - e, w, e, 0);
+			al_draw_scaled_bitmap(src, 0, h - 1, w, 1, fx, fy + h, w, e, 0);
+			al_draw_scaled_bitmap(src, 0, 0, 1, 1, fx - e, fy - e, e, e, 0);
+			al_draw_scaled_bitmap(src, w - 1, 0, 1, 1, fx + w, fy - e, e, e, 0);
+			al_draw_scaled_bitmap(src, 0, h - 1, 1, 1, fx - e, fy + h, e, e, 0);
+			al_draw_scaled_bitmap(src, w - 1, h - 1, 1, 1, fx + w, fy + h, e, e, 0);
+		}
+
+		al_restore_state(&st);
+	}
+
+	Bitmap Texture_atlas::insert(const std::string& name, const Bitmap& image)
+	{
+		if (name.empty()) throw std::invalid_argument("Name is empty!");
+		if (m_names.count(name)) throw std::invalid_argument("Name is already in the atlas!");
+		ALLEGRO_BITMAP* src = image.get_for_draw();
+		if (!src) throw std::invalid_argument("Bitmap is empty!");
+
+		const int w = al_get_bitmap_width(src);
+		const int h = al_get_bitmap_height(src);
+		const int e = m_opt.extrude;
+		const int sw = w + 2 * e + m_opt.padding;
+		const int sh = h + 2 * e + m_opt.padding;
+		if (sw > m_opt.page_width + m_opt.padding || sh > m_opt.page_height + m_opt.padding) throw std::invalid_argument("Bitmap doesn't fit an atlas page!");
+
+		size_t page_idx = m_pages.size();
+		_rect slot{};
+		for (size_t i = 0; i < m_pages.size(); ++i) { // earlier pages first, they fill up before a new one is used
+			if (find_slot(m_pages[i], sw, sh, slot)) {
+				page_idx = i;
+				break;
+			}
+		}
+		if (page_idx == m_pages.size()) {
+			new_page();
+			if (!find_slot(m_pages.back(), sw, sh, slot)) throw std::runtime_error("Atlas page has no room!"); // can't happen, checked size above
+		}
+
+		_page& pg = m_pages[page_idx];
+		occupy(pg, slot);
+		copy_in(pg, src, slot.x + e, slot.y + e);
+		pg.used += static_cast<long long>(w) * h;
+
+		atlas_entry en;
+		en.name = name;
+		en.page = static_cast<int>(page_idx);
+		en.posx = slot.x + e;
+		en.posy = slot.y + e;
+		en.width = w;
+		en.height = h;
+		m_names.emplace(name, m_entries.size());
+		m_entries.push_back(std::move(en));
+
+		return Bitmap(pg.bmp, slot.x + e, slot.y + e, w, h, m_opt.flags, m_opt.format);
+	}
+
+	Bitmap Texture_atlas::insert(const std::string& path)
+	{
+		if (path.empty()) throw std::invalid_argument("Path is empty!");
+		Bitmap img(path, m_opt.flags, m_opt.format);
+		return insert(path, img);
+	}
+
+	std::vector<Bitmap> Texture_atlas::insert(const std::vector<std::pair<std::string, const Bitmap*>>& images)
+	{
+		std::vector<size_t> order(images.size());
+		std::iota(order.begin(), order.end(), static_cast<size_t>(0));
+
+		const auto long_side = [&](const size_t i) { return images[i].second ? (std::max)(images[i].second->get_width(), images[i].second->get_height()) : 0; };
+		std::stable_sort(order.begin(), order.end(), [&](const size_t a, const size_t b) { return long_side(a) > long_side(b); });
+
+		std::vector<Bitmap> res(images.size());
+		for (const size_t i : order) {
+			if (!images[i].second) throw std::invalid_argument("Bitmap is null!");
+			res[i] = insert(images[i].first, *images[i].second);
+		}
+		return res;
+	}
+
+	bool Texture_atlas::contains(const std::string& name) const
+	{
+		return m_names.count(name) != 0;
+	}
+
+	Bitmap Texture_atlas::get(const std::string& name) const
+	{
+		const atlas_entry* en = find(name);
+		if (!en) throw std::invalid_argument("Name is not in the atlas!");
+		return Bitmap(m_pages[static_cast<size_t>(en->page)].bmp, en->posx, en->posy, en->width, en->height, m_opt.flags, m_opt.format);
+	}
+
+	const atlas_entry* Texture_atlas::find(const std::string& name) const
+	{
+		const auto it = m_names.find(name);
+		return it == m_names.end() ? nullptr : &m_entries[it->second];
+	}
+
+	const std::vector<atlas_entry>& Texture_atlas::entries() const
+	{
+		return m_entries;
+	}
+
+	size_t Texture_atlas::page_count() const
+	{
+		return m_pages.size();
+	}
+
+	const Bitmap& Texture_atlas::page(const size_t index) const
+	{
+		return m_pages.at(index).bmp;
+	}
+
+	double Texture_atlas::occupancy() const
+	{
+		if (m_pages.empty()) return 0.0;
+		long long used = 0;
+		for (const auto& i : m_pages) used += i.used;
+		return static_cast<double>(used) / (static_cast<double>(m_opt.page_width) * m_opt.page_height * static_cast<double>(m_pages.size()));
+	}
+
+	bool Texture_atlas::save(const std::string& layout_path, const std::string& page_prefix) const
+	{
+		if (layout_path.empty() || page_prefix.empty()) return false;
+
+		Config cfg;
+		cfg.set("atlas", "page_width", std::to_string(m_opt.page_width));
+		cfg.set("atlas", "page_height", std::to_string(m_opt.page_height));
+		cfg.set("atlas", "padding", std::to_string(m_opt.padding));
+		cfg.set("atlas", "extrude", std::to_string(m_opt.extrude));
+		cfg.set("atlas", "pages", std::to_string(m_pages.size()));
+		cfg.set("atlas", "entries", std::to_string(m_entries.size()));
+
+		for (size_t i = 0; i < m_pages.size(); ++i) {
+			const std::string file = page_prefix + std::to_string(i) + ".png";
+			if (!al_save_bitmap(file.c_str(), m_pages[i].bmp.get_for_draw())) return false;
+			cfg.set("page." + std::to_string(i), "file", file);
+		}
+		for (size_t i = 0; i < m_entries.size(); ++i) {
+			const std::string sec = "entry." + std::to_string(i);
+			const atlas_entry& en = m_entries[i];
+			cfg.set(sec, "name", en.name);
+			cfg.set(sec, "page", std::to_string(en.page));
+			cfg.set(sec, "x", std::to_string(en.posx));
+			cfg.set(sec, "y", std::to_string(en.posy));
+			cfg.set(sec, "width", std::to_string(en.width));
+			cfg.set(sec, "height", std::to_string(en.height));
+		}
+
+		return cfg.save(layout_path);
+	}
+
+}
\ No newline at end of file
@@ -280,6 +280,93 @@ namespace AllegroCPP {
 		}
 	}
 
+	static thread_local const Thread_pool* _pool_of_this_thread = nullptr;
+
+	bool Thread_pool::worker()
+	{
+		_pool_of_this_thread = this;
+
+		std::function<void(void)> task;
+		{
+			std::unique_lock<std::mutex> l(m_mtx);
+			m_cond.wait(l, [this] { return m_stop || !m_tasks.empty(); });
+			if (m_tasks.empty()) return false; // stopping and nothing left
+			task = std::move(m_tasks.front());
+			m_tasks.pop_front();
+			++m_busy;
+		}
+
+		try { task(); }
+		catch (...) {}
+
+		std::lock_guard<std::mutex> l(m_mtx);
+		if (--m_busy == 0 && m_tasks.empty()) m_idle.notify_all();
+		return true;
+	}
+
+	Thread_pool::Thread_pool(const size_t threads)
+	{
+		if (!al_is_system_installed()) al_init();
+
+		size_t count = threads;
+		if (count == 0) {
+			const int cpus = al_get_cpu_count();
+			count = cpus > 0 ? static_cast<size_t>(cpus) : 1;
+		}
+
+		m_workers.reserve(count);
+		for (size_t p = 0; p < count; ++p) m_workers.emplace_back([this] { return worker(); }, Thread::Mode::NORMAL);
+	}
+
+	Thread_pool::~Thread_pool()
+	{
+		wait_idle(); // a stopped Thread would skip what is left in the queue
+		{
+			std::lock_guard<std::mutex> l(m_mtx);
+			m_stop = true;
+		}
+		m_cond.notify_all();
+		m_workers.clear(); // joins
+	}
+
+	void Thread_pool::push(std::function<void(void)> f)
+	{
+		if (!f) throw std::invalid_argument("No function to run!");
+		{
+			std::lock_guard<std::mutex> l(m_mtx);
+			m_tasks.push_back(std::move(f));
+		}
+		m_cond.notify_one();
+	}
+
+	void Thread_pool::wait_idle()
+	{
+		std::unique_lock<std::mutex> l(m_mtx);
+		m_idle.wait(l, [this] { return m_busy == 0 && m_tasks.empty(); });
+	}
+
+	bool Thread_pool::is_worker_thread() const
+	{
+		return _pool_of_this_thread == this;
+	}
+
+	size_t Thread_pool::size() const
+	{
+		return m_workers.size();
+	}
+
+	size_t Thread_pool::pending()
+	{
+		std::lock_guard<std::mutex> l(m_mtx);
+		return m_tasks.size();
+	}
+
+	Thread_pool& Thread_pool::global()
+	{
+		static Thread_pool pool;
+		return pool;
+	}
+
 	namespace Time {
 
 		double get_time()
@@ -0,0 +1,293 @@
+#include "udp_channel.h"
+#include "binary_stream.h"
+
+#ifndef ALLEGROCPP_DISABLE_FILESOCKET
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace AllegroCPP {
+
+	constexpr size_t udp_header_size = 9;
+	constexpr uint8_t udp_flag_ack = 1; // ack and ack bits are valid
+	constexpr size_t udp_message_header_size = 5;
+	constexpr size_t udp_sent_history = 1024;
+	constexpr size_t udp_max_in_flight = 4096; // per channel, keeps ids far from wrapping around
+	constexpr double udp_loss_timeout = 1.0;
+
+	// a after b, with wrap around
+	static inline bool seq_newer(const uint16_t a, const uint16_t b)
+	{
+		return a != b && static_cast<uint16_t>(a - b) < 0x8000;
+	}
+
+	Udp_channel::Udp_channel(File_client& udp_socket, const std::vector<channel_mode>& channels, const size_t mtu)
+		: m_sock(udp_socket), m_mtu(mtu), m_sent(udp_sent_history)
+	{
+		if (channels.empty() || channels.size() > 256) throw std::invalid_argument("Need 1 to 256 channels!");
+		if (mtu < udp_header_size + udp_message_header_size + 1 || mtu > 65507) throw std::invalid_argument("MTU out of range!");
+
+		for (const auto& i : channels) {
+			_channel ch;
+			ch.mode = i;
+			m_channels.push_back(std::move(ch));
+		}
+		m_stats.rtt = m_srtt;
+		m_stats.rtt_var = m_rttvar;
+	}
+
+	size_t Udp_channel::max_message_size() const
+	{
+		return (std::min)(m_mtu - udp_header_size - udp_message_header_size, static_cast<size_t>(0xFFFF));
+	}
+
+	size_t Udp_channel::channel_count() const
+	{
+		return m_channels.size();
+	}
+
+	bool Udp_channel::send(const uint8_t channel, const void* data, const size_t len)
+	{
+		if (channel >= m_channels.size() || len > max_message_size()) return false;
+		_channel& ch = m_channels[channel];
+		const uint8_t* p = static_cast<const uint8_t*>(data);
+
+		if (ch.mode == channel_mode::UNRELIABLE) {
+			ch.unreliable.emplace_back(p, p + len);
+			return true;
+		}
+		if (ch.in_flight.size() >= udp_max_in_flight) return false;
+
+		_pending pend;
+		pend.data.assign(p, p + len);
+		ch.in_flight.emplace(ch.next_send_id++, std::move(pend));
+		return true;
+	}
+
+	void Udp_channel::update(const long wait_ms)
+	{
+		std::vector<uint8_t> buf(static_cast<size_t>(1) << 16);
+
+		for (long wait = wait_ms; m_sock.wait_for_data(wait); wait = 0) {
+			const size_t got = m_sock.read(buf.data(), buf.size());
+			if (got == 0) break;
+			receive_packet(buf.data(), got);
+		}
+
+		const double now = al_get_time();
+		for (auto& i : m_sent) {
+			if (i.open && now - i.time > udp_loss_timeout) {
+				i.open = false;
+				++m_stats.packets_lost;
+			}
+		}
+
+		send_packets(now);
+	}
+
+	bool Udp_channel::receive(uint8_t& channel, std::vector<uint8_t>& data)
+	{
+		if (m_inbox.empty()) return false;
+		channel = m_inbox.front().first;
+		data = std::move(m_inbox.front().second);
+		m_inbox.pop_front();
+		return true;
+	}
+
+	udp_channel_stats Udp_channel::get_stats() const
+	{
+		udp_channel_stats st = m_stats;
+		st.messages_in_flight = 0;
+		for (const auto& i : m_channels) st.messages_in_flight += i.in_flight.size();
+		return st;
+	}
+
+	void Udp_channel::receive_packet(const uint8_t* data, const size_t len)
+	{
+		if (len < udp_header_size) return;
+
+		Binary_memory_reader r(data, len);
+		const uint16_t seq = r.u16le();
+		const uint8_t flags = r.u8();
+		const uint16_t ack = r.u16le();
+		const uint32_t ack_bits = r.u32le();
+
+		// remember it for our acks
+		if (!m_got_any) {
+			m_remote_seq = seq;
+			m_remote_bits = 0;
+			m_got_any = true;
+		}
+		else if (seq_newer(seq, m_remote_seq)) {
+			const uint16_t shift = static_cast<uint16_t>(seq - m_remote_seq);
+			m_remote_bits = shift > 32 ? 0 : ((shift == 32 ? 0 : (m_remote_bits << shift)) | (static_cast<uint32_t>(1) << (shift - 1)));
+			m_remote_seq = seq;
+		}
+		else {
+			const uint16_t back = static_cast<uint16_t>(m_remote_seq - seq);
+			if (back == 0 || back > 32) return; // duplicate or too old to ack
+			const uint32_t bit = static_cast<uint32_t>(1) << (back - 1);
+			if (m_remote_bits & bit) return; // duplicate
+			m_remote_bits |= bit;
+		}
+		++m_stats.packets_received;
+
+		if (flags & udp_flag_ack) { // clear before the peer got anything from us, seq 0 is not acked then
+			const double now = al_get_time();
+			acked(ack, now);
+			for (int i = 0; i < 32; ++i) {
+				if (ack_bits & (static_cast<uint32_t>(1) << i)) acked(static_cast<uint16_t>(ack - 1 - i), now);
+			}
+		}
+
+		while (r.good()) {
+			const uint8_t channel = r.u8();
+			const uint16_t id = r.u16le();
+			const uint16_t size = r.u16le();
+			if (!r.good()) break;
+			std::vector<uint8_t> msg(size);
+			if (!r.bytes(msg.data(), msg.size())) break;
+			m_ack_due = true; // only packets with messages, acking acks would never end
+			if (channel < m_channels.size()) receive_message(channel, id, std::move(msg));
+		}
+	}
+
+	void Udp_channel::receive_message(const uint8_t channel, const uint16_t id, std::vector<uint8_t>&& data)
+	{
+		_channel& ch = m_channels[channel];
+
+		if (ch.mode == channel_mode::UNRELIABLE) {
+			m_inbox.emplace_back(channel, std::move(data));
+			return;
+		}
+
+		const uint16_t dist = static_cast<uint16_t>(id - ch.next_recv_id);
+		if (dist >= 0x8000) return; // already delivered, resent copy
+		if (dist != 0 && ch.ahead.count(id)) return; // already have it
+
+		if (dist == 0) {
+			m_inbox.emplace_back(channel, std::move(data));
+			++ch.next_recv_id;
+			for (auto it = ch.ahead.find(ch.next_recv_id); it != ch.ahead.end(); it = ch.ahead.find(ch.next_recv_id)) {
+				if (ch.mode == channel_mode::RELIABLE_ORDERED) m_inbox.emplace_back(channel, std::move(it->second));
+				ch.ahead.erase(it);
+				++ch.next_recv_id;
+			}
+			return;
+		}
+
+		if (ch.mode == channel_mode::RELIABLE_ORDERED) ch.ahead.emplace(id, std::move(data));
+		else {
+			m_inbox.emplace_back(channel, std::move(data));
+			ch.ahead.emplace(id, std::vector<uint8_t>{});
+		}
+	}
+
+	void Udp_channel::acked(const uint16_t seq, const double now)
+	{
+		_sent_packet& p = m_sent[seq % m_sent.size()];
+		if (!p.open || p.seq != seq) return;
+		p.open = false;
+
+		const double sample = now - p.time;
+		if (!m_rtt_sampled) {
+			m_srtt = sample;
+			m_rttvar = sample / 2.0;
+			m_rtt_sampled = true;
+		}
+		else { // RFC 6298
+			m_rttvar = 0.75 * m_rttvar + 0.25 * std::fabs(m_srtt - sample);
+			m_srtt = 0.875 * m_srtt + 0.125 * sample;
+		}
+		m_stats.rtt = m_srtt;
+		m_stats.rtt_var = m_rttvar;
+
+		for (const auto& i : p.messages) m_channels[i.first].in_flight.erase(i.second);
+		p.messages.clear();
+	}
+
+	void Udp_channel::send_packets(const double now)
+	{
+		struct _out {
+			uint8_t channel;
+			uint16_t id;
+			const std::vector<uint8_t>* data;
+			bool reliable;
+		};
+
+		const double rto = (std::max)(0.05, m_srtt + 4.0 * m_rttvar);
+		std::vector<_out> outs;
+		std::deque<std::vector<uint8_t>> unreliable; // taken out of the channels, alive until sent
+
+		for (size_t c = 0; c < m_channels.size(); ++c) {
+			_channel& ch = m_channels[c];
+			for (auto& i : ch.in_flight) {
+				if (i.second.last_sent >= 0.0 && now - i.second.last_sent < rto) continue;
+				if (i.second.last_sent >= 0.0) ++m_stats.messages_resent;
+				i.second.last_sent = now;
+				outs.push_back({ static_cast<uint8_t>(c), i.first, &i.second.data, true });
+			}
+			while (!ch.unreliable.empty()) {
+				unreliable.push_back(std::move(ch.unreliable.front()));
+				ch.unreliable.pop_front();
+				outs.push_back({ static_cast<uint8_t>(c), 0, &unreliable.back(), false });
+			}
+		}
+
+		if (outs.empty() && !m_ack_due) return;
+
+		size_t next = 0;
+		do {
+			std::vector<uint8_t> pkt;
+			pkt.reserve(m_mtu);
+			_sent_packet& rec = m_sent[m_seq % m_sent.size()];
+			if (rec.open) ++m_stats.packets_lost; // overwritten before any ack
+			rec.seq = m_seq;
+			rec.time = now;
+			rec.open = false;
+			rec.messages.clear();
+
+			const size_t first = next;
+			{
+				Binary_memory_writer w(pkt);
+				w.u16le(m_seq);
+				w.u8(m_got_any ? udp_flag_ack : 0);
+				w.u16le(m_remote_seq);
+				w.u32le(m_remote_bits);
+
+				size_t used = udp_header_size;
+				for (; next < outs.size(); ++next) {
+					const _out& o = outs[next];
+					const size_t need = udp_message_header_size + o.data->size();
+					if (used + need > m_mtu) break;
+					w.u8(o.channel);
+					w.u16le(o.id);
+					w.u16le(static_cast<uint16_t>(o.data->size()));
+					w.bytes(o.data->data(), o.data->size());
+					used += need;
+					if (o.reliable) rec.messages.emplace_back(o.channel, o.id);
+				}
+			}
+
+			if (m_sock.write(pkt.data(), pkt.size()) != pkt.size()) {
+				++m_stats.send_failures;
+				for (size_t i = first; i < outs.size(); ++i) { // this packet and the rest, reliable ones go on the next update
+					if (!outs[i].reliable) continue;
+					auto& in_flight = m_channels[outs[i].channel].in_flight;
+					if (const auto it = in_flight.find(outs[i].id); it != in_flight.end()) it->second.last_sent = -1.0;
+				}
+				rec.messages.clear();
+				return; // still m_ack_due
+			}
+			rec.open = next > first; // only packets with messages get acked
+			++m_stats.packets_sent;
+			++m_seq;
+		} while (next < outs.size());
+
+		m_ack_due = false;
+	}
+
+}
+
+#endif // ALLEGROCPP_DISABLE_FILESOCKET
\ No newline at end of file
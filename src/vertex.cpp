@@ -1,5 +1,7 @@
 #include "vertex.h"
+#include "damage_tracker.h"
 
+#include <algorithm>
 #include <utility>
 #include <mutex>
 #include <cmath>
@@ -163,10 +165,20 @@ namespace AllegroCPP {
 
 	void Vertexes::draw()
 	{
-		std::shared_lock<std::shared_mutex>(safe_mtx);
+		std::shared_lock<std::shared_mutex> l(safe_mtx);
 		if (!points.size()) return;
 		latest_transform = al_get_current_transform();
-		al_draw_prim(points.data(), nullptr, textur.valid() ? textur : nullptr, 0, static_cast<int>(points.size()), static_cast<int>(type));
+		al_draw_prim(points.data(), nullptr, textur.valid() ? static_cast<ALLEGRO_BITMAP*>(textur) : nullptr, 0, static_cast<int>(points.size()), static_cast<int>(type));
+		if (!damage_tracking_active()) return;
+
+		float x0 = points[0].x, y0 = points[0].y, x1 = x0, y1 = y0;
+		for (const auto& i : points) {
+			x0 = (std::min)(x0, i.x);
+			y0 = (std::min)(y0, i.y);
+			x1 = (std::max)(x1, i.x);
+			y1 = (std::max)(y1, i.y);
+		}
+		damage_report(x0, y0, x1 - x0, y1 - y0);
 	}
 
 	bool Vertexes::valid() const
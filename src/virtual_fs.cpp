@@ -0,0 +1,164 @@
+#include "virtual_fs.h"
+
+#include <algorithm>
+#include <mutex>
+
+namespace AllegroCPP {
+
+	Virtual_fs::_lookup Virtual_fs::lookup(const std::string& path) const
+	{
+		{
+			std::shared_lock<std::shared_mutex> l(m_cache_mtx);
+			auto it = m_cache.find(path);
+			if (it != m_cache.end()) {
+				++m_hits;
+				return it->second;
+			}
+		}
+
+		++m_misses;
+
+		_lookup res;
+		PHYSFS_Stat st{};
+		if (PHYSFS_stat(path.c_str(), &st) != 0) {
+			res.exists = true;
+			res.is_directory = st.filetype == PHYSFS_FILETYPE_DIRECTORY;
+			res.size = res.is_directory ? 0 : static_cast<int64_t>(st.filesize);
+		}
+
+		std::unique_lock<std::shared_mutex> l(m_cache_mtx);
+		m_cache[path] = res;
+		return res;
+	}
+
+	Virtual_fs::Virtual_fs(const char* argv0)
+	{
+		if (!al_is_system_installed()) al_init();
+		if (!PHYSFS_isInit() && !PHYSFS_init(argv0)) throw std::runtime_error("Could not start PhysFS!");
+	}
+
+	Virtual_fs::~Virtual_fs()
+	{
+		unmount_all();
+	}
+
+	bool Virtual_fs::mount(const std::string& path, const std::string& mount_point, const int priority)
+	{
+		if (path.empty()) throw std::invalid_argument("Path is empty!");
+
+		auto it = std::find_if(m_mounts.begin(), m_mounts.end(), [&](const _mount& m) { return m.path == path; });
+		if (it != m_mounts.end()) return false; // already mounted by us
+
+		const auto pos = std::find_if(m_mounts.begin(), m_mounts.end(), [&](const _mount& m) { return m.priority < priority; });
+		const size_t off = static_cast<size_t>(std::distance(m_mounts.begin(), pos));
+
+		// PhysFS only knows append / prepend, so everything with lower priority is pulled out and appended again after it.
+		for (size_t p = off; p < m_mounts.size(); ++p) PHYSFS_unmount(m_mounts[p].path.c_str());
+
+		if (PHYSFS_mount(path.c_str(), mount_point.c_str(), 1) == 0) {
+			for (size_t p = off; p < m_mounts.size(); ++p) PHYSFS_mount(m_mounts[p].path.c_str(), m_mounts[p].mount_point.c_str(), 1);
+			return false;
+		}
+
+		m_mounts.insert(m_mounts.begin() + off, _mount{ path, mount_point, priority });
+		for (size_t p = off + 1; p < m_mounts.size(); ++p) PHYSFS_mount(m_mounts[p].path.c_str(), m_mounts[p].mount_point.c_str(), 1);
+
+		clear_cache();
+		return true;
+	}
+
+	bool Virtual_fs::unmount(const std::string& path)
+	{
+		auto it = std::find_if(m_mounts.begin(), m_mounts.end(), [&](const _mount& m) { return m.path == path; });
+		if (it == m_mounts.end()) return false;
+
+		const bool good = PHYSFS_unmount(it->path.c_str()) != 0;
+		m_mounts.erase(it);
+		clear_cache();
+		return good;
+	}
+
+	void Virtual_fs::unmount_all()
+	{
+		for (const auto& i : m_mounts) PHYSFS_unmount(i.path.c_str());
+		m_mounts.clear();
+		clear_cache();
+	}
+
+	bool Virtual_fs::set_write_dir(const std::string& path)
+	{
+		return PHYSFS_setWriteDir(path.empty() ? nullptr : path.c_str()) != 0;
+	}
+
+	void Virtual_fs::set_as_thread_interface() const
+	{
+		al_set_physfs_file_interface();
+	}
+
+	void Virtual_fs::reset_thread_interface()
+	{
+		al_set_standard_file_interface();
+	}
+
+	bool Virtual_fs::exists(const std::string& path) const
+	{
+		return lookup(path).exists;
+	}
+
+	bool Virtual_fs::is_directory(const std::string& path) const
+	{
+		return lookup(path).is_directory;
+	}
+
+	int64_t Virtual_fs::size(const std::string& path) const
+	{
+		return lookup(path).size;
+	}
+
+	std::vector<std::string> Virtual_fs::list(const std::string& dir) const
+	{
+		{
+			std::shared_lock<std::shared_mutex> l(m_cache_mtx);
+			auto it = m_list_cache.find(dir);
+			if (it != m_list_cache.end()) {
+				++m_hits;
+				return it->second;
+			}
+		}
+
+		++m_misses;
+
+		std::vector<std::string> vec;
+		char** lst = PHYSFS_enumerateFiles(dir.c_str());
+		if (lst) {
+			for (char** i = lst; *i != nullptr; ++i) vec.push_back(*i);
+			PHYSFS_freeList(lst);
+		}
+
+		std::unique_lock<std::shared_mutex> l(m_cache_mtx);
+		m_list_cache[dir] = vec;
+		return vec;
+	}
+
+	File Virtual_fs::open(const std::string& path, const std::string& mode)
+	{
+		if (mode.find_first_of("wa+") != std::string::npos) clear_cache(); // tree may change
+		else if (!exists(path)) throw std::runtime_error("File does not exist in virtual filesystem!");
+
+		return File(path, al_get_physfs_file_interface(), mode);
+	}
+
+	void Virtual_fs::clear_cache()
+	{
+		std::unique_lock<std::shared_mutex> l(m_cache_mtx);
+		m_cache.clear();
+		m_list_cache.clear();
+	}
+
+	virtual_fs_stats Virtual_fs::get_cache_stats() const
+	{
+		std::shared_lock<std::shared_mutex> l(m_cache_mtx);
+		return virtual_fs_stats{ m_hits.load(), m_misses.load(), m_cache.size() + m_list_cache.size() };
+	}
+
+}
\ No newline at end of file